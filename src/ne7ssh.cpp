@@ -17,14 +17,15 @@
 #include "ne7ssh.h"
 #include "ne7ssh_sftp.h"
 #include "ne7ssh_impl.h"
+#include "ne7ssh_aes.h"
 
 std::shared_ptr<ne7ssh_impl> ne7ssh::s_ne7sshInst;
 
-void ne7ssh::create()
+void ne7ssh::create(bool calibrate)
 {
     if (s_ne7sshInst == NULL)
     {
-        s_ne7sshInst = ne7ssh_impl::create();
+        s_ne7sshInst = ne7ssh_impl::create(calibrate);
     }
 }
 
@@ -46,6 +47,11 @@ const char* ne7ssh::getVersion(const bool shortVersion)
     }
 }
 
+const char* ne7ssh::getAesImplementation()
+{
+    return ne7ssh_aes::implementation();
+}
+
 int ne7ssh::connectWithPassword(const char* host, const short port, const char* username, const char* password, bool shell, const int timeout)
 {
     return s_ne7sshInst->connectWithPassword(host, port, username, password, shell, timeout);
@@ -56,6 +62,21 @@ int ne7ssh::connectWithKey(const char* host, const short port, const char* usern
     return s_ne7sshInst->connectWithKey(host, port, username, privKeyFileName, shell, timeout);
 }
 
+int ne7ssh::connectWithKeyHandle(const char* host, const short port, const char* username, int keyHandle, bool shell, const int timeout)
+{
+    return s_ne7sshInst->connectWithKeyHandle(host, port, username, keyHandle, shell, timeout);
+}
+
+int ne7ssh::loadKeyPair(const char* privKey, uint32 length)
+{
+    return s_ne7sshInst->loadKeyPair(privKey, length);
+}
+
+bool ne7ssh::unloadKeyPair(int keyHandle)
+{
+    return s_ne7sshInst->unloadKeyPair(keyHandle);
+}
+
 bool ne7ssh::send(const char* data, int channel)
 {
     return s_ne7sshInst->send(data, channel);
@@ -91,6 +112,21 @@ void ne7ssh::setOptions(const char* prefCipher, const char* prefHmac)
     s_ne7sshInst->setOptions(prefCipher, prefHmac);
 }
 
+void ne7ssh::setKnownHostsFile(const char* knownHostsFile)
+{
+    s_ne7sshInst->setKnownHostsFile(knownHostsFile);
+}
+
+void ne7ssh::setCompression(int level)
+{
+    s_ne7sshInst->setCompression(level);
+}
+
+void ne7ssh::setRekeyLimits(uint64 bytes, uint32 packets, uint32 seconds)
+{
+    s_ne7sshInst->setRekeyLimits(bytes, packets, seconds);
+}
+
 bool ne7ssh::generateKeyPair(const char* type, const char* fqdn, const char* privKeyFileName, const char* pubKeyFileName, uint16 keySize)
 {
     return s_ne7sshInst->generateKeyPair(type, fqdn, privKeyFileName, pubKeyFileName, keySize);
@@ -42,9 +42,11 @@ public:
     /**
     * Create the SSH working environment.
     * This funciton must only be called once during application initialization.
+    * @param calibrate Set this to true to measure the supported ciphers and MACs on this machine, and offer the fastest first within each security tier.
+    * Takes in the order of 100 milliseconds. Algorithms set with setOptions() are still preferred over the measured order.
     */
 
-    SSH_EXPORT static void create();
+    SSH_EXPORT static void create(bool calibrate = false);
 
     /**
     * Destroy the SSH working environment.
@@ -59,6 +61,14 @@ public:
     */
     SSH_EXPORT static const char* getVersion(const bool shortVersion = false);
 
+    /**
+    * Returns which AES and GHASH implementations are in use, chosen by CPUID when first needed.
+    * Hardware AES is used for the aes*-ctr, aes*-cbc and aes*-gcm@openssh.com ciphers and for umac.
+    * Like getVersion(), this function can be called before create().
+    * @return "AES-NI", "AES-NI, VAES" or "portable" for AES, with ", PCLMUL" appended when GHASH uses carry-less multiplication.
+    */
+    SSH_EXPORT static const char* getAesImplementation();
+
     /**
      * Connect to remote host using SSH2 protocol, with password authentication.
      * @param host Hostname or IP to connect to.
@@ -75,6 +85,7 @@ public:
      * Connect to remote host using SSH2 protocol, with publickey authentication.
      * <p> Reads private key from a file specified, and uses it to authenticate to remote host.
      * Remote side must have public key from the key pair for authentication to succeed.
+     * The key is parsed once and shared by later connections, the file is read again only after it changes.
      * @param host Hostname or IP to connect to.
      * @param port Port to connect to.
      * @param username Username to use in authentication.
@@ -85,6 +96,36 @@ public:
      */
     SSH_EXPORT static int connectWithKey(const char* host, const short port, const char* username, const char* privKeyFileName, bool shell = true, const int timeout = 0);
 
+    /**
+     * Connect to remote host using SSH2 protocol, with publickey authentication, using a key loaded with loadKeyPair().
+     * <p> No file is read and the key is not parsed again, so the same handle can be used for any number of connections.
+     * @param host Hostname or IP to connect to.
+     * @param port Port to connect to.
+     * @param username Username to use in authentication.
+     * @param keyHandle Handle returned by loadKeyPair().
+     * @param shell Set this to true if you wish to launch the shell on the remote end. By default set to true.
+     * @param timeout Timeout for the connection procedure, in seconds.
+     * @return Returns newly assigned channel ID, or -1 if connection failed.
+     */
+    SSH_EXPORT static int connectWithKeyHandle(const char* host, const short port, const char* username, int keyHandle, bool shell = true, const int timeout = 0);
+
+    /**
+     * Loads a private key from memory, for use with connectWithKeyHandle().
+     * <p> Accepts the same formats as connectWithKey() reads from files. The library keeps its own copy of the parsed key,
+     * so the caller may wipe the buffer as soon as this returns.
+     * @param privKey The private key, as it would appear in a key file. Need not be NULL terminated.
+     * @param length Length of the key in bytes.
+     * @return Returns the key handle, or -1 if the key could not be parsed.
+     */
+    SSH_EXPORT static int loadKeyPair(const char* privKey, uint32 length);
+
+    /**
+     * Forgets a key loaded with loadKeyPair(). Connections already opened with it are not affected.
+     * @param keyHandle Handle returned by loadKeyPair().
+     * @return Returns true if the handle was valid, otherwise false is returned.
+     */
+    SSH_EXPORT static bool unloadKeyPair(int keyHandle);
+
     /**
      * Retreives count of current connections
      * <p> For internal use only.
@@ -142,18 +183,46 @@ public:
     /**
      * Sets prefered cipher and hmac algorithms.
      * <p> This function as to be executed before connection functions, just after initialization of ne7ssh class.
-     * @param prefCipher prefered cipher algorithm string representation. Possible cipher algorithms are aes256-cbc, twofish-cbc, twofish256-cbc, blowfish-cbc, 3des-cbc, aes128-cbc, cast128-cbc.
-     * @param prefHmac preferede hmac algorithm string representation. Possible hmac algorithms are hmac-md5, hmac-sha1, none.
+     * @param prefCipher prefered cipher algorithm string representation. Possible cipher algorithms are chacha20-poly1305@openssh.com, aes256-gcm@openssh.com, aes128-gcm@openssh.com, aes256-ctr, aes192-ctr, aes128-ctr, aes256-cbc, twofish-cbc, twofish256-cbc, blowfish-cbc, 3des-cbc, aes128-cbc, cast128-cbc.
+     * @param prefHmac preferede hmac algorithm string representation. Possible hmac algorithms are umac-64-etm@openssh.com, umac-128-etm@openssh.com, hmac-sha2-256-etm@openssh.com, hmac-sha2-512-etm@openssh.com, hmac-sha1-etm@openssh.com, umac-64@openssh.com, umac-128@openssh.com, hmac-sha2-256, hmac-sha2-512, hmac-md5, hmac-sha1, none.
      */
     SSH_EXPORT static void setOptions(const char* prefCipher, const char* prefHmac);
 
+    /**
+     * Sets an OpenSSH known_hosts file to verify server host keys against.
+     * <p> Once set, connections to hosts whose key is not listed, differs from the listed one or is marked @revoked fail.
+     * Hashed entries and wildcard patterns are supported. Hosts on other ports than 22 are looked up as [host]:port.
+     * The file is read once and again only after it changes, so it can be updated while the application runs.
+     * @param knownHostsFile Full path to the known_hosts file, or 0 to stop checking host keys, which is the default.
+     */
+    SSH_EXPORT static void setKnownHostsFile(const char* knownHostsFile);
+
+    /**
+     * Offers zlib compression of the transport to servers, for connections made afterwards.
+     * <p> "zlib@openssh.com", which starts compressing once the user is authenticated, is preferred over plain "zlib".
+     * Compression helps on slow links with compressible data, on fast links it mostly costs CPU time.
+     * @param level Compression level from 1, fastest, to 9, smallest output. 0 disables compression, which is the default.
+     */
+    SSH_EXPORT static void setCompression(int level);
+
+    /**
+     * Sets when connections re-run the key exchange, so long lived sessions do not use the same keys for too much data.
+     * <p> Re-keying runs in the background, outgoing channel data is held back only while the exchange requires it.
+     * Servers can start a key exchange at any time as well, which is always answered.
+     * By default keys are renewed after 1 GB of data, 2^31 packets or an hour, whichever comes first.
+     * @param bytes Data sent and received since the last key exchange, in bytes. 0 for no limit.
+     * @param packets Packets sent and received since the last key exchange. 0 for no limit.
+     * @param seconds Time since the last key exchange, in seconds. 0 for no limit.
+     */
+    SSH_EXPORT static void setRekeyLimits(uint64 bytes, uint32 packets, uint32 seconds);
+
     /**
      * Generate key pair.
-     * @param type String specifying key type. Currently "dsa" and "rsa" are supported.
+     * @param type String specifying key type. Currently "dsa", "rsa", "ed25519" and "ecdsa" are supported.
      * @param fqdn User id. Usually an Email. For example "test@netsieben.com"
      * @param privKeyFileName Full path to a file where generated private key should be written.
      * @param pubKeyFileName Full path to a file where generated public key should be written.
-     * @param keySize Desired key size in bits. If not specified will default to 2048.
+     * @param keySize Desired key size in bits. If not specified will default to 2048, or 256 for "ecdsa" keys. Ignored for "ed25519" keys.
      * @return Return true if keys generated and written to the files. Otherwise false is returned.
      */
     SSH_EXPORT static bool generateKeyPair(const char* type, const char* fqdn, const char* privKeyFileName, const char* pubKeyFileName, uint16 keySize = 0);
@@ -0,0 +1,490 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_aes.h"
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) && \
+    (defined(_MSC_VER) || defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 5)))
+#   define NE7SSH_AES_NI
+#   include <wmmintrin.h>
+#   include <emmintrin.h>
+#   include <botan/cpuid.h>
+#   ifdef _MSC_VER
+#       include <intrin.h>
+#       define NE7SSH_AES_TARGET
+#   else
+#       include <cpuid.h>
+#       define NE7SSH_AES_TARGET __attribute__((target("aes,sse2")))
+#   endif
+#endif
+#if defined(NE7SSH_AES_NI) && (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 8)))
+#   define NE7SSH_AES_VAES
+#   include <immintrin.h>
+#endif
+
+using namespace Botan;
+
+#define AES_BLOCK 16
+#define AES_MAX_ROUNDS 14
+// Blocks kept in flight, enough to cover the latency of the AES instructions
+#define AES_INTERLEAVE 8
+
+namespace
+{
+#ifdef NE7SSH_AES_NI
+bool cpuHasVaes()
+{
+#ifdef NE7SSH_AES_VAES
+    unsigned int eax, ebx, ecx, edx, xcr0Lo, xcr0Hi;
+
+    if (!CPUID::has_avx2())
+    {
+        return false;
+    }
+    // The OS has to save the YMM registers too
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (!(ecx & (1U << 27)))
+    {
+        return false;
+    }
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+    if ((xcr0Lo & 6) != 6)
+    {
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ecx & (1U << 9)) != 0;
+#else
+    return false;
+#endif
+}
+
+struct aesFeatures
+{
+    bool aesNi;
+    bool vaes;
+    bool clmul;
+    std::string description;
+
+    aesFeatures()
+    {
+        // Normally done by Botan::LibraryInitializer, repeated so detection does not depend on it
+        CPUID::initialize();
+        aesNi = CPUID::has_aes_ni();
+        vaes = aesNi && cpuHasVaes();
+        clmul = CPUID::has_clmul() && CPUID::has_ssse3();
+        describe();
+    }
+
+    void describe()
+    {
+        description = aesNi ? (vaes ? "AES-NI, VAES" : "AES-NI") : "portable";
+        if (clmul)
+        {
+            description += ", PCLMUL";
+        }
+    }
+};
+
+// What the CPU has
+const aesFeatures& detected()
+{
+    static const aesFeatures cpu;
+    return cpu;
+}
+
+// What is used, the CPU features unless ne7ssh_aes::forceImplementation() narrowed them
+aesFeatures& features()
+{
+    static aesFeatures used = detected();
+    return used;
+}
+
+// SubWord of the word in the low 32 bits, and RotWord(SubWord()) of it, from one AESKEYGENASSIST
+NE7SSH_AES_TARGET
+void subWord(uint32 w, uint32& sub, uint32& subRot)
+{
+    __m128i r = _mm_aeskeygenassist_si128(_mm_set_epi32(0, 0, (int)w, 0), 0);
+
+    sub = (uint32)_mm_cvtsi128_si32(r);
+    subRot = (uint32)_mm_cvtsi128_si32(_mm_srli_si128(r, 4));
+}
+
+NE7SSH_AES_TARGET
+void encryptBlocks(const Botan::byte* keys, uint32 rounds, const Botan::byte* in, Botan::byte* out, size_t blocks)
+{
+    const __m128i* rk = (const __m128i*)keys;
+    __m128i b[AES_INTERLEAVE], k;
+    uint32 r;
+    size_t i, n;
+
+    while (blocks)
+    {
+        n = (blocks < AES_INTERLEAVE) ? blocks : AES_INTERLEAVE;
+        k = _mm_loadu_si128(rk);
+        for (i = 0; i < n; i++)
+        {
+            b[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + i * AES_BLOCK)), k);
+        }
+        for (r = 1; r < rounds; r++)
+        {
+            k = _mm_loadu_si128(rk + r);
+            for (i = 0; i < n; i++)
+            {
+                b[i] = _mm_aesenc_si128(b[i], k);
+            }
+        }
+        k = _mm_loadu_si128(rk + rounds);
+        for (i = 0; i < n; i++)
+        {
+            _mm_storeu_si128((__m128i*)(out + i * AES_BLOCK), _mm_aesenclast_si128(b[i], k));
+        }
+        in += n * AES_BLOCK;
+        out += n * AES_BLOCK;
+        blocks -= n;
+    }
+}
+
+NE7SSH_AES_TARGET
+void decryptBlocks(const Botan::byte* keys, uint32 rounds, const Botan::byte* in, Botan::byte* out, size_t blocks)
+{
+    const __m128i* rk = (const __m128i*)keys;
+    __m128i b[AES_INTERLEAVE], k;
+    uint32 r;
+    size_t i, n;
+
+    while (blocks)
+    {
+        n = (blocks < AES_INTERLEAVE) ? blocks : AES_INTERLEAVE;
+        k = _mm_loadu_si128(rk);
+        for (i = 0; i < n; i++)
+        {
+            b[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + i * AES_BLOCK)), k);
+        }
+        for (r = 1; r < rounds; r++)
+        {
+            k = _mm_loadu_si128(rk + r);
+            for (i = 0; i < n; i++)
+            {
+                b[i] = _mm_aesdec_si128(b[i], k);
+            }
+        }
+        k = _mm_loadu_si128(rk + rounds);
+        for (i = 0; i < n; i++)
+        {
+            _mm_storeu_si128((__m128i*)(out + i * AES_BLOCK), _mm_aesdeclast_si128(b[i], k));
+        }
+        in += n * AES_BLOCK;
+        out += n * AES_BLOCK;
+        blocks -= n;
+    }
+}
+
+NE7SSH_AES_TARGET
+void inverseMixColumns(Botan::byte* key)
+{
+    _mm_storeu_si128((__m128i*)key, _mm_aesimc_si128(_mm_loadu_si128((const __m128i*)key)));
+}
+
+#ifdef NE7SSH_AES_VAES
+// Two blocks per register, eight per iteration. The tail goes to encryptBlocks()
+__attribute__((target("vaes,avx2")))
+void encryptBlocksVaes(const Botan::byte* keys, uint32 rounds, const Botan::byte* in, Botan::byte* out, size_t blocks)
+{
+    const __m128i* rk = (const __m128i*)keys;
+    __m256i b0, b1, b2, b3, k;
+    uint32 r;
+
+    while (blocks >= AES_INTERLEAVE)
+    {
+        k = _mm256_broadcastsi128_si256(_mm_loadu_si128(rk));
+        b0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)in), k);
+        b1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(in + 2 * AES_BLOCK)), k);
+        b2 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(in + 4 * AES_BLOCK)), k);
+        b3 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(in + 6 * AES_BLOCK)), k);
+        for (r = 1; r < rounds; r++)
+        {
+            k = _mm256_broadcastsi128_si256(_mm_loadu_si128(rk + r));
+            b0 = _mm256_aesenc_epi128(b0, k);
+            b1 = _mm256_aesenc_epi128(b1, k);
+            b2 = _mm256_aesenc_epi128(b2, k);
+            b3 = _mm256_aesenc_epi128(b3, k);
+        }
+        k = _mm256_broadcastsi128_si256(_mm_loadu_si128(rk + rounds));
+        _mm256_storeu_si256((__m256i*)out, _mm256_aesenclast_epi128(b0, k));
+        _mm256_storeu_si256((__m256i*)(out + 2 * AES_BLOCK), _mm256_aesenclast_epi128(b1, k));
+        _mm256_storeu_si256((__m256i*)(out + 4 * AES_BLOCK), _mm256_aesenclast_epi128(b2, k));
+        _mm256_storeu_si256((__m256i*)(out + 6 * AES_BLOCK), _mm256_aesenclast_epi128(b3, k));
+        in += AES_INTERLEAVE * AES_BLOCK;
+        out += AES_INTERLEAVE * AES_BLOCK;
+        blocks -= AES_INTERLEAVE;
+    }
+    encryptBlocks(keys, rounds, in, out, blocks);
+}
+
+__attribute__((target("vaes,avx2")))
+void decryptBlocksVaes(const Botan::byte* keys, uint32 rounds, const Botan::byte* in, Botan::byte* out, size_t blocks)
+{
+    const __m128i* rk = (const __m128i*)keys;
+    __m256i b0, b1, b2, b3, k;
+    uint32 r;
+
+    while (blocks >= AES_INTERLEAVE)
+    {
+        k = _mm256_broadcastsi128_si256(_mm_loadu_si128(rk));
+        b0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)in), k);
+        b1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(in + 2 * AES_BLOCK)), k);
+        b2 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(in + 4 * AES_BLOCK)), k);
+        b3 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(in + 6 * AES_BLOCK)), k);
+        for (r = 1; r < rounds; r++)
+        {
+            k = _mm256_broadcastsi128_si256(_mm_loadu_si128(rk + r));
+            b0 = _mm256_aesdec_epi128(b0, k);
+            b1 = _mm256_aesdec_epi128(b1, k);
+            b2 = _mm256_aesdec_epi128(b2, k);
+            b3 = _mm256_aesdec_epi128(b3, k);
+        }
+        k = _mm256_broadcastsi128_si256(_mm_loadu_si128(rk + rounds));
+        _mm256_storeu_si256((__m256i*)out, _mm256_aesdeclast_epi128(b0, k));
+        _mm256_storeu_si256((__m256i*)(out + 2 * AES_BLOCK), _mm256_aesdeclast_epi128(b1, k));
+        _mm256_storeu_si256((__m256i*)(out + 4 * AES_BLOCK), _mm256_aesdeclast_epi128(b2, k));
+        _mm256_storeu_si256((__m256i*)(out + 6 * AES_BLOCK), _mm256_aesdeclast_epi128(b3, k));
+        in += AES_INTERLEAVE * AES_BLOCK;
+        out += AES_INTERLEAVE * AES_BLOCK;
+        blocks -= AES_INTERLEAVE;
+    }
+    decryptBlocks(keys, rounds, in, out, blocks);
+}
+#endif
+
+typedef void (*aes_blocks_fn)(const Botan::byte* keys, uint32 rounds, const Botan::byte* in, Botan::byte* out, size_t blocks);
+
+aes_blocks_fn selectEncrypt()
+{
+#ifdef NE7SSH_AES_VAES
+    if (features().vaes)
+    {
+        return encryptBlocksVaes;
+    }
+#endif
+    return encryptBlocks;
+}
+
+aes_blocks_fn selectDecrypt()
+{
+#ifdef NE7SSH_AES_VAES
+    if (features().vaes)
+    {
+        return decryptBlocksVaes;
+    }
+#endif
+    return decryptBlocks;
+}
+
+aes_blocks_fn& encryptFn()
+{
+    static aes_blocks_fn fn = selectEncrypt();
+    return fn;
+}
+
+aes_blocks_fn& decryptFn()
+{
+    static aes_blocks_fn fn = selectDecrypt();
+    return fn;
+}
+#endif
+}
+
+bool ne7ssh_aes::forceImplementation(implementations impl)
+{
+#ifdef NE7SSH_AES_NI
+    aesFeatures& used = features();
+
+    switch (impl)
+    {
+        case AUTO:
+            used = detected();
+            break;
+
+        case PORTABLE:
+            used.aesNi = used.vaes = used.clmul = false;
+            break;
+
+        case AES_NI:
+            if (!detected().aesNi)
+            {
+                return false;
+            }
+            used.aesNi = true;
+            used.vaes = false;
+            used.clmul = detected().clmul;
+            break;
+
+        case VAES:
+            if (!detected().vaes)
+            {
+                return false;
+            }
+            used = detected();
+            break;
+
+        default:
+            return false;
+    }
+    used.describe();
+    encryptFn() = selectEncrypt();
+    decryptFn() = selectDecrypt();
+    return true;
+#else
+    return impl == AUTO || impl == PORTABLE;
+#endif
+}
+
+ne7ssh_aes::ne7ssh_aes(size_t keyLen)
+    : _keyLen(keyLen),
+    _rounds((uint32)keyLen / 4 + 6),
+    _encKeys(AES_BLOCK * (AES_MAX_ROUNDS + 1)),
+    _decKeys(AES_BLOCK * (AES_MAX_ROUNDS + 1))
+{
+}
+
+Botan::BlockCipher* ne7ssh_aes::create(const std::string& algo, const Botan::BlockCipher* prototype)
+{
+    if (hasAesNi())
+    {
+        if (algo == "AES-128")
+        {
+            return new ne7ssh_aes(16);
+        }
+        else if (algo == "AES-192")
+        {
+            return new ne7ssh_aes(24);
+        }
+        else if (algo == "AES-256")
+        {
+            return new ne7ssh_aes(32);
+        }
+    }
+    return prototype->clone();
+}
+
+const char* ne7ssh_aes::implementation()
+{
+#ifdef NE7SSH_AES_NI
+    return features().description.c_str();
+#else
+    return "portable";
+#endif
+}
+
+bool ne7ssh_aes::hasAesNi()
+{
+#ifdef NE7SSH_AES_NI
+    return features().aesNi;
+#else
+    return false;
+#endif
+}
+
+bool ne7ssh_aes::hasClmul()
+{
+#ifdef NE7SSH_AES_NI
+    return features().clmul;
+#else
+    return false;
+#endif
+}
+
+void ne7ssh_aes::key_schedule(const Botan::byte key[], size_t length)
+{
+#ifdef NE7SSH_AES_NI
+    static const Botan::byte RCON[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+    uint32 w[4 * (AES_MAX_ROUNDS + 1)];
+    uint32 nk = (uint32)length / 4, total = 4 * (_rounds + 1), i, t, sub, subRot;
+
+    // FIPS-197 key expansion, words kept in memory order so they line up with the AES-NI registers
+    memcpy(w, key, length);
+    for (i = nk; i < total; i++)
+    {
+        t = w[i - 1];
+        if (!(i % nk))
+        {
+            subWord(t, sub, subRot);
+            t = subRot ^ RCON[i / nk - 1];
+        }
+        else if ((nk > 6) && ((i % nk) == 4))
+        {
+            subWord(t, sub, subRot);
+            t = sub;
+        }
+        w[i] = w[i - nk] ^ t;
+    }
+    memcpy(_encKeys.begin(), w, total * sizeof(uint32));
+    memset(w, 0, sizeof(w));
+
+    // Equivalent inverse cipher, round keys in reverse with InvMixColumns applied to the middle ones
+    for (i = 0; i <= _rounds; i++)
+    {
+        memcpy(_decKeys.begin() + i * AES_BLOCK, _encKeys.begin() + (_rounds - i) * AES_BLOCK, AES_BLOCK);
+        if (i && (i < _rounds))
+        {
+            inverseMixColumns(_decKeys.begin() + i * AES_BLOCK);
+        }
+    }
+#else
+    UNREF_PARAM(key);
+    UNREF_PARAM(length);
+#endif
+}
+
+void ne7ssh_aes::encrypt_n(const Botan::byte in[], Botan::byte out[], size_t blocks) const
+{
+#ifdef NE7SSH_AES_NI
+    encryptFn()(_encKeys.begin(), _rounds, in, out, blocks);
+#else
+    UNREF_PARAM(in);
+    UNREF_PARAM(out);
+    UNREF_PARAM(blocks);
+#endif
+}
+
+void ne7ssh_aes::decrypt_n(const Botan::byte in[], Botan::byte out[], size_t blocks) const
+{
+#ifdef NE7SSH_AES_NI
+    decryptFn()(_decKeys.begin(), _rounds, in, out, blocks);
+#else
+    UNREF_PARAM(in);
+    UNREF_PARAM(out);
+    UNREF_PARAM(blocks);
+#endif
+}
+
+void ne7ssh_aes::clear()
+{
+    zeroise(_encKeys);
+    zeroise(_decKeys);
+}
+
+std::string ne7ssh_aes::name() const
+{
+    return (_keyLen == 16) ? "AES-128" : ((_keyLen == 24) ? "AES-192" : "AES-256");
+}
+
+Botan::BlockCipher* ne7ssh_aes::clone() const
+{
+    return new ne7ssh_aes(_keyLen);
+}
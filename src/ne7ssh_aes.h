@@ -0,0 +1,112 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_AES_H
+#define NE7SSH_AES_H
+
+#include "ne7ssh_types.h"
+#include <botan/block_cipher.h>
+#include <string>
+
+/**
+ * AES on the AES-NI instructions, with VAES for runs of blocks where the CPU has it.
+ * <p>Botan picks its own AES implementation, so the library cannot tell or choose whether hardware AES is used.
+ * This class is used instead of Botan's AES whenever CPUID reports AES-NI, Botan's remains the portable fallback.
+ * Up to eight blocks are processed interleaved, which keeps the AES units busy in CTR, GCM and CBC decryption.
+ */
+class ne7ssh_aes : public Botan::BlockCipher
+{
+private:
+    size_t _keyLen;
+    uint32 _rounds;
+    Botan::SecureVector<Botan::byte> _encKeys;
+    Botan::SecureVector<Botan::byte> _decKeys;
+
+    /**
+     * Expands the key into the encryption and decryption round keys.
+     * @param key Pointer to the key.
+     * @param length Length of the key, 16, 24 or 32 bytes.
+     */
+    void key_schedule(const Botan::byte key[], size_t length);
+
+public:
+    enum implementations { AUTO, PORTABLE, AES_NI, VAES };
+
+    /**
+     * Replaces the implementation chosen from the CPU features, for known answer tests.
+     * <p>PORTABLE uses Botan's AES and the table driven GHASH of ne7ssh_gcm. AES_NI and VAES keep PCLMULQDQ
+     * for GHASH if the CPU has it. Not thread safe, call it while no AES cipher is in use.
+     * @param impl Implementation to use from now on, AUTO goes back to the one the CPU features select.
+     * @return True if the implementation is compiled in and the CPU supports it, otherwise false is returned.
+     */
+    static bool forceImplementation(implementations impl);
+
+    /**
+     * ne7ssh_aes class constructor.
+     * @param keyLen Key length in bytes, 16, 24 or 32.
+     */
+    ne7ssh_aes(size_t keyLen);
+
+    /**
+     * Creates the block cipher for a negotiated algorithm, preferring hardware AES.
+     * @param algo Botan name of the algorithm, for example "AES-128".
+     * @param prototype Botan's prototype of the algorithm, cloned if no hardware AES is used for it.
+     * @return New block cipher object. The caller takes ownership of it.
+     */
+    static Botan::BlockCipher* create(const std::string& algo, const Botan::BlockCipher* prototype);
+
+    /**
+     * Describes the AES and GHASH implementations selected for this CPU.
+     * @return For example "AES-NI, VAES, PCLMUL", or "portable" without any hardware support.
+     */
+    static const char* implementation();
+
+    /**
+     * Checks for the AES-NI instructions.
+     * @return True if AES-NI is used.
+     */
+    static bool hasAesNi();
+
+    /**
+     * Checks for the PCLMULQDQ instruction, used by ne7ssh_gcm for GHASH.
+     * @return True if PCLMULQDQ is used.
+     */
+    static bool hasClmul();
+
+    void encrypt_n(const Botan::byte in[], Botan::byte out[], size_t blocks) const;
+    void decrypt_n(const Botan::byte in[], Botan::byte out[], size_t blocks) const;
+
+    size_t block_size() const
+    {
+        return 16;
+    }
+
+    size_t parallelism() const
+    {
+        return 8;
+    }
+
+    Botan::Key_Length_Specification key_spec() const
+    {
+        return Botan::Key_Length_Specification(_keyLen);
+    }
+
+    void clear();
+    std::string name() const;
+    Botan::BlockCipher* clone() const;
+};
+
+#endif
@@ -0,0 +1,81 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_algorithms.h"
+#include <botan/libstate.h>
+
+using namespace Botan;
+
+namespace
+{
+// Everything ne7ssh_crypt can negotiate: ciphers, the block cipher under UMAC and the HMAC and key exchange hashes
+const char* const CIPHERS[] = { "TripleDES", "AES-128", "AES-192", "AES-256", "Blowfish", "CAST-128", "Twofish" };
+const char* const HASHES[] = { "MD5", "SHA-1", "SHA-256", "SHA-384", "SHA-512" };
+}
+
+ne7ssh_algorithms::ne7ssh_algorithms()
+{
+    Algorithm_Factory& af = global_state().algorithm_factory();
+    size_t i;
+
+    for (i = 0; i < sizeof(CIPHERS) / sizeof(CIPHERS[0]); i++)
+    {
+        if (const BlockCipher* bc = af.prototype_block_cipher(CIPHERS[i]))
+        {
+            _ciphers[CIPHERS[i]] = bc;
+        }
+    }
+    for (i = 0; i < sizeof(HASHES) / sizeof(HASHES[0]); i++)
+    {
+        if (const HashFunction* hash = af.prototype_hash_function(HASHES[i]))
+        {
+            _hashes[HASHES[i]] = hash;
+        }
+    }
+}
+
+const BlockCipher* ne7ssh_algorithms::blockCipher(const std::string& name) const
+{
+    std::map<std::string, const BlockCipher*>::const_iterator it = _ciphers.find(name);
+
+    if (it == _ciphers.end())
+    {
+        return NULL;
+    }
+    return it->second;
+}
+
+const HashFunction* ne7ssh_algorithms::hashFunction(const std::string& name) const
+{
+    std::map<std::string, const HashFunction*>::const_iterator it = _hashes.find(name);
+
+    if (it == _hashes.end())
+    {
+        return NULL;
+    }
+    return it->second;
+}
+
+HashFunction* ne7ssh_algorithms::makeHash(const std::string& name) const
+{
+    const HashFunction* hash = hashFunction(name);
+
+    if (!hash)
+    {
+        return NULL;
+    }
+    return hash->clone();
+}
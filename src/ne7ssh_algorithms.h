@@ -0,0 +1,69 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_ALGORITHMS_H
+#define NE7SSH_ALGORITHMS_H
+
+#include "ne7ssh_types.h"
+#include <botan/block_cipher.h>
+#include <botan/hash.h>
+#include <map>
+#include <string>
+
+/**
+ * Block cipher and hash prototypes shared by all connections.
+ * <p>Every cipher, MAC and key exchange hash the library negotiates is looked up in Botan's algorithm factory once,
+ * when the library is created, instead of on every handshake. The table is not changed afterwards, so it is read
+ * without locking. The prototypes belong to Botan and stay valid until the library is shut down.
+ */
+class ne7ssh_algorithms
+{
+private:
+    std::map<std::string, const Botan::BlockCipher*> _ciphers;
+    std::map<std::string, const Botan::HashFunction*> _hashes;
+
+    ne7ssh_algorithms(const ne7ssh_algorithms&);
+    ne7ssh_algorithms& operator=(const ne7ssh_algorithms&);
+
+public:
+    /**
+     * ne7ssh_algorithms class constructor. Resolves all prototypes.
+     */
+    ne7ssh_algorithms();
+
+    /**
+     * Returns the prototype of a block cipher.
+     * @param name Botan name of the cipher, for example "AES-128".
+     * @return The prototype, or NULL if the cipher is not available.
+     */
+    const Botan::BlockCipher* blockCipher(const std::string& name) const;
+
+    /**
+     * Returns the prototype of a hash function.
+     * @param name Botan name of the hash, for example "SHA-256".
+     * @return The prototype, or NULL if the hash is not available.
+     */
+    const Botan::HashFunction* hashFunction(const std::string& name) const;
+
+    /**
+     * Creates a new hash object from its prototype.
+     * @param name Botan name of the hash.
+     * @return New hash object owned by the caller, or NULL if the hash is not available.
+     */
+    Botan::HashFunction* makeHash(const std::string& name) const;
+};
+
+#endif
@@ -0,0 +1,97 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_buffer_pool.h"
+#include "ne7ssh_transport.h"
+
+using namespace Botan;
+
+const uint32 ne7ssh_buffer_pool::s_classSizes[NE7SSH_POOL_CLASSES] = { 256, 4096, MAX_PACKET_LEN + 256 };
+
+ne7ssh_buffer_pool::ne7ssh_buffer_pool()
+{
+}
+
+ne7ssh_buffer_pool::~ne7ssh_buffer_pool()
+{
+    uint32 i, j;
+
+    for (i = 0; i < NE7SSH_POOL_CLASSES; i++)
+    {
+        for (j = 0; j < _free[i].size(); j++)
+        {
+            delete _free[i][j];
+        }
+        _free[i].clear();
+    }
+}
+
+Botan::SecureVector<Botan::byte>* ne7ssh_buffer_pool::acquire(uint32 len, uint32& sizeClass)
+{
+    SecureVector<Botan::byte>* buffer;
+
+    for (sizeClass = 0; sizeClass < NE7SSH_POOL_CLASSES; sizeClass++)
+    {
+        if (len <= s_classSizes[sizeClass])
+        {
+            break;
+        }
+    }
+
+    // Oversized requests are served directly and never pooled.
+    if (sizeClass == NE7SSH_POOL_CLASSES)
+    {
+        buffer = new SecureVector<Botan::byte>(len);
+        buffer->resize(0);
+        return buffer;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_free[sizeClass].empty())
+        {
+            buffer = _free[sizeClass].back();
+            _free[sizeClass].pop_back();
+            return buffer;
+        }
+    }
+
+    // Allocate the whole class up front, MemoryRegion keeps it when resized down.
+    buffer = new SecureVector<Botan::byte>(s_classSizes[sizeClass]);
+    buffer->resize(0);
+    return buffer;
+}
+
+void ne7ssh_buffer_pool::release(Botan::SecureVector<Botan::byte>* buffer, uint32 sizeClass)
+{
+    if (!buffer)
+    {
+        return;
+    }
+
+    zeroise(*buffer);
+    buffer->clear();
+    if (sizeClass < NE7SSH_POOL_CLASSES)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_free[sizeClass].size() < NE7SSH_POOL_MAX_FREE)
+        {
+            _free[sizeClass].push_back(buffer);
+            return;
+        }
+    }
+    delete buffer;
+}
@@ -0,0 +1,113 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_BUFFER_POOL_H
+#define NE7SSH_BUFFER_POOL_H
+
+#include "ne7ssh_types.h"
+#include <botan/secmem.h>
+#include <vector>
+#include <mutex>
+
+#define NE7SSH_POOL_CLASSES     3
+#define NE7SSH_POOL_MAX_FREE    8
+
+/**
+ * Per connection pool of reusable packet buffers.
+ * <p>Buffers are handed out by size class (control messages, small payloads, full packets) and keep
+ * their allocation when returned, so the steady state data path does not go back to the allocator.
+ */
+class ne7ssh_buffer_pool
+{
+private:
+    static const uint32 s_classSizes[NE7SSH_POOL_CLASSES];
+    std::vector<Botan::SecureVector<Botan::byte>*> _free[NE7SSH_POOL_CLASSES];
+    std::mutex _mutex;
+
+    ne7ssh_buffer_pool(const ne7ssh_buffer_pool&);
+    ne7ssh_buffer_pool& operator=(const ne7ssh_buffer_pool&);
+
+public:
+    /**
+     * ne7ssh_buffer_pool class constructor.
+     */
+    ne7ssh_buffer_pool();
+
+    /**
+     * ne7ssh_buffer_pool class destructor. Frees all pooled buffers.
+     */
+    ~ne7ssh_buffer_pool();
+
+    /**
+     * Takes an empty buffer, able to hold at least len bytes, out of the pool.
+     * @param len Expected size of the data.
+     * @param sizeClass Set to the size class the buffer belongs to. Has to be passed back to release().
+     * @return Pointer to the buffer. Never NULL.
+     */
+    Botan::SecureVector<Botan::byte>* acquire(uint32 len, uint32& sizeClass);
+
+    /**
+     * Returns a buffer to the pool. The buffer is wiped and emptied.
+     * @param buffer Buffer previously returned by acquire().
+     * @param sizeClass Size class returned by acquire().
+     */
+    void release(Botan::SecureVector<Botan::byte>* buffer, uint32 sizeClass);
+};
+
+/**
+ * Scoped buffer taken from ne7ssh_buffer_pool, returned to the pool when it goes out of scope.
+ */
+class ne7ssh_pooled_buffer
+{
+private:
+    ne7ssh_buffer_pool& _pool;
+    Botan::SecureVector<Botan::byte>* _buffer;
+    uint32 _sizeClass;
+
+    ne7ssh_pooled_buffer(const ne7ssh_pooled_buffer&);
+    ne7ssh_pooled_buffer& operator=(const ne7ssh_pooled_buffer&);
+
+public:
+    /**
+     * ne7ssh_pooled_buffer class constructor.
+     * @param pool Pool to take the buffer from.
+     * @param len Expected size of the data.
+     */
+    ne7ssh_pooled_buffer(ne7ssh_buffer_pool& pool, uint32 len)
+        : _pool(pool),
+        _buffer(pool.acquire(len, _sizeClass))
+    {
+    }
+
+    /**
+     * ne7ssh_pooled_buffer class destructor. Returns the buffer to the pool.
+     */
+    ~ne7ssh_pooled_buffer()
+    {
+        _pool.release(_buffer, _sizeClass);
+    }
+
+    /**
+     * Returns the pooled buffer.
+     * @return Reference to the buffer.
+     */
+    Botan::SecureVector<Botan::byte> &value()
+    {
+        return *_buffer;
+    }
+};
+
+#endif
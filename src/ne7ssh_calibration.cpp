@@ -0,0 +1,284 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_calibration.h"
+#include "ne7ssh_session.h"
+#include "ne7ssh_crypt.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <sstream>
+#include <string.h>
+
+using namespace Botan;
+
+namespace
+{
+// Costs less than this factor apart end up in the same bucket and are treated as equal
+const double COST_BUCKET = 1.15;
+}
+
+ne7ssh_calibration::ne7ssh_calibration()
+    : _session(new ne7ssh_session()),
+    _crypt(new ne7ssh_crypt(_session))
+{
+}
+
+ne7ssh_calibration::~ne7ssh_calibration()
+{
+}
+
+bool ne7ssh_calibration::init()
+{
+    ne7ssh_crypt peer(_session);
+    SecureVector<Botan::byte> kex = toVector("curve25519-sha256");
+    SecureVector<Botan::byte> e, f, k, h;
+
+    if (!_crypt->negotiatedKex(kex) || !peer.negotiatedKex(kex))
+    {
+        return false;
+    }
+    if (!_crypt->getKexPublic(e) || !peer.getKexPublic(f) || !_crypt->makeKexSecret(k, f) || !_crypt->computeH(h, e))
+    {
+        return false;
+    }
+    _session->setSessionID(h);
+    return true;
+}
+
+std::shared_ptr<ne7ssh_crypt> ne7ssh_calibration::keyPair(const std::string& cipher, const std::string& mac)
+{
+    SecureVector<Botan::byte> cipherName = toVector(cipher);
+    SecureVector<Botan::byte> macName = toVector(mac);
+
+    if (!_crypt->negotiatedCryptoC2s(cipherName) || !_crypt->negotiatedCryptoS2c(cipherName) ||
+        !_crypt->negotiatedMacC2s(macName) || !_crypt->negotiatedMacS2c(macName) || !_crypt->makeNewKeys(true))
+    {
+        return std::shared_ptr<ne7ssh_crypt>();
+    }
+    return _crypt;
+}
+
+void ne7ssh_calibration::buildPacket(Botan::SecureVector<Botan::byte>& packet, ne7ssh_crypt& crypt, uint32 payloadLen)
+{
+    uint32 block = crypt.getEncryptBlock() ? crypt.getEncryptBlock() : 8;
+    uint32 lenFieldSize = crypt.isAadOut() ? 0 : sizeof(uint32);
+    uint32 padLen = 3 + block - ((payloadLen + 1 + 3 + lenFieldSize) % block);
+    uint32 packetLen = 1 + payloadLen + padLen;
+
+    packet.resize(sizeof(uint32) + packetLen);
+    packet[0] = (Botan::byte)(packetLen >> 24);
+    packet[1] = (Botan::byte)(packetLen >> 16);
+    packet[2] = (Botan::byte)(packetLen >> 8);
+    packet[3] = (Botan::byte)packetLen;
+    packet[4] = (Botan::byte)padLen;
+    memset(packet.begin() + 5, 0x5a, payloadLen);
+    memset(packet.begin() + 5 + payloadLen, 0, padLen);
+}
+
+bool ne7ssh_calibration::receivePacket(Botan::SecureVector<Botan::byte>& decrypted, ne7ssh_crypt& crypt, Botan::SecureVector<Botan::byte>& packet, uint32 seq)
+{
+    uint32 cryptoLen;
+
+    if (crypt.isAadIn())
+    {
+        cryptoLen = crypt.getAadPacketLength(packet.begin(), seq) + sizeof(uint32);
+        return crypt.decryptAadPacket(decrypted, packet.begin(), cryptoLen, seq);
+    }
+
+    cryptoLen = packet.size() - crypt.getMacInLen();
+    if (!crypt.decryptPacket(decrypted, packet.begin(), cryptoLen))
+    {
+        return false;
+    }
+    if (crypt.getMacInLen())
+    {
+        return crypt.verifyMac(decrypted.begin(), decrypted.size(), packet.begin() + cryptoLen, seq);
+    }
+    return true;
+}
+
+std::vector<std::string> ne7ssh_calibration::splitList(const std::string& list)
+{
+    std::vector<std::string> result;
+    std::istringstream in(list);
+    std::string item;
+
+    while (std::getline(in, item, ','))
+    {
+        result.push_back(item);
+    }
+    return result;
+}
+
+Botan::SecureVector<Botan::byte> ne7ssh_calibration::toVector(const std::string& str)
+{
+    return SecureVector<Botan::byte>((const Botan::byte*)str.c_str(), str.length());
+}
+
+bool ne7ssh_calibration::measure(double& cost, const std::string& cipher, const std::string& mac)
+{
+    std::chrono::steady_clock::time_point start;
+    std::chrono::microseconds elapsed(0);
+    SecureVector<Botan::byte> plain;
+    uint32 packets = 0;
+
+    // The cost of a packet counts both ends of the connection
+    if (!keyPair(cipher, mac))
+    {
+        return false;
+    }
+    buildPacket(plain, *_crypt, NE7SSH_CALIBRATION_PAYLOAD);
+
+    start = std::chrono::steady_clock::now();
+    do
+    {
+        // Encryption is in place, only the header has to be put back
+        _packet.resize(plain.size());
+        memcpy(_packet.begin(), plain.begin(), 5);
+        if (!_crypt->encryptPacket(_packet, packets) || !receivePacket(_decrypted, *_crypt, _packet, packets))
+        {
+            return false;
+        }
+        packets++;
+        elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    } while (elapsed.count() < NE7SSH_CALIBRATION_USEC);
+
+    cost = (double)elapsed.count() / packets;
+    return true;
+}
+
+int ne7ssh_calibration::tier(const std::string& name)
+{
+    if (name == "none")
+    {
+        return TIER_NONE;
+    }
+    if ((name.find("md5") != std::string::npos) || (name.find("sha1") != std::string::npos) ||
+        (name.find("-cbc") != std::string::npos))
+    {
+        return TIER_FIXED;
+    }
+    if ((name.find("-gcm@") != std::string::npos) || (name.find("-poly1305@") != std::string::npos) ||
+        (name.find("-etm@") != std::string::npos))
+    {
+        return 0;
+    }
+    if ((name.find("-ctr") != std::string::npos) || !name.compare(0, 9, "hmac-sha2") || !name.compare(0, 5, "umac-"))
+    {
+        return 1;
+    }
+    return TIER_FIXED;
+}
+
+std::string ne7ssh_calibration::rank(const std::vector<std::string>& names, const std::vector<double>& costs)
+{
+    std::vector<std::pair<std::pair<int, int>, size_t> > order;
+    std::string result;
+    int level, bucket;
+    size_t i;
+
+    for (i = 0; i < names.size(); i++)
+    {
+        level = tier(names[i]);
+        if (level >= TIER_FIXED)
+        {
+            bucket = 0;
+        }
+        else if (costs[i] <= 0)
+        {
+            bucket = INT_MAX;
+        }
+        else
+        {
+            bucket = (int)floor(log(costs[i]) / log(COST_BUCKET));
+        }
+        order.push_back(std::make_pair(std::make_pair(level, bucket), i));
+    }
+    // Entries compare by tier, then bucket, then original position, so ties keep the original order
+    std::sort(order.begin(), order.end());
+
+    for (i = 0; i < order.size(); i++)
+    {
+        if (i)
+        {
+            result += ',';
+        }
+        result += names[order[i].second];
+    }
+    return result;
+}
+
+bool ne7ssh_calibration::run(std::string& ciphers, std::string& macs)
+{
+    std::vector<std::string> cipherNames = splitList(ciphers);
+    std::vector<std::string> macNames = splitList(macs);
+    std::vector<double> cipherCosts(cipherNames.size(), -1);
+    std::vector<double> macCosts(macNames.size(), -1);
+    std::string baseCipher, defaultMac = "none";
+    double baseCost = 0;
+    size_t i;
+
+    if (!init())
+    {
+        return false;
+    }
+
+    for (i = 0; i < macNames.size(); i++)
+    {
+        if (macNames[i] != "none")
+        {
+            defaultMac = macNames[i];
+            break;
+        }
+    }
+
+    // Ciphers with the MAC they would get by default. AEAD ciphers include their tag and ignore the MAC.
+    for (i = 0; i < cipherNames.size(); i++)
+    {
+        if (tier(cipherNames[i]) >= TIER_FIXED)
+        {
+            continue;
+        }
+        if (!measure(cipherCosts[i], cipherNames[i], defaultMac))
+        {
+            cipherCosts[i] = -1;
+            continue;
+        }
+        if (!_crypt->isAeadOut() && (baseCipher.empty() || (cipherCosts[i] < baseCost)))
+        {
+            baseCipher = cipherNames[i];
+            baseCost = cipherCosts[i];
+        }
+    }
+
+    // MACs on top of the fastest cipher they can be combined with
+    if (!baseCipher.empty())
+    {
+        for (i = 0; i < macNames.size(); i++)
+        {
+            if ((tier(macNames[i]) < TIER_FIXED) && !measure(macCosts[i], baseCipher, macNames[i]))
+            {
+                macCosts[i] = -1;
+            }
+        }
+    }
+
+    ciphers = rank(cipherNames, cipherCosts);
+    macs = rank(macNames, macCosts);
+    return true;
+}
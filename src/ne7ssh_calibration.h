@@ -0,0 +1,155 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_CALIBRATION_H
+#define NE7SSH_CALIBRATION_H
+
+#include "ne7ssh_types.h"
+#include <botan/secmem.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define NE7SSH_CALIBRATION_PAYLOAD 16384
+#define NE7SSH_CALIBRATION_USEC 2000
+
+class ne7ssh_session;
+class ne7ssh_crypt;
+
+/**
+ * Measures how fast the local CPU runs the supported ciphers and MACs.
+ * <p>Keys come from a curve25519-sha256 exchange done locally. The crypt object is then re-keyed in loopback mode
+ * for every algorithm, and NE7SSH_CALIBRATION_PAYLOAD byte packets are sealed with encryptPacket() for NE7SSH_CALIBRATION_USEC
+ * microseconds each, and opened again the way they are received.
+ * <p>Speed only breaks ties inside a security tier: AEAD ciphers come before CTR ciphers, and encrypt-then-MAC
+ * MACs before the other SHA-2 and UMAC MACs. CBC ciphers, MD5 and SHA-1 are never measured and keep their compiled-in
+ * place after those.
+ * Used by ne7ssh::create() when calibration was asked for. The keying and packet framing helpers are public, the
+ * cryptoBench example measures with them too.
+ */
+class ne7ssh_calibration
+{
+private:
+    std::shared_ptr<ne7ssh_session> _session;
+    std::shared_ptr<ne7ssh_crypt> _crypt;
+    Botan::SecureVector<Botan::byte> _packet;
+    Botan::SecureVector<Botan::byte> _decrypted;
+
+    ne7ssh_calibration(const ne7ssh_calibration&);
+    ne7ssh_calibration& operator=(const ne7ssh_calibration&);
+
+    /**
+     * Keys the crypt object for a cipher and MAC pair, and times sealing and opening packets with it.
+     * @param cost Receives the time in microseconds needed to seal and open one packet.
+     * @param cipher Cipher name as used in the SSH protocol.
+     * @param mac MAC name as used in the SSH protocol.
+     * @return True if the pair could be set up and measured, otherwise false is returned.
+     */
+    bool measure(double& cost, const std::string& cipher, const std::string& mac);
+
+    /**
+     * Gets the security tier of a cipher or MAC.
+     * @param name Algorithm name as used in the SSH protocol.
+     * @return 0 for AEAD ciphers and encrypt-then-MAC MACs, 1 for CTR ciphers and the other SHA-2 and UMAC MACs,
+     *  TIER_FIXED for algorithms that are never reordered, and TIER_NONE for "none".
+     */
+    static int tier(const std::string& name);
+
+    /**
+     * Orders an algorithm list by security tier first, and by the cost of each entry within a tier.
+     * <p>Costs within a few percent of each other count as equal and keep their original order.
+     * Entries of TIER_FIXED keep their original order. Algorithms that failed to measure go to the end of their tier.
+     * @param names Algorithm names in their original order.
+     * @param costs Cost of each name, negative if it could not be measured.
+     * @return The ordered comma separated list.
+     */
+    static std::string rank(const std::vector<std::string>& names, const std::vector<double>& costs);
+
+public:
+    /** Tier of algorithms that are never promoted by speed: CBC ciphers, MD5 and SHA-1. */
+    static const int TIER_FIXED = 2;
+
+    /** Tier of "none", always last. */
+    static const int TIER_NONE = 3;
+
+    /**
+     * ne7ssh_calibration class constructor.
+     */
+    ne7ssh_calibration();
+
+    /**
+     * ne7ssh_calibration class destructor.
+     */
+    ~ne7ssh_calibration();
+
+    /**
+     * Runs the local key exchange, so the crypt object can be keyed.
+     * @return True on success, otherwise false is returned.
+     */
+    bool init();
+
+    /**
+     * Re-keys the crypt object for a cipher and MAC pair, in loopback mode so it decrypts its own packets.
+     * <p>init() has to succeed first. Every call re-keys the same object.
+     * @param cipher Cipher name as used in the SSH protocol.
+     * @param mac MAC name as used in the SSH protocol. Ignored by AEAD ciphers.
+     * @return The keyed crypt object, or an empty pointer if the pair is not supported.
+     */
+    std::shared_ptr<ne7ssh_crypt> keyPair(const std::string& cipher, const std::string& mac);
+
+    /**
+     * Builds an unencrypted packet the way ne7ssh_transport::sendPacket() frames it.
+     * @param packet Receives the length field, padding length, payload and padding.
+     * @param crypt Crypt object the packet is meant for, it sets the block size.
+     * @param payloadLen Length of the payload.
+     */
+    static void buildPacket(Botan::SecureVector<Botan::byte>& packet, ne7ssh_crypt& crypt, uint32 payloadLen);
+
+    /**
+     * Decrypts and authenticates a packet the way ne7ssh_transport::waitForPacket() does.
+     * @param decrypted Receives the decrypted packet.
+     * @param crypt Crypt object keyed in loopback mode.
+     * @param packet Encrypted packet followed by its MAC or tag.
+     * @param seq Sequence number the packet was encrypted with.
+     * @return True if the packet authenticated, otherwise false is returned.
+     */
+    static bool receivePacket(Botan::SecureVector<Botan::byte>& decrypted, ne7ssh_crypt& crypt, Botan::SecureVector<Botan::byte>& packet, uint32 seq);
+
+    /**
+     * Splits a comma separated algorithm list.
+     * @param list The list.
+     * @return The names, in list order.
+     */
+    static std::vector<std::string> splitList(const std::string& list);
+
+    /**
+     * Copies a string into a vector, the form the ne7ssh_crypt negotiation methods take.
+     * @param str The string.
+     * @return The vector.
+     */
+    static Botan::SecureVector<Botan::byte> toVector(const std::string& str);
+
+    /**
+     * Measures the algorithms and orders the lists, fastest first within each security tier.
+     * <p>Ciphers without an AEAD mode are measured together with the first MAC of the list that is not "none".
+     * @param ciphers Comma separated list of ciphers, reordered in place.
+     * @param macs Comma separated list of MACs, reordered in place.
+     * @return True on success. On failure false is returned and both lists are left as they were.
+     */
+    bool run(std::string& ciphers, std::string& macs);
+};
+
+#endif
@@ -0,0 +1,365 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_chacha20.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#   define NE7SSH_CHACHA_SSE2
+#   include <emmintrin.h>
+#endif
+#if defined(NE7SSH_CHACHA_SSE2) && defined(__GNUC__) && ((__GNUC__ >= 5) || defined(__clang__))
+#   define NE7SSH_CHACHA_AVX2
+#   include <immintrin.h>
+#endif
+#if defined(NE7SSH_CHACHA_SSE2)
+#   include <botan/cpuid.h>
+#endif
+
+using namespace Botan;
+
+#define CHACHA_BLOCK 64
+
+namespace
+{
+typedef void (*chacha_blocks_fn)(uint32* state, const Botan::byte* in, Botan::byte* out, uint32 blocks);
+
+uint32 load32(const Botan::byte* in)
+{
+    return (uint32)in[0] | ((uint32)in[1] << 8) | ((uint32)in[2] << 16) | ((uint32)in[3] << 24);
+}
+
+void store32(Botan::byte* out, uint32 val)
+{
+    out[0] = (Botan::byte)val;
+    out[1] = (Botan::byte)(val >> 8);
+    out[2] = (Botan::byte)(val >> 16);
+    out[3] = (Botan::byte)(val >> 24);
+}
+
+uint64 getCounter(const uint32* state)
+{
+    return (uint64)state[12] | ((uint64)state[13] << 32);
+}
+
+void setCounter(uint32* state, uint64 counter)
+{
+    state[12] = (uint32)counter;
+    state[13] = (uint32)(counter >> 32);
+}
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define QUARTERROUND(a, b, c, d) \
+    a += b; d ^= a; d = ROTL32(d, 16); \
+    c += d; b ^= c; b = ROTL32(b, 12); \
+    a += b; d ^= a; d = ROTL32(d, 8); \
+    c += d; b ^= c; b = ROTL32(b, 7);
+
+void chachaBlocksScalar(uint32* state, const Botan::byte* in, Botan::byte* out, uint32 blocks)
+{
+    uint32 x[16];
+    int i;
+
+    while (blocks--)
+    {
+        memcpy(x, state, sizeof(x));
+        for (i = 0; i < 10; i++)
+        {
+            QUARTERROUND(x[0], x[4], x[8], x[12])
+            QUARTERROUND(x[1], x[5], x[9], x[13])
+            QUARTERROUND(x[2], x[6], x[10], x[14])
+            QUARTERROUND(x[3], x[7], x[11], x[15])
+            QUARTERROUND(x[0], x[5], x[10], x[15])
+            QUARTERROUND(x[1], x[6], x[11], x[12])
+            QUARTERROUND(x[2], x[7], x[8], x[13])
+            QUARTERROUND(x[3], x[4], x[9], x[14])
+        }
+        for (i = 0; i < 16; i++)
+        {
+            store32(out + 4 * i, load32(in + 4 * i) ^ (x[i] + state[i]));
+        }
+        setCounter(state, getCounter(state) + 1);
+        in += CHACHA_BLOCK;
+        out += CHACHA_BLOCK;
+    }
+}
+
+#ifdef NE7SSH_CHACHA_SSE2
+#define ROTL_SSE2(v, n) _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+#define QUARTERROUND_SSE2(a, b, c, d) \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = ROTL_SSE2(d, 16); \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = ROTL_SSE2(b, 12); \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = ROTL_SSE2(d, 8); \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = ROTL_SSE2(b, 7);
+
+// Four blocks at a time, each vector holds the same state word of all four blocks
+void chachaBlocksSse2(uint32* state, const Botan::byte* in, Botan::byte* out, uint32 blocks)
+{
+    __m128i x[16], orig[16], t0, t1, t2, t3;
+    uint64 counter;
+    int i, j;
+
+    while (blocks >= 4)
+    {
+        counter = getCounter(state);
+        for (i = 0; i < 16; i++)
+        {
+            x[i] = _mm_set1_epi32((int)state[i]);
+        }
+        x[12] = _mm_setr_epi32((int)(uint32)counter, (int)(uint32)(counter + 1), (int)(uint32)(counter + 2), (int)(uint32)(counter + 3));
+        x[13] = _mm_setr_epi32((int)(uint32)(counter >> 32), (int)(uint32)((counter + 1) >> 32), (int)(uint32)((counter + 2) >> 32), (int)(uint32)((counter + 3) >> 32));
+        for (i = 0; i < 16; i++)
+        {
+            orig[i] = x[i];
+        }
+
+        for (i = 0; i < 10; i++)
+        {
+            QUARTERROUND_SSE2(x[0], x[4], x[8], x[12])
+            QUARTERROUND_SSE2(x[1], x[5], x[9], x[13])
+            QUARTERROUND_SSE2(x[2], x[6], x[10], x[14])
+            QUARTERROUND_SSE2(x[3], x[7], x[11], x[15])
+            QUARTERROUND_SSE2(x[0], x[5], x[10], x[15])
+            QUARTERROUND_SSE2(x[1], x[6], x[11], x[12])
+            QUARTERROUND_SSE2(x[2], x[7], x[8], x[13])
+            QUARTERROUND_SSE2(x[3], x[4], x[9], x[14])
+        }
+
+        for (i = 0; i < 16; i += 4)
+        {
+            // Transpose four words of four blocks back into block order
+            t0 = _mm_add_epi32(x[i], orig[i]);
+            t1 = _mm_add_epi32(x[i + 1], orig[i + 1]);
+            t2 = _mm_add_epi32(x[i + 2], orig[i + 2]);
+            t3 = _mm_add_epi32(x[i + 3], orig[i + 3]);
+            x[i] = _mm_unpacklo_epi32(t0, t1);
+            x[i + 1] = _mm_unpacklo_epi32(t2, t3);
+            x[i + 2] = _mm_unpackhi_epi32(t0, t1);
+            x[i + 3] = _mm_unpackhi_epi32(t2, t3);
+            t0 = _mm_unpacklo_epi64(x[i], x[i + 1]);
+            t1 = _mm_unpackhi_epi64(x[i], x[i + 1]);
+            t2 = _mm_unpacklo_epi64(x[i + 2], x[i + 3]);
+            t3 = _mm_unpackhi_epi64(x[i + 2], x[i + 3]);
+
+            j = 4 * i;
+            _mm_storeu_si128((__m128i*)(out + j), _mm_xor_si128(t0, _mm_loadu_si128((const __m128i*)(in + j))));
+            j += CHACHA_BLOCK;
+            _mm_storeu_si128((__m128i*)(out + j), _mm_xor_si128(t1, _mm_loadu_si128((const __m128i*)(in + j))));
+            j += CHACHA_BLOCK;
+            _mm_storeu_si128((__m128i*)(out + j), _mm_xor_si128(t2, _mm_loadu_si128((const __m128i*)(in + j))));
+            j += CHACHA_BLOCK;
+            _mm_storeu_si128((__m128i*)(out + j), _mm_xor_si128(t3, _mm_loadu_si128((const __m128i*)(in + j))));
+        }
+
+        setCounter(state, counter + 4);
+        in += 4 * CHACHA_BLOCK;
+        out += 4 * CHACHA_BLOCK;
+        blocks -= 4;
+    }
+    chachaBlocksScalar(state, in, out, blocks);
+}
+#endif
+
+#ifdef NE7SSH_CHACHA_AVX2
+#define ROTL_AVX2(v, n) _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+#define QUARTERROUND_AVX2(a, b, c, d) \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = ROTL_AVX2(d, 16); \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); b = ROTL_AVX2(b, 12); \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = ROTL_AVX2(d, 8); \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); b = ROTL_AVX2(b, 7);
+
+// Eight blocks at a time, same layout as the SSE2 version with blocks 4 to 7 in the upper lanes
+__attribute__((target("avx2")))
+void chachaBlocksAvx2(uint32* state, const Botan::byte* in, Botan::byte* out, uint32 blocks)
+{
+    __m256i x[16], orig[16], t0, t1, t2, t3;
+    uint64 counter;
+    uint32 lo[8], hi[8];
+    int i, j, k;
+
+    while (blocks >= 8)
+    {
+        counter = getCounter(state);
+        for (i = 0; i < 16; i++)
+        {
+            x[i] = _mm256_set1_epi32((int)state[i]);
+        }
+        for (k = 0; k < 8; k++)
+        {
+            lo[k] = (uint32)(counter + k);
+            hi[k] = (uint32)((counter + k) >> 32);
+        }
+        x[12] = _mm256_loadu_si256((const __m256i*)lo);
+        x[13] = _mm256_loadu_si256((const __m256i*)hi);
+        for (i = 0; i < 16; i++)
+        {
+            orig[i] = x[i];
+        }
+
+        for (i = 0; i < 10; i++)
+        {
+            QUARTERROUND_AVX2(x[0], x[4], x[8], x[12])
+            QUARTERROUND_AVX2(x[1], x[5], x[9], x[13])
+            QUARTERROUND_AVX2(x[2], x[6], x[10], x[14])
+            QUARTERROUND_AVX2(x[3], x[7], x[11], x[15])
+            QUARTERROUND_AVX2(x[0], x[5], x[10], x[15])
+            QUARTERROUND_AVX2(x[1], x[6], x[11], x[12])
+            QUARTERROUND_AVX2(x[2], x[7], x[8], x[13])
+            QUARTERROUND_AVX2(x[3], x[4], x[9], x[14])
+        }
+
+        for (i = 0; i < 16; i += 4)
+        {
+            t0 = _mm256_add_epi32(x[i], orig[i]);
+            t1 = _mm256_add_epi32(x[i + 1], orig[i + 1]);
+            t2 = _mm256_add_epi32(x[i + 2], orig[i + 2]);
+            t3 = _mm256_add_epi32(x[i + 3], orig[i + 3]);
+            x[i] = _mm256_unpacklo_epi32(t0, t1);
+            x[i + 1] = _mm256_unpacklo_epi32(t2, t3);
+            x[i + 2] = _mm256_unpackhi_epi32(t0, t1);
+            x[i + 3] = _mm256_unpackhi_epi32(t2, t3);
+            t0 = _mm256_unpacklo_epi64(x[i], x[i + 1]);
+            t1 = _mm256_unpackhi_epi64(x[i], x[i + 1]);
+            t2 = _mm256_unpacklo_epi64(x[i + 2], x[i + 3]);
+            t3 = _mm256_unpackhi_epi64(x[i + 2], x[i + 3]);
+
+            // Lower lanes belong to blocks 0 to 3, upper lanes to blocks 4 to 7
+            j = 4 * i;
+            _mm_storeu_si128((__m128i*)(out + j), _mm_xor_si128(_mm256_castsi256_si128(t0), _mm_loadu_si128((const __m128i*)(in + j))));
+            _mm_storeu_si128((__m128i*)(out + j + 4 * CHACHA_BLOCK), _mm_xor_si128(_mm256_extracti128_si256(t0, 1), _mm_loadu_si128((const __m128i*)(in + j + 4 * CHACHA_BLOCK))));
+            j += CHACHA_BLOCK;
+            _mm_storeu_si128((__m128i*)(out + j), _mm_xor_si128(_mm256_castsi256_si128(t1), _mm_loadu_si128((const __m128i*)(in + j))));
+            _mm_storeu_si128((__m128i*)(out + j + 4 * CHACHA_BLOCK), _mm_xor_si128(_mm256_extracti128_si256(t1, 1), _mm_loadu_si128((const __m128i*)(in + j + 4 * CHACHA_BLOCK))));
+            j += CHACHA_BLOCK;
+            _mm_storeu_si128((__m128i*)(out + j), _mm_xor_si128(_mm256_castsi256_si128(t2), _mm_loadu_si128((const __m128i*)(in + j))));
+            _mm_storeu_si128((__m128i*)(out + j + 4 * CHACHA_BLOCK), _mm_xor_si128(_mm256_extracti128_si256(t2, 1), _mm_loadu_si128((const __m128i*)(in + j + 4 * CHACHA_BLOCK))));
+            j += CHACHA_BLOCK;
+            _mm_storeu_si128((__m128i*)(out + j), _mm_xor_si128(_mm256_castsi256_si128(t3), _mm_loadu_si128((const __m128i*)(in + j))));
+            _mm_storeu_si128((__m128i*)(out + j + 4 * CHACHA_BLOCK), _mm_xor_si128(_mm256_extracti128_si256(t3, 1), _mm_loadu_si128((const __m128i*)(in + j + 4 * CHACHA_BLOCK))));
+        }
+
+        setCounter(state, counter + 8);
+        in += 8 * CHACHA_BLOCK;
+        out += 8 * CHACHA_BLOCK;
+        blocks -= 8;
+    }
+    chachaBlocksSse2(state, in, out, blocks);
+}
+#endif
+
+chacha_blocks_fn selectBlocks()
+{
+#ifdef NE7SSH_CHACHA_AVX2
+    if (CPUID::has_avx2())
+    {
+        return chachaBlocksAvx2;
+    }
+#endif
+#ifdef NE7SSH_CHACHA_SSE2
+    if (CPUID::has_sse2())
+    {
+        return chachaBlocksSse2;
+    }
+#endif
+    return chachaBlocksScalar;
+}
+
+chacha_blocks_fn& chachaBlocks()
+{
+    static chacha_blocks_fn fn = selectBlocks();
+    return fn;
+}
+}
+
+bool ne7ssh_chacha20::forceImplementation(implementations impl)
+{
+    switch (impl)
+    {
+        case AUTO:
+            chachaBlocks() = selectBlocks();
+            return true;
+
+        case SCALAR:
+            chachaBlocks() = chachaBlocksScalar;
+            return true;
+
+#ifdef NE7SSH_CHACHA_SSE2
+        case SSE2:
+            if (!CPUID::has_sse2())
+            {
+                return false;
+            }
+            chachaBlocks() = chachaBlocksSse2;
+            return true;
+#endif
+
+#ifdef NE7SSH_CHACHA_AVX2
+        case AVX2:
+            if (!CPUID::has_avx2())
+            {
+                return false;
+            }
+            chachaBlocks() = chachaBlocksAvx2;
+            return true;
+#endif
+
+        default:
+            return false;
+    }
+}
+
+ne7ssh_chacha20::ne7ssh_chacha20(const Botan::byte* key)
+    : _state(16)
+{
+    int i;
+
+    // "expand 32-byte k"
+    _state[0] = 0x61707865;
+    _state[1] = 0x3320646e;
+    _state[2] = 0x79622d32;
+    _state[3] = 0x6b206574;
+    for (i = 0; i < 8; i++)
+    {
+        _state[4 + i] = load32(key + 4 * i);
+    }
+}
+
+void ne7ssh_chacha20::setNonce(const Botan::byte* nonce, uint64 counter)
+{
+    setCounter(_state.begin(), counter);
+    _state[14] = load32(nonce);
+    _state[15] = load32(nonce + 4);
+}
+
+void ne7ssh_chacha20::cipher(const Botan::byte* in, Botan::byte* out, uint32 len)
+{
+    Botan::byte block[CHACHA_BLOCK];
+    uint32 blocks = len / CHACHA_BLOCK;
+    uint32 rest = len % CHACHA_BLOCK;
+
+    if (blocks)
+    {
+        chachaBlocks()(_state.begin(), in, out, blocks);
+    }
+    if (rest)
+    {
+        memset(block, 0, sizeof(block));
+        memcpy(block, in + blocks * CHACHA_BLOCK, rest);
+        chachaBlocks()(_state.begin(), block, block, 1);
+        memcpy(out + blocks * CHACHA_BLOCK, block, rest);
+        memset(block, 0, sizeof(block));
+    }
+}
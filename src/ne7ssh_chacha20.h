@@ -0,0 +1,68 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_CHACHA20_H
+#define NE7SSH_CHACHA20_H
+
+#include "ne7ssh_types.h"
+#include <botan/secmem.h>
+
+/**
+ * ChaCha20 stream cipher, original variant with a 64 bit nonce and a 64 bit block counter.
+ * <p>This is the variant used by chacha20-poly1305@openssh.com. Botan 1.10 does not provide it.
+ * Blocks are generated by an SSE2 or AVX2 implementation when the CPU supports it, otherwise by
+ * portable scalar code. The choice is made once, on first use.
+ */
+class ne7ssh_chacha20
+{
+private:
+    Botan::SecureVector<uint32> _state;
+
+public:
+    enum implementations { AUTO, SCALAR, SSE2, AVX2 };
+
+    /**
+     * Replaces the implementation chosen from the CPU features, for known answer tests.
+     * <p>Not thread safe, call it while no ChaCha20 cipher is in use.
+     * @param impl Implementation to use from now on, AUTO goes back to the one the CPU features select.
+     * @return True if the implementation is compiled in and the CPU supports it, otherwise false is returned.
+     */
+    static bool forceImplementation(implementations impl);
+
+    /**
+     * ne7ssh_chacha20 class constructor.
+     * @param key Pointer to a 32 byte key.
+     */
+    ne7ssh_chacha20(const Botan::byte* key);
+
+    /**
+     * Sets the nonce and the block counter.
+     * @param nonce Pointer to an 8 byte nonce. SSH uses the big endian packet sequence number.
+     * @param counter Block counter to start from.
+     */
+    void setNonce(const Botan::byte* nonce, uint64 counter);
+
+    /**
+     * XORs keystream into the data.
+     * <p>Every call starts at a block boundary, the keystream left over from a partial last block is dropped.
+     * @param in Pointer to the input data.
+     * @param out Pointer to the output buffer. Can be the same as in.
+     * @param len Length of the data.
+     */
+    void cipher(const Botan::byte* in, Botan::byte* out, uint32 len);
+};
+
+#endif
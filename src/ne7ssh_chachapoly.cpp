@@ -0,0 +1,107 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_chachapoly.h"
+#include "ne7ssh_poly1305.h"
+#include <string.h>
+
+using namespace Botan;
+
+namespace
+{
+void makeNonce(Botan::byte* nonce, uint32 seq)
+{
+    memset(nonce, 0, 4);
+    nonce[4] = (Botan::byte)(seq >> 24);
+    nonce[5] = (Botan::byte)(seq >> 16);
+    nonce[6] = (Botan::byte)(seq >> 8);
+    nonce[7] = (Botan::byte)seq;
+}
+}
+
+ne7ssh_chachapoly::ne7ssh_chachapoly(const Botan::byte* key)
+    : _main(key),
+    _header(key + 32)
+{
+}
+
+void ne7ssh_chachapoly::authenticate(Botan::byte* tag, const Botan::byte* packet, uint32 len, const Botan::byte* nonce)
+{
+    Botan::byte polyKey[NE7SSH_POLY1305_KEY_LEN];
+
+    memset(polyKey, 0, sizeof(polyKey));
+    _main.setNonce(nonce, 0);
+    _main.cipher(polyKey, polyKey, sizeof(polyKey));
+
+    ne7ssh_poly1305 poly(polyKey);
+    memset(polyKey, 0, sizeof(polyKey));
+    poly.update(packet, len);
+    poly.final(tag);
+
+    _main.setNonce(nonce, 1);
+}
+
+uint32 ne7ssh_chachapoly::getLength(const Botan::byte* packet, uint32 seq)
+{
+    Botan::byte nonce[8];
+    Botan::byte len[4];
+
+    makeNonce(nonce, seq);
+    _header.setNonce(nonce, 0);
+    _header.cipher(packet, len, sizeof(len));
+    return ((uint32)len[0] << 24) | ((uint32)len[1] << 16) | ((uint32)len[2] << 8) | (uint32)len[3];
+}
+
+void ne7ssh_chachapoly::seal(Botan::byte* packet, uint32 len, Botan::byte* tag, uint32 seq)
+{
+    Botan::byte nonce[8];
+
+    makeNonce(nonce, seq);
+    _header.setNonce(nonce, 0);
+    _header.cipher(packet, packet, sizeof(uint32));
+    _main.setNonce(nonce, 1);
+    _main.cipher(packet + sizeof(uint32), packet + sizeof(uint32), len - sizeof(uint32));
+    authenticate(tag, packet, len, nonce);
+}
+
+bool ne7ssh_chachapoly::open(Botan::byte* packet, uint32 len, const Botan::byte* tag, uint32 seq)
+{
+    Botan::byte nonce[8];
+    Botan::byte ourTag[NE7SSH_CHACHAPOLY_TAG_LEN];
+    Botan::byte diff = 0;
+    uint32 i;
+
+    if (len < sizeof(uint32))
+    {
+        return false;
+    }
+
+    makeNonce(nonce, seq);
+    authenticate(ourTag, packet, len, nonce);
+    for (i = 0; i < NE7SSH_CHACHAPOLY_TAG_LEN; i++)
+    {
+        diff |= ourTag[i] ^ tag[i];
+    }
+    if (diff)
+    {
+        return false;
+    }
+
+    _header.setNonce(nonce, 0);
+    _header.cipher(packet, packet, sizeof(uint32));
+    _main.cipher(packet + sizeof(uint32), packet + sizeof(uint32), len - sizeof(uint32));
+    return true;
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_CHACHAPOLY_H
+#define NE7SSH_CHACHAPOLY_H
+
+#include "ne7ssh_chacha20.h"
+
+#define NE7SSH_CHACHAPOLY_KEY_LEN 64
+#define NE7SSH_CHACHAPOLY_TAG_LEN 16
+
+/**
+ * The chacha20-poly1305@openssh.com packet cipher.
+ * <p>The 64 byte key is split in two ChaCha20 keys. The second half encrypts the packet length field,
+ * the first half encrypts the rest of the packet and yields the Poly1305 key, from block 0 of its
+ * keystream. The packet sequence number is the nonce. The tag covers the whole encrypted packet,
+ * including the length field.
+ */
+class ne7ssh_chachapoly
+{
+private:
+    ne7ssh_chacha20 _main;
+    ne7ssh_chacha20 _header;
+
+    /**
+     * Computes the Poly1305 tag of an encrypted packet. Leaves the main cipher at block 1.
+     * @param tag Buffer receiving the 16 byte tag.
+     * @param packet Pointer to the encrypted packet.
+     * @param len Length of the packet.
+     * @param nonce Pointer to the 8 byte nonce.
+     */
+    void authenticate(Botan::byte* tag, const Botan::byte* packet, uint32 len, const Botan::byte* nonce);
+
+public:
+    /**
+     * ne7ssh_chachapoly class constructor.
+     * @param key Pointer to the 64 byte key derived during the key exchange.
+     */
+    ne7ssh_chachapoly(const Botan::byte* key);
+
+    /**
+     * Decrypts the length field of a received packet, without touching the packet.
+     * @param packet Pointer to the first 4 bytes of the encrypted packet.
+     * @param seq Sequence number of the packet.
+     * @return Packet length, as found in the length field.
+     */
+    uint32 getLength(const Botan::byte* packet, uint32 seq);
+
+    /**
+     * Encrypts a packet in place and computes its tag.
+     * @param packet Pointer to the whole packet, starting with the length field.
+     * @param len Length of the packet.
+     * @param tag Buffer receiving the 16 byte tag.
+     * @param seq Sequence number of the packet.
+     */
+    void seal(Botan::byte* packet, uint32 len, Botan::byte* tag, uint32 seq);
+
+    /**
+     * Verifies the tag of a packet and decrypts it in place.
+     * @param packet Pointer to the whole packet, starting with the length field.
+     * @param len Length of the packet, excluding the tag.
+     * @param tag Pointer to the received 16 byte tag.
+     * @param seq Sequence number of the packet.
+     * @return True if the tag matched. False otherwise, in which case the packet is left encrypted.
+     */
+    bool open(Botan::byte* packet, uint32 len, const Botan::byte* tag, uint32 seq);
+};
+
+#endif
@@ -15,6 +15,7 @@
  ***************************************************************************/
 
 #include "ne7ssh_channel.h"
+#include "ne7ssh_writer.h"
 #include "ne7ssh_transport.h"
 #include "ne7ssh_session.h"
 #include "ne7ssh_impl.h"
@@ -80,7 +81,7 @@ bool ne7ssh_channel::handleChannelConfirm()
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
     SecureVector<Botan::byte> packet;
     transport->getPacket(packet);
-    ne7ssh_string channelConfirm(packet, 1);
+    ne7ssh_reader channelConfirm(packet, 1);
     uint32 field;
 
     // Receive Channel
@@ -99,22 +100,20 @@ bool ne7ssh_channel::handleChannelConfirm()
     return true;
 }
 
-bool ne7ssh_channel::adjustWindow(Botan::SecureVector<Botan::byte>& packet)
+bool ne7ssh_channel::adjustWindow(ne7ssh_reader& packet)
 {
-    ne7ssh_string adjustWindow(packet, 0);
-    ne7ssh_string newPacket;
     uint32 field;
 
     // channel number
-    adjustWindow.getInt();
+    packet.getInt();
 
     // add bytes to the window
-    field = adjustWindow.getInt();
+    field = packet.getInt();
     _windowSend += field;
     return true;
 }
 
-bool ne7ssh_channel::handleEof(Botan::SecureVector<Botan::byte>& packet)
+bool ne7ssh_channel::handleEof(ne7ssh_reader& packet)
 {
     UNREF_PARAM(packet);
     this->_cmdComplete = true;
@@ -130,9 +129,9 @@ bool ne7ssh_channel::handleEof(Botan::SecureVector<Botan::byte>& packet)
     return false;
 }
 
-void ne7ssh_channel::handleClose(Botan::SecureVector<Botan::byte>& newPacket)
+void ne7ssh_channel::handleClose(ne7ssh_reader& packet)
 {
-    UNREF_PARAM(newPacket);
+    UNREF_PARAM(packet);
     if (!_closed)
     {
         sendClose();
@@ -142,13 +141,13 @@ void ne7ssh_channel::handleClose(Botan::SecureVector<Botan::byte>& newPacket)
     _channelOpened = false;
 }
 
-bool ne7ssh_channel::handleDisconnect(Botan::SecureVector<Botan::byte>& packet)
+bool ne7ssh_channel::handleDisconnect(ne7ssh_reader& packet)
 {
-    ne7ssh_string message(packet, 0);
-//  uint32 reasonCode = message.getInt ();
     SecureVector<Botan::byte> description;
 
-    message.getString(description);
+    // reason code
+    packet.getInt();
+    packet.getString(description);
     _windowSend = _windowRecv = 0;
     _closed = true;
     _channelOpened = false;
@@ -160,7 +159,8 @@ bool ne7ssh_channel::handleDisconnect(Botan::SecureVector<Botan::byte>& packet)
 bool ne7ssh_channel::sendClose()
 {
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    ne7ssh_string packet;
+    Botan::byte buffer[1 + sizeof(uint32)];
+    ne7ssh_writer packet(buffer, sizeof(buffer));
 
     if (_closed)
     {
@@ -169,7 +169,7 @@ bool ne7ssh_channel::sendClose()
     packet.addChar(SSH2_MSG_CHANNEL_CLOSE);
     packet.addInt(_session->getSendChannel());
 
-    if (!transport->sendPacket(packet.value()))
+    if (!transport->sendPacket(packet.value(), packet.length()))
     {
         return false;
     }
@@ -182,7 +182,8 @@ bool ne7ssh_channel::sendClose()
 bool ne7ssh_channel::sendEof()
 {
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    ne7ssh_string packet;
+    Botan::byte buffer[1 + sizeof(uint32)];
+    ne7ssh_writer packet(buffer, sizeof(buffer));
 
     if (_closed)
     {
@@ -191,7 +192,7 @@ bool ne7ssh_channel::sendEof()
     packet.addChar(SSH2_MSG_CHANNEL_EOF);
     packet.addInt(_session->getSendChannel());
 
-    if (!transport->sendPacket(packet.value()))
+    if (!transport->sendPacket(packet.value(), packet.length()))
     {
         return false;
     }
@@ -204,7 +205,8 @@ bool ne7ssh_channel::sendEof()
 void ne7ssh_channel::sendAdjustWindow()
 {
     uint32 len = _session->getMaxPacket() - _windowRecv - 2400;
-    ne7ssh_string packet;
+    Botan::byte buffer[1 + 2 * sizeof(uint32)];
+    ne7ssh_writer packet(buffer, sizeof(buffer));
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
 
     packet.addChar(SSH2_MSG_CHANNEL_WINDOW_ADJUST);
@@ -212,21 +214,21 @@ void ne7ssh_channel::sendAdjustWindow()
     packet.addInt(len);
     _windowRecv = len;
 
-    transport->sendPacket(packet.value());
+    transport->sendPacket(packet.value(), packet.length());
 }
 
-bool ne7ssh_channel::handleData(Botan::SecureVector<Botan::byte>& packet)
+bool ne7ssh_channel::handleData(ne7ssh_reader& packet)
 {
-    ne7ssh_string handleData(packet, 0);
-    SecureVector<Botan::byte> data;
+    const Botan::byte* data;
+    uint32 len;
 
-    handleData.getInt();
+    packet.getInt();
 
-    if (!handleData.getString(data))
+    if (!packet.getString(data, len))
     {
         return false;
     }
-    if (!data.size())
+    if (!len)
     {
         ne7ssh::errors()->push(_session->getSshChannel(), "Abnormal. End of stream detected.");
     }
@@ -235,12 +237,12 @@ bool ne7ssh_channel::handleData(Botan::SecureVector<Botan::byte>& packet)
     {
         _chanInBuffer.chop(1);
     }
-    _chanInBuffer.addVector(data);
+    _chanInBuffer.addBytes(data, len);
     if (_chanInBuffer.length())
     {
         _chanInBuffer.addChar(0x00);
     }
-    _windowRecv -= data.size();
+    _windowRecv -= len;
     if (_windowRecv == 0)
     {
         sendAdjustWindow();
@@ -248,21 +250,20 @@ bool ne7ssh_channel::handleData(Botan::SecureVector<Botan::byte>& packet)
     return true;
 }
 
-bool ne7ssh_channel::handleExtendedData(Botan::SecureVector<Botan::byte>& packet)
+bool ne7ssh_channel::handleExtendedData(ne7ssh_reader& packet)
 {
-    ne7ssh_string handleData(packet, 0);
     uint32 dataType;
     SecureVector<Botan::byte> data;
 
-    handleData.getInt();
-    dataType = handleData.getInt();
+    packet.getInt();
+    dataType = packet.getInt();
     if (dataType != 1)
     {
         ne7ssh::errors()->push(_session->getSshChannel(), "Unable to handle received request.");
         return false;
     }
 
-    if (handleData.getString(data))
+    if (packet.getString(data))
     {
         ne7ssh::errors()->push(_session->getSshChannel(), "Remote side returned the following error: %B", &data);
     }
@@ -279,27 +280,30 @@ bool ne7ssh_channel::handleExtendedData(Botan::SecureVector<Botan::byte>& packet
     return true;
 }
 
-void ne7ssh_channel::handleRequest(Botan::SecureVector<Botan::byte>& packet)
+void ne7ssh_channel::handleRequest(ne7ssh_reader& packet)
 {
-    ne7ssh_string handleRequest(packet, 0);
-    SecureVector<Botan::byte> field;
+    const Botan::byte* field;
+    uint32 len;
     uint32 signal;
 
-    handleRequest.getInt();
-    handleRequest.getString(field);
-    if (!memcmp((char*)field.begin(), "exit-signal", 11))
+    packet.getInt();
+    if (!packet.getString(field, len) || len < 11)
+    {
+        return;
+    }
+    if (!memcmp((char*)field, "exit-signal", 11))
     {
         ne7ssh::errors()->push(_session->getSshChannel(), "exit-signal ignored.");
     }
-    else if (!memcmp((char*)field.begin(), "exit-status", 11))
+    else if (!memcmp((char*)field, "exit-status", 11))
     {
-        handleRequest.getByte();
-        signal = handleRequest.getInt();
+        packet.getByte();
+        signal = packet.getInt();
         ne7ssh::errors()->push(_session->getSshChannel(), "Remote side exited with status: %i.", signal);
     }
 
-//  handleRequest.getByte();
-//  handleRequest.getString (field);
+//  packet.getByte();
+//  packet.getString (field);
 }
 
 bool ne7ssh_channel::execCmd(const char* cmd)
@@ -365,7 +369,8 @@ void ne7ssh_channel::getShell()
 void ne7ssh_channel::receive()
 {
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    SecureVector<Botan::byte> packet;
+    ne7ssh_pooled_buffer packetBuffer(_session->_pool, MAX_PACKET_LEN);
+    SecureVector<Botan::byte>& packet = packetBuffer.value();
     bool notFirst = false;
     short status;
 
@@ -398,42 +403,41 @@ void ne7ssh_channel::receive()
 
 bool ne7ssh_channel::handleReceived(Botan::SecureVector<Botan::byte>& _packet)
 {
-    ne7ssh_string newPacket;
+    ne7ssh_reader newPacket(_packet, 0);
     Botan::byte cmd;
 
-    newPacket.addVector(_packet);
     cmd = newPacket.getByte();
     switch (cmd)
     {
         case SSH2_MSG_CHANNEL_WINDOW_ADJUST:
-            adjustWindow(newPacket.value());
+            adjustWindow(newPacket);
             break;
 
         case SSH2_MSG_CHANNEL_DATA:
-            return handleData(newPacket.value());
+            return handleData(newPacket);
             break;
 
         case SSH2_MSG_CHANNEL_EXTENDED_DATA:
-            handleExtendedData(newPacket.value());
+            handleExtendedData(newPacket);
             break;
 
         case SSH2_MSG_CHANNEL_EOF:
-            return handleEof(newPacket.value());
+            return handleEof(newPacket);
             break;
 
         case SSH2_MSG_CHANNEL_CLOSE:
-            handleClose(newPacket.value());
+            handleClose(newPacket);
             break;
 
         case SSH2_MSG_CHANNEL_REQUEST:
-            handleRequest(newPacket.value());
+            handleRequest(newPacket);
             break;
 
         case SSH2_MSG_IGNORE:
             break;
 
         case SSH2_MSG_DISCONNECT:
-            return handleDisconnect(newPacket.value());
+            return handleDisconnect(newPacket);
             break;
 
         default:
@@ -443,42 +447,38 @@ bool ne7ssh_channel::handleReceived(Botan::SecureVector<Botan::byte>& _packet)
     return true;
 }
 
-void ne7ssh_channel::write(Botan::SecureVector<Botan::byte>& data)
+void ne7ssh_channel::write(const Botan::byte* data, uint32 len)
 {
-    SecureVector<Botan::byte> dataBuff, outBuff, delayedBuff;
-    uint32 len, maxBytes, i, dataStart;
+    ne7ssh_payload dataBuff;
+    const Botan::byte* outBuff;
+    uint32 outLen, maxBytes, i, dataStart;
 
     if (_delayedBuffer.length())
     {
-        dataBuff = _delayedBuffer.value();
+        dataBuff.addBytes(_delayedBuffer.value().begin(), _delayedBuffer.length());
         _delayedBuffer.clear();
     }
-    dataBuff += data;
-
-    if (!_windowSend)
-    {
-        delayedBuff = dataBuff;
-    }
-    else if (_windowSend < dataBuff.size())
+    if (len)
     {
-        outBuff += SecureVector<Botan::byte>(dataBuff.begin(), _windowSend);
-        delayedBuff = SecureVector<Botan::byte>(dataBuff.begin() + _windowSend, dataBuff.size() - _windowSend);
+        dataBuff.addBytes(data, len);
     }
-    else
+
+    outBuff = dataBuff.value().begin();
+    outLen = dataBuff.length();
+    if (_windowSend < outLen)
     {
-        outBuff += dataBuff;
+        outLen = _windowSend;
     }
-
-    if (delayedBuff.size())
+    if (outLen < dataBuff.length())
     {
-        _delayedBuffer.addVector(delayedBuff);
+        _delayedBuffer.addBytes(outBuff + outLen, dataBuff.length() - outLen);
     }
-    if (!outBuff.size())
+    if (!outLen)
     {
         return;
     }
 
-    len = outBuff.size();
+    len = outLen;
     _windowSend -= len;
 
     maxBytes = _session->getMaxPacket();
@@ -489,8 +489,7 @@ void ne7ssh_channel::write(Botan::SecureVector<Botan::byte>& data)
         {
             dataStart -= 64;
         }
-        dataBuff = SecureVector<Botan::byte>(outBuff.begin() + dataStart, maxBytes - 64);
-        _chanOutBuffer.addVector(dataBuff);
+        _chanOutBuffer.addBytes(outBuff + dataStart, maxBytes - 64);
         len -= maxBytes - 64;
     }
     if (len)
@@ -500,8 +499,7 @@ void ne7ssh_channel::write(Botan::SecureVector<Botan::byte>& data)
         {
             dataStart -= 64;
         }
-        dataBuff = SecureVector<Botan::byte>(outBuff.begin() + dataStart, len);
-        _chanOutBuffer.addVector(dataBuff);
+        _chanOutBuffer.addBytes(outBuff + dataStart, len);
         //_inBuffer.clear();
     }
 }
@@ -509,27 +507,27 @@ void ne7ssh_channel::write(Botan::SecureVector<Botan::byte>& data)
 void ne7ssh_channel::sendAll()
 {
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    SecureVector<Botan::byte> tmpVar;
-    ne7ssh_string packet;
 
     if (!_chanOutBuffer.length() && _delayedBuffer.length())
     {
-        tmpVar.swap(_delayedBuffer.value());
-        _delayedBuffer.clear();
-        write(tmpVar);
+        // write() picks up the delayed data by itself
+        write(NULL, 0);
     }
     if (!_chanOutBuffer.length())
     {
         return;
     }
-    packet.clear();
-    packet.addChar(SSH2_MSG_CHANNEL_DATA);
-    packet.addInt(_session->getSendChannel());
-    packet.addVectorField(_chanOutBuffer.value());
+    // _outPacket is reused, so steady state sends do not allocate
+    _outPacket.clear();
+    _outPacket.reserve(1 + 2 * sizeof(uint32) + _chanOutBuffer.length());
+    _outPacket.addChar(SSH2_MSG_CHANNEL_DATA);
+    _outPacket.addInt(_session->getSendChannel());
+    _outPacket.addInt(_chanOutBuffer.length());
+    _outPacket.addBytes(_chanOutBuffer.value().begin(), _chanOutBuffer.length());
 
     _windowSend -= _chanOutBuffer.length();
     //_inBuffer.clear();
-    if (!transport->sendPacket(packet.value()))
+    if (!transport->sendPacket(_outPacket.value().begin(), _outPacket.length()))
     {
         return;
     }
@@ -18,6 +18,8 @@
 #define NE7SSH_CHANNEL_H
 
 #include "ne7ssh_string.h"
+#include "ne7ssh_reader.h"
+#include "ne7ssh_payload.h"
 #include <memory>
 class ne7ssh_session;
 
@@ -33,9 +35,10 @@ private:
     bool _shellSpawned;
 
     std::shared_ptr<ne7ssh_session> _session;
-    ne7ssh_string _chanInBuffer;
-    ne7ssh_string _chanOutBuffer;
-    ne7ssh_string _delayedBuffer;
+    ne7ssh_payload _chanInBuffer;
+    ne7ssh_payload _chanOutBuffer;
+    ne7ssh_payload _delayedBuffer;
+    ne7ssh_payload _outPacket;
 
     /**
      * This function is used to handle the 'CHANNEL_OPEN_CONFIRMATION' packet.
@@ -47,53 +50,53 @@ private:
     /**
      * This function is used to handle the 'WINDOWS_ADJUST' packet.
      * <p>It's used to increase our sending window size.
-     * @param packet Reference to vector containing WINDOW_ADJUST packet.
+     * @param packet Reference to a reader positioned after the WINDOW_ADJUST command byte.
      * @return If parsing of payload is successful, returns true, otherwise false is returned.
      */
-    bool adjustWindow(Botan::SecureVector<Botan::byte>& packet);
+    bool adjustWindow(ne7ssh_reader& packet);
 
     /**
      * This function is used to handle the 'DATA' packet.
      * <p>It's used to parse the payload, and add received data to the buffer.
-     * @param packet Reference to vector containing 'DATA' packet.
+     * @param packet Reference to a reader positioned after the 'DATA' command byte.
      * @return If parsing of payload is successful, returns true, otherwise false is returned.
      */
-    virtual bool handleData(Botan::SecureVector<Botan::byte>& packet);
+    virtual bool handleData(ne7ssh_reader& packet);
 
     /**
      * This function is used to handle 'EXTENDED_DATA' packet. This packet is mostly used to transmit remote side errors.
-     * @param packet Reference to vector containing 'EXTENDED_DATA' packet.
+     * @param packet Reference to a reader positioned after the 'EXTENDED_DATA' command byte.
      * @return If parsing of payload is successful, returns true, otherwise false is returned.
      */
-    bool handleExtendedData(Botan::SecureVector<Botan::byte>& packet);
+    bool handleExtendedData(ne7ssh_reader& packet);
 
     /**
      * This function is used to handle the 'EOF' packet.
      * <p>It's  used  to close the receiving window and channel.
-     * @param packet Reference to vector containing EOF packet.
+     * @param packet Reference to a reader positioned after the EOF command byte.
      */
-    bool handleEof(Botan::SecureVector<Botan::byte>& packet);
+    bool handleEof(ne7ssh_reader& packet);
 
     /**
      * This function is used to handle the 'CLOSE' packet.
      * <p> If the close action wasn't initiated on this end, we also send a 'CLOSE' packet to the remote side, prompting the closing of remote side's receiving channel.
-     * @param packet Reference to vector containing the 'CLOSE' packet.
+     * @param packet Reference to a reader positioned after the 'CLOSE' command byte.
      */
-    void handleClose(Botan::SecureVector<Botan::byte>& packet);
+    void handleClose(ne7ssh_reader& packet);
 
     /**
      * This function is used to handle the 'REQUEST' packet.
      * <p> At this point only two requests are supported, namely "exit-signal" and "exit-status". For the most part we ignore this packet, which is safe to do according to SSH specs.
-     * @param packet Reference to vector containing the 'REQUEST' packet.
+     * @param packet Reference to a reader positioned after the 'REQUEST' command byte.
      */
-    void handleRequest(Botan::SecureVector<Botan::byte>& packet);
+    void handleRequest(ne7ssh_reader& packet);
 
     /**
      * This function is used to handle the 'DISCONNECT' packet.
      * <p> In normal operation we should not get this packet. Only if some serious error occurs, and makes remote side drop the connection, will this packet be received. And at that point we disconnect right away, and throw an error.
-     * @param packet Reference to vector containing the 'DISCONNECT' packet.
+     * @param packet Reference to a reader positioned after the 'DISCONNECT' command byte.
      */
-    bool handleDisconnect(Botan::SecureVector<Botan::byte>& packet);
+    bool handleDisconnect(ne7ssh_reader& packet);
 
 protected:
     uint32 _windowRecv;
@@ -151,9 +154,10 @@ public:
 
     /**
      * Pushes a new command to the buffer where the selectThread will catch and send it.
-     * @param data Reference to vector containing a command to be added to the buffer.
+     * @param data Pointer to the data to be added to the buffer.
+     * @param len Length of the data.
      */
-    void write(Botan::SecureVector<Botan::byte>& data);
+    void write(const Botan::byte* data, uint32 len);
 
     /**
      * Sends the entire buffer. Most often called from selectThread via ne7ssh_connection class.
@@ -201,7 +205,7 @@ public:
      * Gets last received packet.
      * @return Reference to a vector containing the last received packet.
      */
-    Botan::SecureVector<Botan::byte>& getReceived()
+    ne7ssh_payload_vector& getReceived()
     {
         return _chanInBuffer.value();
     }
@@ -0,0 +1,141 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_cipher.h"
+#include <algorithm>
+#include <string.h>
+
+using namespace Botan;
+
+// Number of blocks handed to the cipher at once in CBC decryption and CTR, lets parallel implementations kick in
+#define NE7SSH_CIPHER_BATCH 16
+
+ne7ssh_cipher::ne7ssh_cipher(Botan::BlockCipher* cipher, const Botan::SymmetricKey& key, const Botan::InitializationVector& iv, Mode mode, Direction direction)
+    : _cipher(cipher),
+    _mode(mode),
+    _direction(direction),
+    _blockSize(cipher->block_size()),
+    _state(cipher->block_size())
+{
+    _cipher->set_key(key);
+    memcpy(_state.begin(), iv.begin(), std::min<size_t>(iv.length(), _blockSize));
+    if ((_mode == CTR) || (_direction == DECRYPT))
+    {
+        _scratch.resize(_blockSize * NE7SSH_CIPHER_BATCH);
+    }
+}
+
+bool ne7ssh_cipher::process(Botan::byte* buf, uint32 len)
+{
+    if (len % _blockSize)
+    {
+        return false;
+    }
+    if (_mode == CTR)
+    {
+        ctrCipher(buf, len / _blockSize);
+    }
+    else if (_direction == ENCRYPT)
+    {
+        cbcEncrypt(buf, len / _blockSize);
+    }
+    else
+    {
+        cbcDecrypt(buf, len / _blockSize);
+    }
+    return true;
+}
+
+void ne7ssh_cipher::cbcEncrypt(Botan::byte* buf, uint32 blocks)
+{
+    Botan::byte* prev = _state.begin();
+    uint32 i, n;
+
+    for (n = 0; n < blocks; n++)
+    {
+        for (i = 0; i < _blockSize; i++)
+        {
+            buf[i] ^= prev[i];
+        }
+        _cipher->encrypt(buf);
+        prev = buf;
+        buf += _blockSize;
+    }
+    if (blocks)
+    {
+        memcpy(_state.begin(), prev, _blockSize);
+    }
+}
+
+void ne7ssh_cipher::cbcDecrypt(Botan::byte* buf, uint32 blocks)
+{
+    Botan::byte* cipherText = _scratch.begin();
+    uint32 i, batch;
+
+    while (blocks)
+    {
+        batch = std::min<uint32>(blocks, NE7SSH_CIPHER_BATCH);
+        // Keep the ciphertext, it chains into the next block
+        memcpy(cipherText, buf, batch * _blockSize);
+        _cipher->decrypt_n(cipherText, buf, batch);
+
+        for (i = 0; i < _blockSize; i++)
+        {
+            buf[i] ^= _state[i];
+        }
+        for (i = _blockSize; i < batch * _blockSize; i++)
+        {
+            buf[i] ^= cipherText[i - _blockSize];
+        }
+        memcpy(_state.begin(), cipherText + (batch - 1) * _blockSize, _blockSize);
+
+        buf += batch * _blockSize;
+        blocks -= batch;
+    }
+}
+
+void ne7ssh_cipher::ctrCipher(Botan::byte* buf, uint32 blocks)
+{
+    Botan::byte* keyStream = _scratch.begin();
+    uint32 i, n, batch;
+    int j;
+
+    while (blocks)
+    {
+        batch = std::min<uint32>(blocks, NE7SSH_CIPHER_BATCH);
+        for (n = 0; n < batch; n++)
+        {
+            memcpy(keyStream + n * _blockSize, _state.begin(), _blockSize);
+            // Big endian increment of the counter
+            for (j = _blockSize - 1; j >= 0; j--)
+            {
+                if (++_state[j])
+                {
+                    break;
+                }
+            }
+        }
+        _cipher->encrypt_n(keyStream, keyStream, batch);
+
+        for (i = 0; i < batch * _blockSize; i++)
+        {
+            buf[i] ^= keyStream[i];
+        }
+
+        buf += batch * _blockSize;
+        blocks -= batch;
+    }
+}
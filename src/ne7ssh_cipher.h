@@ -0,0 +1,95 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_CIPHER_H
+#define NE7SSH_CIPHER_H
+
+#include "ne7ssh_types.h"
+#include <botan/block_cipher.h>
+#include <botan/symkey.h>
+#include <memory>
+
+/**
+ * Block cipher mode state for one direction of the transport.
+ * <p>Packets are transformed in place on the caller's buffer. Unlike a Botan::Pipe, nothing is
+ * queued between packets, so memory use stays constant for the life of the connection.
+ */
+class ne7ssh_cipher
+{
+public:
+    enum Mode { CBC, CTR };
+    enum Direction { ENCRYPT, DECRYPT };
+
+private:
+    std::unique_ptr<Botan::BlockCipher> _cipher;
+    Mode _mode;
+    Direction _direction;
+    uint32 _blockSize;
+    Botan::SecureVector<Botan::byte> _state;
+    Botan::SecureVector<Botan::byte> _scratch;
+
+    /**
+     * CBC encrypts whole blocks in place.
+     * @param buf Pointer to the data.
+     * @param blocks Number of blocks to process.
+     */
+    void cbcEncrypt(Botan::byte* buf, uint32 blocks);
+
+    /**
+     * CBC decrypts whole blocks in place.
+     * @param buf Pointer to the data.
+     * @param blocks Number of blocks to process.
+     */
+    void cbcDecrypt(Botan::byte* buf, uint32 blocks);
+
+    /**
+     * Applies CTR keystream to whole blocks in place. Same operation in both directions.
+     * <p> Counter blocks for a whole batch are laid out first and encrypted with one encrypt_n() call.
+     * @param buf Pointer to the data.
+     * @param blocks Number of blocks to process.
+     */
+    void ctrCipher(Botan::byte* buf, uint32 blocks);
+
+public:
+    /**
+     * ne7ssh_cipher class constructor.
+     * @param cipher Block cipher to use. The object takes ownership of it.
+     * @param key Cipher key.
+     * @param iv Initial chaining value (CBC) or counter (CTR), block size bytes long.
+     * @param mode Cipher mode.
+     * @param direction Whether the state is used to encrypt or to decrypt.
+     */
+    ne7ssh_cipher(Botan::BlockCipher* cipher, const Botan::SymmetricKey& key, const Botan::InitializationVector& iv, Mode mode, Direction direction);
+
+    /**
+     * Encrypts or decrypts a buffer in place, continuing the chain from the previous call.
+     * @param buf Pointer to the data.
+     * @param len Length of the data. Must be a multiple of the block size.
+     * @return True on success. False if len is not a multiple of the block size.
+     */
+    bool process(Botan::byte* buf, uint32 len);
+
+    /**
+     * Returns block size of the underlying cipher.
+     * @return Block size in bytes.
+     */
+    uint32 blockSize() const
+    {
+        return _blockSize;
+    }
+};
+
+#endif
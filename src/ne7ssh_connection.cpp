@@ -17,6 +17,7 @@
 #include "ne7ssh_connection.h"
 #include "ne7ssh_kex.h"
 #include "ne7ssh_keys.h"
+#include "ne7ssh_reader.h"
 #include "ne7ssh_impl.h"
 
 using namespace Botan;
@@ -42,6 +43,7 @@ ne7ssh_connection::~ne7ssh_connection()
 
 int ne7ssh_connection::connectWithPassword(uint32 channelID, const char* host, short port, const char* username, const char* password, bool shell, int timeout)
 {
+    _session->setRemoteHost(host, port);
     _sock = _transport->establish(host, port, timeout);
     if (_sock == -1)
     {
@@ -106,8 +108,9 @@ int ne7ssh_connection::connectWithPassword(uint32 channelID, const char* host, s
     return _thisChannel;
 }
 
-int ne7ssh_connection::connectWithKey(uint32 channelID, const char* host, short port, const char* username, const char* privKeyFileName, bool shell, int timeout)
+int ne7ssh_connection::connectWithKey(uint32 channelID, const char* host, short port, const char* username, std::shared_ptr<ne7ssh_keys> keyPair, bool shell, int timeout)
 {
+    _session->setRemoteHost(host, port);
     _sock = _transport->establish(host, port, timeout);
     if (_sock == -1)
     {
@@ -151,7 +154,7 @@ int ne7ssh_connection::connectWithKey(uint32 channelID, const char* host, short
     {
         return -1;
     }
-    if (!authWithKey(username, privKeyFileName))
+    if (!authWithKey(username, keyPair))
     {
         return -1;
     }
@@ -212,6 +215,7 @@ bool ne7ssh_connection::authWithPassword(const char* username, const char* passw
     cmd = _transport->waitForPacket(0);
     if (cmd == SSH2_MSG_USERAUTH_SUCCESS)
     {
+        _crypto->setAuthenticated();
         return true;
     }
     else if (cmd == SSH2_MSG_USERAUTH_BANNER)
@@ -223,6 +227,7 @@ bool ne7ssh_connection::authWithPassword(const char* username, const char* passw
         cmd = _transport->waitForPacket(0);
         if (cmd == SSH2_MSG_USERAUTH_SUCCESS)
         {
+            _crypto->setAuthenticated();
             return true;
         }
     }
@@ -230,7 +235,7 @@ bool ne7ssh_connection::authWithPassword(const char* username, const char* passw
     if (cmd == SSH2_MSG_USERAUTH_FAILURE)
     {
         _transport->getPacket(response);
-        ne7ssh_string message(response, 1);
+        ne7ssh_reader message(response, 1);
         message.getString(methods);
         message.getByte();
         ne7ssh::errors()->push(-1, "Authentication failed. Supported authentication methods: %B", &methods);
@@ -242,15 +247,10 @@ bool ne7ssh_connection::authWithPassword(const char* username, const char* passw
     }
 }
 
-bool ne7ssh_connection::authWithKey(const char* username, const char* privKeyFileName)
+bool ne7ssh_connection::authWithKey(const char* username, std::shared_ptr<ne7ssh_keys> keyPair)
 {
-    ne7ssh_keys keyPair;
     ne7ssh_string packet, packetBegin, packetEnd;
     SecureVector<Botan::byte> pubKeyBlob, sigBlob;
-    if (!keyPair.getKeyPairFromFile(privKeyFileName))
-    {
-        return false;
-    }
     short cmd;
     SecureVector<Botan::byte> response;
     SecureVector<Botan::byte> methods;
@@ -260,21 +260,13 @@ bool ne7ssh_connection::authWithKey(const char* username, const char* privKeyFil
     packetBegin.addString("ssh-connection");
     packetBegin.addString("publickey");
 
-    switch (keyPair.getKeyAlgo())
+    if (!keyPair->getKeyAlgoName())
     {
-        case ne7ssh_keys::DSA:
-            packetEnd.addString("ssh-dss");
-            break;
-
-        case ne7ssh_keys::RSA:
-            packetEnd.addString("ssh-rsa");
-            break;
-
-        default:
-            ne7ssh::errors()->push(_session->getSshChannel(), "The key algorithm: %i is not supported.", keyPair.getKeyAlgo());
-            return false;
+        ne7ssh::errors()->push(_session->getSshChannel(), "The key algorithm: %i is not supported.", keyPair->getKeyAlgo());
+        return false;
     }
-    pubKeyBlob = keyPair.getPublicKeyBlob();
+    packetEnd.addString(keyPair->getKeyAlgoName());
+    pubKeyBlob = keyPair->getPublicKeyBlob();
     if (!pubKeyBlob.size())
     {
         ne7ssh::errors()->push(_session->getSshChannel(), "Invallid public key.");
@@ -295,7 +287,7 @@ bool ne7ssh_connection::authWithKey(const char* username, const char* privKeyFil
     if (cmd == SSH2_MSG_USERAUTH_FAILURE)
     {
         _transport->getPacket(response);
-        ne7ssh_string message(response, 1);
+        ne7ssh_reader message(response, 1);
         message.getString(methods);
         message.getByte();
         ne7ssh::errors()->push(-1, "Authentication failed. Supported methods are: %B", &methods);
@@ -311,7 +303,7 @@ bool ne7ssh_connection::authWithKey(const char* username, const char* privKeyFil
     packet.addChar(0x1);
     packet.addVector(packetEnd.value());
 
-    sigBlob = keyPair.generateSignature(_session->getSessionID(), packet.value());
+    sigBlob = keyPair->generateSignature(_session->getSessionID(), packet.value());
     if (!sigBlob.size())
     {
         ne7ssh::errors()->push(_session->getSshChannel(), "Failure while generating the signature.");
@@ -327,12 +319,13 @@ bool ne7ssh_connection::authWithKey(const char* username, const char* privKeyFil
     cmd = _transport->waitForPacket(0);
     if (cmd == SSH2_MSG_USERAUTH_SUCCESS)
     {
+        _crypto->setAuthenticated();
         return true;
     }
     else if (cmd == SSH2_MSG_USERAUTH_FAILURE)
     {
         _transport->getPacket(response);
-        ne7ssh_string message(response, 1);
+        ne7ssh_reader message(response, 1);
         message.getString(methods);
         message.getByte();
         ne7ssh::errors()->push(-1, "Authentication failed. Supported methods are: %B", &methods);
@@ -395,8 +388,7 @@ void ne7ssh_connection::handleData()
 
 void ne7ssh_connection::sendData(const char* data)
 {
-    SecureVector<Botan::byte> cmd((const Botan::byte*) data, (uint32_t)strlen(data));
-    _channel->write(cmd);
+    _channel->write((const Botan::byte*) data, (uint32_t)strlen(data));
 }
 
 bool ne7ssh_connection::sendCmd(const char* cmd)
@@ -22,6 +22,8 @@
 #include "ne7ssh_channel.h"
 #include "ne7ssh_sftp.h"
 
+class ne7ssh_keys;
+
 /**
 @author Andrew Useckas
 */
@@ -73,10 +75,10 @@ private:
      * If succesfull proceeds wtih generating a signature and sending real authentication packet
      * of "publickey" type.
      * @param username Username used for authentication.
-     * @param privKeyFileName Full path to file containing private key to be used in authentication.
+     * @param keyPair Private key to be used in authentication.
      * @return True if authentication was successful, otherwise false is returned.
      */
-    bool authWithKey(const char* username, const char* privKeyFileName);
+    bool authWithKey(const char* username, std::shared_ptr<ne7ssh_keys> keyPair);
 
 public:
     /**
@@ -108,12 +110,12 @@ public:
      * @param host Hostname / IP of the remote host.
      * @param port Connection port.
      * @param username Username to use in the authentication.
-     * @param privKeyFileName Full path to file containing private key to be used in authentication.
+     * @param keyPair Private key to be used in authentication, from ne7ssh_key_cache.
      * @param shell Set this to true if you wish to launch the shell on the remote end. By default set to true.
      * @param timeout Timeout for the connection procedure, in seconds.
      * @return A newly assigned channel ID, or -1 if connection failed.
      */
-    int connectWithKey(uint32 channelID, const char* host, short port, const char* username, const char* privKeyFileName, bool shell = true, int timeout = 0);
+    int connectWithKey(uint32 channelID, const char* host, short port, const char* username, std::shared_ptr<ne7ssh_keys> keyPair, bool shell = true, int timeout = 0);
 
     /**
      * Retrieves the tcp socket number.
@@ -206,7 +208,7 @@ public:
      * Retrieves the last received packet.
      * @return A reference to a buffer containing the last received packet.
      */
-    Botan::SecureVector<Botan::byte>& getReceived()
+    ne7ssh_payload_vector& getReceived()
     {
         return _channel->getReceived();
     }
@@ -20,10 +20,13 @@
 
 #include "ne7ssh_crypt.h"
 #include "ne7ssh_session.h"
+#include "ne7ssh_reader.h"
 #include "ne7ssh_impl.h"
+#include "ne7ssh_kex_pool.h"
+#include "ne7ssh_aes.h"
+#include "ne7ssh_algorithms.h"
 #include "ne7ssh.h"
 
-#include <botan/cbc.h>
 #include <botan/look_pk.h>
 
 using namespace Botan;
@@ -38,6 +41,7 @@ ne7ssh_crypt::ne7ssh_crypt(std::shared_ptr<ne7ssh_session> session)
     _s2cMacMethod(HMAC_MD5),
     _c2sCmprsMethod(NONE),
     _s2cCmprsMethod(NONE),
+    _authenticated(false),
     _inited(false),
     _encryptBlock(0),
     _decryptBlock(0)
@@ -55,7 +59,10 @@ bool ne7ssh_crypt::agree(Botan::SecureVector<Botan::byte> &result, const char* l
     char* localAlgo, * remoteAlgo;
     bool match;
     size_t len = 0;
+    Botan::byte nullChar = 0;
 
+    // The remote list comes without a terminator, the names are compared by length below
+    remoteAlgos.addBytes(&nullChar, 1);
     localAlgos.split(',');
     localAlgos.resetParts();
     remoteAlgos.split(',');
@@ -73,7 +80,8 @@ bool ne7ssh_crypt::agree(Botan::SecureVector<Botan::byte> &result, const char* l
                 remoteAlgo = remoteAlgos.nextPart();
                 if (remoteAlgo != NULL)
                 {
-                    if (!memcmp(localAlgo, remoteAlgo, len))
+                    // Whole names only, hmac-sha2-256 must not match hmac-sha2-256-etm@openssh.com
+                    if ((strlen(remoteAlgo) == len) && !memcmp(localAlgo, remoteAlgo, len))
                     {
                         match = true;
                         break;
@@ -111,6 +119,26 @@ bool ne7ssh_crypt::negotiatedKex(Botan::SecureVector<Botan::byte> &kexAlgo)
         _kexMethod = DH_GROUP14_SHA1;
         return true;
     }
+    else if (!memcmp(kexAlgo.begin(), "curve25519-sha256", kexAlgo.size()) || !memcmp(kexAlgo.begin(), "curve25519-sha256@libssh.org", kexAlgo.size()))
+    {
+        _kexMethod = CURVE25519_SHA256;
+        return true;
+    }
+    else if (!memcmp(kexAlgo.begin(), "ecdh-sha2-nistp256", kexAlgo.size()))
+    {
+        _kexMethod = ECDH_SHA2_NISTP256;
+        return true;
+    }
+    else if (!memcmp(kexAlgo.begin(), "ecdh-sha2-nistp384", kexAlgo.size()))
+    {
+        _kexMethod = ECDH_SHA2_NISTP384;
+        return true;
+    }
+    else if (!memcmp(kexAlgo.begin(), "ecdh-sha2-nistp521", kexAlgo.size()))
+    {
+        _kexMethod = ECDH_SHA2_NISTP521;
+        return true;
+    }
 
     ne7ssh::errors()->push(_session->getSshChannel(), "KEX algorithm: '%B' not defined.", &kexAlgo);
     return false;
@@ -128,6 +156,26 @@ bool ne7ssh_crypt::negotiatedHostkey(Botan::SecureVector<Botan::byte> &hostkeyAl
         _hostkeyMethod = SSH_RSA;
         return true;
     }
+    else if (!memcmp(hostkeyAlgo.begin(), "ssh-ed25519", hostkeyAlgo.size()))
+    {
+        _hostkeyMethod = SSH_ED25519;
+        return true;
+    }
+    else if (!memcmp(hostkeyAlgo.begin(), "ecdsa-sha2-nistp256", hostkeyAlgo.size()))
+    {
+        _hostkeyMethod = ECDSA_SHA2_NISTP256;
+        return true;
+    }
+    else if (!memcmp(hostkeyAlgo.begin(), "ecdsa-sha2-nistp384", hostkeyAlgo.size()))
+    {
+        _hostkeyMethod = ECDSA_SHA2_NISTP384;
+        return true;
+    }
+    else if (!memcmp(hostkeyAlgo.begin(), "ecdsa-sha2-nistp521", hostkeyAlgo.size()))
+    {
+        _hostkeyMethod = ECDSA_SHA2_NISTP521;
+        return true;
+    }
 
     ne7ssh::errors()->push(_session->getSshChannel(), "Hostkey algorithm: '%B' not defined.", &hostkeyAlgo);
     return false;
@@ -140,6 +188,36 @@ bool ne7ssh_crypt::negotiatedCryptoC2s(Botan::SecureVector<Botan::byte> &cryptoA
         _c2sCryptoMethod = TDES_CBC;
         return true;
     }
+    else if (!memcmp(cryptoAlgo.begin(), "chacha20-poly1305@openssh.com", cryptoAlgo.size()))
+    {
+        _c2sCryptoMethod = CHACHA20_POLY1305;
+        return true;
+    }
+    else if (!memcmp(cryptoAlgo.begin(), "aes128-gcm@openssh.com", cryptoAlgo.size()))
+    {
+        _c2sCryptoMethod = AES128_GCM;
+        return true;
+    }
+    else if (!memcmp(cryptoAlgo.begin(), "aes256-gcm@openssh.com", cryptoAlgo.size()))
+    {
+        _c2sCryptoMethod = AES256_GCM;
+        return true;
+    }
+    else if (!memcmp(cryptoAlgo.begin(), "aes128-ctr", cryptoAlgo.size()))
+    {
+        _c2sCryptoMethod = AES128_CTR;
+        return true;
+    }
+    else if (!memcmp(cryptoAlgo.begin(), "aes192-ctr", cryptoAlgo.size()))
+    {
+        _c2sCryptoMethod = AES192_CTR;
+        return true;
+    }
+    else if (!memcmp(cryptoAlgo.begin(), "aes256-ctr", cryptoAlgo.size()))
+    {
+        _c2sCryptoMethod = AES256_CTR;
+        return true;
+    }
     else if (!memcmp(cryptoAlgo.begin(), "aes128-cbc", cryptoAlgo.size()))
     {
         _c2sCryptoMethod = AES128_CBC;
@@ -182,6 +260,36 @@ bool ne7ssh_crypt::negotiatedCryptoS2c(Botan::SecureVector<Botan::byte> &cryptoA
         _s2cCryptoMethod = TDES_CBC;
         return true;
     }
+    else if (!memcmp(cryptoAlgo.begin(), "chacha20-poly1305@openssh.com", cryptoAlgo.size()))
+    {
+        _s2cCryptoMethod = CHACHA20_POLY1305;
+        return true;
+    }
+    else if (!memcmp(cryptoAlgo.begin(), "aes128-gcm@openssh.com", cryptoAlgo.size()))
+    {
+        _s2cCryptoMethod = AES128_GCM;
+        return true;
+    }
+    else if (!memcmp(cryptoAlgo.begin(), "aes256-gcm@openssh.com", cryptoAlgo.size()))
+    {
+        _s2cCryptoMethod = AES256_GCM;
+        return true;
+    }
+    else if (!memcmp(cryptoAlgo.begin(), "aes128-ctr", cryptoAlgo.size()))
+    {
+        _s2cCryptoMethod = AES128_CTR;
+        return true;
+    }
+    else if (!memcmp(cryptoAlgo.begin(), "aes192-ctr", cryptoAlgo.size()))
+    {
+        _s2cCryptoMethod = AES192_CTR;
+        return true;
+    }
+    else if (!memcmp(cryptoAlgo.begin(), "aes256-ctr", cryptoAlgo.size()))
+    {
+        _s2cCryptoMethod = AES256_CTR;
+        return true;
+    }
     else if (!memcmp(cryptoAlgo.begin(), "aes128-cbc", cryptoAlgo.size()))
     {
         _s2cCryptoMethod = AES128_CBC;
@@ -219,11 +327,57 @@ bool ne7ssh_crypt::negotiatedCryptoS2c(Botan::SecureVector<Botan::byte> &cryptoA
 
 bool ne7ssh_crypt::negotiatedMacC2s(Botan::SecureVector<Botan::byte> &macAlgo)
 {
+    // Plain names are tested first, "hmac-sha2-256" is a prefix of its -etm variant
     if (!memcmp(macAlgo.begin(), "hmac-sha1", macAlgo.size()))
     {
         _c2sMacMethod = HMAC_SHA1;
         return true;
     }
+    else if (!memcmp(macAlgo.begin(), "hmac-sha2-256", macAlgo.size()))
+    {
+        _c2sMacMethod = HMAC_SHA256;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "hmac-sha2-512", macAlgo.size()))
+    {
+        _c2sMacMethod = HMAC_SHA512;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "hmac-sha1-etm@openssh.com", macAlgo.size()))
+    {
+        _c2sMacMethod = HMAC_SHA1_ETM;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "hmac-sha2-256-etm@openssh.com", macAlgo.size()))
+    {
+        _c2sMacMethod = HMAC_SHA256_ETM;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "hmac-sha2-512-etm@openssh.com", macAlgo.size()))
+    {
+        _c2sMacMethod = HMAC_SHA512_ETM;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "umac-64@openssh.com", macAlgo.size()))
+    {
+        _c2sMacMethod = UMAC64;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "umac-128@openssh.com", macAlgo.size()))
+    {
+        _c2sMacMethod = UMAC128;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "umac-64-etm@openssh.com", macAlgo.size()))
+    {
+        _c2sMacMethod = UMAC64_ETM;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "umac-128-etm@openssh.com", macAlgo.size()))
+    {
+        _c2sMacMethod = UMAC128_ETM;
+        return true;
+    }
     else if (!memcmp(macAlgo.begin(), "hmac-md5", macAlgo.size()))
     {
         _c2sMacMethod = HMAC_MD5;
@@ -241,11 +395,57 @@ bool ne7ssh_crypt::negotiatedMacC2s(Botan::SecureVector<Botan::byte> &macAlgo)
 
 bool ne7ssh_crypt::negotiatedMacS2c(Botan::SecureVector<Botan::byte> &macAlgo)
 {
+    // Plain names are tested first, "hmac-sha2-256" is a prefix of its -etm variant
     if (!memcmp(macAlgo.begin(), "hmac-sha1", macAlgo.size()))
     {
         _s2cMacMethod = HMAC_SHA1;
         return true;
     }
+    else if (!memcmp(macAlgo.begin(), "hmac-sha2-256", macAlgo.size()))
+    {
+        _s2cMacMethod = HMAC_SHA256;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "hmac-sha2-512", macAlgo.size()))
+    {
+        _s2cMacMethod = HMAC_SHA512;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "hmac-sha1-etm@openssh.com", macAlgo.size()))
+    {
+        _s2cMacMethod = HMAC_SHA1_ETM;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "hmac-sha2-256-etm@openssh.com", macAlgo.size()))
+    {
+        _s2cMacMethod = HMAC_SHA256_ETM;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "hmac-sha2-512-etm@openssh.com", macAlgo.size()))
+    {
+        _s2cMacMethod = HMAC_SHA512_ETM;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "umac-64@openssh.com", macAlgo.size()))
+    {
+        _s2cMacMethod = UMAC64;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "umac-128@openssh.com", macAlgo.size()))
+    {
+        _s2cMacMethod = UMAC128;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "umac-64-etm@openssh.com", macAlgo.size()))
+    {
+        _s2cMacMethod = UMAC64_ETM;
+        return true;
+    }
+    else if (!memcmp(macAlgo.begin(), "umac-128-etm@openssh.com", macAlgo.size()))
+    {
+        _s2cMacMethod = UMAC128_ETM;
+        return true;
+    }
     else if (!memcmp(macAlgo.begin(), "hmac-md5", macAlgo.size()))
     {
         _s2cMacMethod = HMAC_MD5;
@@ -263,6 +463,7 @@ bool ne7ssh_crypt::negotiatedMacS2c(Botan::SecureVector<Botan::byte> &macAlgo)
 
 bool ne7ssh_crypt::negotiatedCmprsC2s(Botan::SecureVector<Botan::byte> &cmprsAlgo)
 {
+    // "zlib" is tested first, it is a prefix of "zlib@openssh.com"
     if (!memcmp(cmprsAlgo.begin(), "none", cmprsAlgo.size()))
     {
         _c2sCmprsMethod = NONE;
@@ -273,6 +474,11 @@ bool ne7ssh_crypt::negotiatedCmprsC2s(Botan::SecureVector<Botan::byte> &cmprsAlg
         _c2sCmprsMethod = ZLIB;
         return true;
     }
+    else if (!memcmp(cmprsAlgo.begin(), "zlib@openssh.com", cmprsAlgo.size()))
+    {
+        _c2sCmprsMethod = ZLIB_OPENSSH;
+        return true;
+    }
 
     ne7ssh::errors()->push(_session->getSshChannel(), "Compression algorithm: '%B' not defined.", &cmprsAlgo);
     return false;
@@ -280,6 +486,7 @@ bool ne7ssh_crypt::negotiatedCmprsC2s(Botan::SecureVector<Botan::byte> &cmprsAlg
 
 bool ne7ssh_crypt::negotiatedCmprsS2c(Botan::SecureVector<Botan::byte> &cmprsAlgo)
 {
+    // "zlib" is tested first, it is a prefix of "zlib@openssh.com"
     if (!memcmp(cmprsAlgo.begin(), "none", cmprsAlgo.size()))
     {
         _s2cCmprsMethod = NONE;
@@ -290,20 +497,45 @@ bool ne7ssh_crypt::negotiatedCmprsS2c(Botan::SecureVector<Botan::byte> &cmprsAlg
         _s2cCmprsMethod = ZLIB;
         return true;
     }
+    else if (!memcmp(cmprsAlgo.begin(), "zlib@openssh.com", cmprsAlgo.size()))
+    {
+        _s2cCmprsMethod = ZLIB_OPENSSH;
+        return true;
+    }
 
     ne7ssh::errors()->push(_session->getSshChannel(), "Compression algorithm: '%B' not defined.", &cmprsAlgo);
     return false;
 }
 
-bool ne7ssh_crypt::getKexPublic(Botan::BigInt &publicKey)
+bool ne7ssh_crypt::getKexPublic(Botan::SecureVector<Botan::byte> &publicKey)
 {
+    BigInt dhPublic;
+
     switch (_kexMethod)
     {
         case DH_GROUP1_SHA1:
-            return getDHGroup1Sha1Public(publicKey);
+            if (!getDHGroup1Sha1Public(dhPublic))
+            {
+                return false;
+            }
+            ne7ssh_string::bn2vector(publicKey, dhPublic);
+            return true;
 
         case DH_GROUP14_SHA1:
-            return getDHGroup14Sha1Public(publicKey);
+            if (!getDHGroup14Sha1Public(dhPublic))
+            {
+                return false;
+            }
+            ne7ssh_string::bn2vector(publicKey, dhPublic);
+            return true;
+
+        case CURVE25519_SHA256:
+            return getCurve25519Public(publicKey);
+
+        case ECDH_SHA2_NISTP256:
+        case ECDH_SHA2_NISTP384:
+        case ECDH_SHA2_NISTP521:
+            return getEcdhPublic(publicKey);
 
         default:
             ne7ssh::errors()->push(_session->getSshChannel(), "Undefined DH Group: '%s'.", _kexMethod);
@@ -313,27 +545,21 @@ bool ne7ssh_crypt::getKexPublic(Botan::BigInt &publicKey)
 
 bool ne7ssh_crypt::computeH(Botan::SecureVector<Botan::byte> &result, Botan::SecureVector<Botan::byte> &val)
 {
-    HashFunction* hashIt;
+    const char* algo = getHashAlgo();
+    std::unique_ptr<HashFunction> hashIt;
 
-    switch (_kexMethod)
+    if (!algo)
     {
-        case DH_GROUP1_SHA1:
-        case DH_GROUP14_SHA1:
-            hashIt = global_state().algorithm_factory().make_hash_function("SHA-1");
-            break;
-
-        default:
-            ne7ssh::errors()->push(_session->getSshChannel(), "Undefined DH Group: '%s' while computing H.", _kexMethod);
-            return false;
+        return false;
     }
-
+    hashIt.reset(ne7ssh_impl::s_algorithms->makeHash(algo));
     if (!hashIt)
     {
+        ne7ssh::errors()->push(_session->getSshChannel(), "Undefined HASH algorithm encountered while computing H.");
         return false;
     }
     _H = hashIt->process(val);
     result = _H;
-    delete (hashIt);
     return true;
 }
 
@@ -341,9 +567,10 @@ bool ne7ssh_crypt::verifySig(Botan::SecureVector<Botan::byte> &hostKey, Botan::S
 {
     std::shared_ptr<DSA_PublicKey> dsaKey;
     std::shared_ptr<RSA_PublicKey> rsaKey;
+    std::shared_ptr<ECDSA_PublicKey> ecdsaKey;
     std::unique_ptr<PK_Verifier> verifier;
-    ne7ssh_string signature(sig, 0);
-    SecureVector<Botan::byte> sigType, sigData;
+    ne7ssh_reader signature(sig, 0);
+    SecureVector<Botan::byte> sigType, sigData, edKey;
     bool result = false;
 
     if (_H.empty())
@@ -383,15 +610,45 @@ bool ne7ssh_crypt::verifySig(Botan::SecureVector<Botan::byte> &hostKey, Botan::S
             }
             break;
 
+        case SSH_ED25519:
+            if (!getEd25519Key(hostKey, edKey))
+            {
+                ne7ssh::errors()->push(_session->getSshChannel(), "Ed25519 key not extracted.");
+                return false;
+            }
+            break;
+
+        case ECDSA_SHA2_NISTP256:
+        case ECDSA_SHA2_NISTP384:
+        case ECDSA_SHA2_NISTP521:
+            ecdsaKey = getECDSAKey(hostKey);
+            if (!ecdsaKey)
+            {
+                ne7ssh::errors()->push(_session->getSshChannel(), "ECDSA key not generated.");
+                return false;
+            }
+            if (!ecdsaSigToRaw(sigData, ecdsaKey->domain().get_order().bytes()))
+            {
+                ne7ssh::errors()->push(_session->getSshChannel(), "Malformed ECDSA signature.");
+                return false;
+            }
+            break;
+
         default:
             ne7ssh::errors()->push(_session->getSshChannel(), "Hostkey algorithm: %i not supported.", _hostkeyMethod);
             return false;
     }
 
+    // DSA and RSA sign the exchange hash with SHA-1 whichever hash produced it,
+    // ECDSA uses the hash that goes with its curve and Ed25519 hashes internally
     switch (_kexMethod)
     {
         case DH_GROUP1_SHA1:
         case DH_GROUP14_SHA1:
+        case CURVE25519_SHA256:
+        case ECDH_SHA2_NISTP256:
+        case ECDH_SHA2_NISTP384:
+        case ECDH_SHA2_NISTP521:
             if (dsaKey)
             {
                 verifier.reset(new PK_Verifier(*dsaKey, "EMSA1(SHA-1)"));
@@ -400,22 +657,45 @@ bool ne7ssh_crypt::verifySig(Botan::SecureVector<Botan::byte> &hostKey, Botan::S
             {
                 verifier.reset(new PK_Verifier(*rsaKey, "EMSA3(SHA-1)"));
             }
+            else if (ecdsaKey)
+            {
+                switch (_hostkeyMethod)
+                {
+                    case ECDSA_SHA2_NISTP256:
+                        verifier.reset(new PK_Verifier(*ecdsaKey, "EMSA1(SHA-256)"));
+                        break;
+
+                    case ECDSA_SHA2_NISTP384:
+                        verifier.reset(new PK_Verifier(*ecdsaKey, "EMSA1(SHA-384)"));
+                        break;
+
+                    default:
+                        verifier.reset(new PK_Verifier(*ecdsaKey, "EMSA1(SHA-512)"));
+                        break;
+                }
+            }
+            else if (!edKey.empty())
+            {
+                result = sigData.size() == NE7SSH_ED25519_SIG_LEN &&
+                         ne7ssh_ed25519::verify(sigData.begin(), _H.begin(), _H.size(), edKey.begin());
+            }
             break;
 
         default:
             break;
     }
-    if (verifier == NULL)
+    if (verifier == NULL && edKey.empty())
     {
         ne7ssh::errors()->push(_session->getSshChannel(), "Key Exchange algorithm: %i not supported.", _kexMethod);
     }
-    else
+    else if (verifier)
     {
         result = verifier->verify_message(_H, sigData);
         verifier.reset();
     }
     dsaKey.reset();
     rsaKey.reset();
+    ecdsaKey.reset();
 
     if (result == false)
     {
@@ -430,13 +710,11 @@ bool ne7ssh_crypt::verifySig(Botan::SecureVector<Botan::byte> &hostKey, Botan::S
 
 std::shared_ptr<DSA_PublicKey> ne7ssh_crypt::getDSAKey(Botan::SecureVector<Botan::byte> &hostKey)
 {
-    ne7ssh_string hKey;
+    ne7ssh_reader hKey(hostKey, 0);
     SecureVector<Botan::byte> field;
     BigInt p, q, g, y;
     std::shared_ptr<DSA_PublicKey> pubKey;
 
-    hKey.addVector(hostKey);
-
     if (!hKey.getString(field))
     {
         return 0;
@@ -470,13 +748,11 @@ std::shared_ptr<DSA_PublicKey> ne7ssh_crypt::getDSAKey(Botan::SecureVector<Botan
 
 std::shared_ptr<RSA_PublicKey> ne7ssh_crypt::getRSAKey(Botan::SecureVector<Botan::byte> &hostKey)
 {
-    ne7ssh_string hKey;
+    ne7ssh_reader hKey(hostKey, 0);
     SecureVector<Botan::byte> field;
     BigInt e, n;
     std::shared_ptr<RSA_PublicKey> pubKey;
 
-    hKey.addVector(hostKey);
-
     if (!hKey.getString(field))
     {
         return 0;
@@ -498,108 +774,395 @@ std::shared_ptr<RSA_PublicKey> ne7ssh_crypt::getRSAKey(Botan::SecureVector<Botan
     return pubKey;
 }
 
-bool ne7ssh_crypt::makeKexSecret(Botan::SecureVector<Botan::byte> &result, Botan::BigInt &f)
+bool ne7ssh_crypt::getEd25519Key(Botan::SecureVector<Botan::byte> &hostKey, Botan::SecureVector<Botan::byte> &publicKey)
 {
-    DH_KA_Operation dhop(*_privKexKey);
-    std::unique_ptr<byte> buf(new byte[f.bytes()]);
-    Botan::BigInt::encode(buf.get(), f);
-    SymmetricKey negotiated = dhop.agree(buf.get(), f.bytes());
+    ne7ssh_reader hKey(hostKey, 0);
+    SecureVector<Botan::byte> field;
 
-    if (!negotiated.length())
+    if (!hKey.getString(field))
+    {
+        return false;
+    }
+    if (!negotiatedHostkey(field))
     {
         return false;
     }
 
-    BigInt Kint(negotiated.begin(), negotiated.length());
-    ne7ssh_string::bn2vector(result, Kint);
-    _K = result;
-    _privKexKey.reset();
+    if (!hKey.getString(publicKey) || publicKey.size() != NE7SSH_ED25519_KEY_LEN)
+    {
+        return false;
+    }
     return true;
 }
 
-bool ne7ssh_crypt::getDHGroup1Sha1Public(Botan::BigInt &publicKey)
+std::shared_ptr<ECDSA_PublicKey> ne7ssh_crypt::getECDSAKey(Botan::SecureVector<Botan::byte> &hostKey)
 {
-    _privKexKey.reset(new DH_PrivateKey(*ne7ssh_impl::s_rng, DL_Group("modp/ietf/1024")));
-    DH_PublicKey pubKexKey = *_privKexKey;
+    ne7ssh_reader hKey(hostKey, 0);
+    SecureVector<Botan::byte> field;
+    const Botan::byte* point;
+    uint32 pointLen;
+    const char* curve;
+    const char* sshName;
+    std::shared_ptr<ECDSA_PublicKey> pubKey;
 
-    publicKey = pubKexKey.get_y();
-    if (publicKey.is_zero())
+    if (!hKey.getString(field))
     {
-        return false;
+        return pubKey;
     }
-    else
+    if (!negotiatedHostkey(field))
     {
-        return true;
+        return pubKey;
+    }
+    curve = getEcdsaCurve(&sshName);
+    if (!curve)
+    {
+        return pubKey;
     }
-}
-
-bool ne7ssh_crypt::getDHGroup14Sha1Public(Botan::BigInt &publicKey)
-{
-    _privKexKey.reset(new DH_PrivateKey(*ne7ssh_impl::s_rng, DL_Group("modp/ietf/2048")));
-    DH_PublicKey pubKexKey = *_privKexKey;
 
-    publicKey = pubKexKey.get_y();
-    if (publicKey.is_zero())
+    if (!hKey.getString(field) || field.size() != strlen(sshName) || memcmp(field.begin(), sshName, field.size()))
     {
-        return false;
+        ne7ssh::errors()->push(_session->getSshChannel(), "ECDSA host key is not on curve %s.", sshName);
+        return pubKey;
     }
-    else
+    if (!hKey.getString(point, pointLen))
     {
-        return true;
+        return pubKey;
     }
-}
 
-const char* ne7ssh_crypt::getHashAlgo()
-{
-    switch (_kexMethod)
+    try
     {
-        case DH_GROUP1_SHA1:
-        case DH_GROUP14_SHA1:
-            return "SHA-1";
-
-        default:
-            ne7ssh::errors()->push(_session->getSshChannel(), "DH Group: %i was not defined.", _kexMethod);
-            return 0;
+        EC_Group group(curve);
+        pubKey.reset(new ECDSA_PublicKey(group, OS2ECP(point, pointLen, group.get_curve())));
+    }
+    catch (const std::exception&)
+    {
+        pubKey.reset();
     }
+    return pubKey;
 }
 
-const char* ne7ssh_crypt::getCryptAlgo(uint32 crypto)
+bool ne7ssh_crypt::ecdsaSigToRaw(Botan::SecureVector<Botan::byte> &sigData, uint32 orderBytes)
 {
-    switch (crypto)
-    {
-        case TDES_CBC:
-            return "TripleDES";
+    ne7ssh_reader sigBlob(sigData, 0);
+    BigInt r, s;
 
-        case AES128_CBC:
-            return "AES-128";
+    if (!sigBlob.getBigInt(r) || !sigBlob.getBigInt(s))
+    {
+        return false;
+    }
+    if (r.bytes() > orderBytes || s.bytes() > orderBytes)
+    {
+        return false;
+    }
 
-        case AES192_CBC:
-            return "AES-192";
+    sigData = BigInt::encode_1363(r, orderBytes);
+    sigData += BigInt::encode_1363(s, orderBytes);
+    return true;
+}
 
-        case AES256_CBC:
-            return "AES-256";
+const char* ne7ssh_crypt::getEcdsaCurve(const char** sshName)
+{
+    const char* curve;
+    const char* name;
 
-        case BLOWFISH_CBC:
-            return "Blowfish";
+    switch (_hostkeyMethod)
+    {
+        case ECDSA_SHA2_NISTP256:
+            curve = "secp256r1";
+            name = "nistp256";
+            break;
 
-        case CAST128_CBC:
-            return "CAST-128";
+        case ECDSA_SHA2_NISTP384:
+            curve = "secp384r1";
+            name = "nistp384";
+            break;
 
-        case TWOFISH_CBC:
-            return "Twofish";
+        case ECDSA_SHA2_NISTP521:
+            curve = "secp521r1";
+            name = "nistp521";
+            break;
 
         default:
-            ne7ssh::errors()->push(_session->getSshChannel(), "Cryptographic algorithm: %i was not defined.", crypto);
             return 0;
     }
+    if (sshName)
+    {
+        *sshName = name;
+    }
+    return curve;
 }
 
-const char* ne7ssh_crypt::getHmacAlgo(uint32 method)
+bool ne7ssh_crypt::makeKexSecret(Botan::SecureVector<Botan::byte> &result, Botan::SecureVector<Botan::byte> &f)
 {
-    switch (method)
+    if (_kexMethod == CURVE25519_SHA256)
     {
-        case HMAC_SHA1:
-            return "SHA-1";
+        return makeCurve25519Secret(result, f);
+    }
+    if (getEcdhCurve())
+    {
+        return makeEcdhSecret(result, f);
+    }
+    if (!_privKexKey)
+    {
+        return false;
+    }
+
+    DH_KA_Operation dhop(*_privKexKey);
+    BigInt fInt(f.begin(), f.size());
+    std::unique_ptr<byte> buf(new byte[fInt.bytes()]);
+    Botan::BigInt::encode(buf.get(), fInt);
+    SymmetricKey negotiated = dhop.agree(buf.get(), fInt.bytes());
+
+    if (!negotiated.length())
+    {
+        return false;
+    }
+
+    BigInt Kint(negotiated.begin(), negotiated.length());
+    ne7ssh_string::bn2vector(result, Kint);
+    _K = result;
+    _privKexKey.reset();
+    return true;
+}
+
+bool ne7ssh_crypt::makeCurve25519Secret(Botan::SecureVector<Botan::byte> &result, Botan::SecureVector<Botan::byte> &f)
+{
+    SecureVector<Botan::byte> shared(NE7SSH_X25519_LEN);
+
+    if ((_privKexX25519.size() != NE7SSH_X25519_LEN) || (f.size() != NE7SSH_X25519_LEN))
+    {
+        ne7ssh::errors()->push(_session->getSshChannel(), "Invalid curve25519 public value.");
+        return false;
+    }
+    // An all zero result means the server sent a small order point
+    if (!ne7ssh_x25519::scalarMult(shared.begin(), _privKexX25519.begin(), f.begin()))
+    {
+        ne7ssh::errors()->push(_session->getSshChannel(), "Invalid curve25519 public value.");
+        return false;
+    }
+    _privKexX25519.clear();
+
+    // RFC 8731: the shared secret is read as a big endian number and encoded as an mpint
+    BigInt Kint(shared.begin(), shared.size());
+    ne7ssh_string::bn2vector(result, Kint);
+    _K = result;
+    return true;
+}
+
+bool ne7ssh_crypt::getCurve25519Public(Botan::SecureVector<Botan::byte> &publicKey)
+{
+    ne7ssh_impl::s_kexPool->takeX25519(_privKexX25519, publicKey);
+    return true;
+}
+
+bool ne7ssh_crypt::makeEcdhSecret(Botan::SecureVector<Botan::byte> &result, Botan::SecureVector<Botan::byte> &f)
+{
+    SecureVector<Botan::byte> shared;
+
+    if (!_privKexEcdh)
+    {
+        return false;
+    }
+    // Botan throws if the point is not on the curve
+    try
+    {
+        ECDH_KA_Operation ecdhop(*_privKexEcdh);
+        shared = ecdhop.agree(f.begin(), f.size());
+    }
+    catch (const std::exception &ex)
+    {
+        ne7ssh::errors()->push(_session->getSshChannel(), "Invalid ECDH public value: %s.", ex.what());
+        return false;
+    }
+    _privKexEcdh.reset();
+
+    BigInt Kint(shared.begin(), shared.size());
+    ne7ssh_string::bn2vector(result, Kint);
+    _K = result;
+    return true;
+}
+
+bool ne7ssh_crypt::getEcdhPublic(Botan::SecureVector<Botan::byte> &publicKey)
+{
+    switch (_kexMethod)
+    {
+        case ECDH_SHA2_NISTP256:
+            _privKexEcdh = ne7ssh_impl::s_kexPool->takeECDH(ne7ssh_kex_pool::ECDH_NISTP256);
+            break;
+
+        case ECDH_SHA2_NISTP384:
+            _privKexEcdh = ne7ssh_impl::s_kexPool->takeECDH(ne7ssh_kex_pool::ECDH_NISTP384);
+            break;
+
+        case ECDH_SHA2_NISTP521:
+            _privKexEcdh = ne7ssh_impl::s_kexPool->takeECDH(ne7ssh_kex_pool::ECDH_NISTP521);
+            break;
+
+        default:
+            return false;
+    }
+    if (!_privKexEcdh)
+    {
+        return false;
+    }
+    MemoryVector<Botan::byte> point = _privKexEcdh->public_value();
+    publicKey = SecureVector<Botan::byte>(point.begin(), point.size());
+    return true;
+}
+
+const char* ne7ssh_crypt::getEcdhCurve()
+{
+    switch (_kexMethod)
+    {
+        case ECDH_SHA2_NISTP256:
+            return "secp256r1";
+
+        case ECDH_SHA2_NISTP384:
+            return "secp384r1";
+
+        case ECDH_SHA2_NISTP521:
+            return "secp521r1";
+
+        default:
+            return 0;
+    }
+}
+
+bool ne7ssh_crypt::getDHGroup1Sha1Public(Botan::BigInt &publicKey)
+{
+    _privKexKey = ne7ssh_impl::s_kexPool->takeDH(ne7ssh_kex_pool::DH_GROUP1);
+    if (!_privKexKey)
+    {
+        return false;
+    }
+    DH_PublicKey pubKexKey = *_privKexKey;
+
+    publicKey = pubKexKey.get_y();
+    if (publicKey.is_zero())
+    {
+        return false;
+    }
+    else
+    {
+        return true;
+    }
+}
+
+bool ne7ssh_crypt::getDHGroup14Sha1Public(Botan::BigInt &publicKey)
+{
+    _privKexKey = ne7ssh_impl::s_kexPool->takeDH(ne7ssh_kex_pool::DH_GROUP14);
+    if (!_privKexKey)
+    {
+        return false;
+    }
+    DH_PublicKey pubKexKey = *_privKexKey;
+
+    publicKey = pubKexKey.get_y();
+    if (publicKey.is_zero())
+    {
+        return false;
+    }
+    else
+    {
+        return true;
+    }
+}
+
+const char* ne7ssh_crypt::getHashAlgo()
+{
+    switch (_kexMethod)
+    {
+        case DH_GROUP1_SHA1:
+        case DH_GROUP14_SHA1:
+            return "SHA-1";
+
+        case CURVE25519_SHA256:
+        case ECDH_SHA2_NISTP256:
+            return "SHA-256";
+
+        case ECDH_SHA2_NISTP384:
+            return "SHA-384";
+
+        case ECDH_SHA2_NISTP521:
+            return "SHA-512";
+
+        default:
+            ne7ssh::errors()->push(_session->getSshChannel(), "DH Group: %i was not defined.", _kexMethod);
+            return 0;
+    }
+}
+
+const char* ne7ssh_crypt::getCryptAlgo(uint32 crypto)
+{
+    switch (crypto)
+    {
+        case TDES_CBC:
+            return "TripleDES";
+
+        case AES128_CBC:
+        case AES128_CTR:
+        case AES128_GCM:
+            return "AES-128";
+
+        case AES192_CBC:
+        case AES192_CTR:
+            return "AES-192";
+
+        case AES256_CBC:
+        case AES256_CTR:
+        case AES256_GCM:
+            return "AES-256";
+
+        case BLOWFISH_CBC:
+            return "Blowfish";
+
+        case CAST128_CBC:
+            return "CAST-128";
+
+        case TWOFISH_CBC:
+            return "Twofish";
+
+        default:
+            ne7ssh::errors()->push(_session->getSshChannel(), "Cryptographic algorithm: %i was not defined.", crypto);
+            return 0;
+    }
+}
+
+ne7ssh_cipher::Mode ne7ssh_crypt::getCryptMode(uint32 crypto)
+{
+    switch (crypto)
+    {
+        case AES128_CTR:
+        case AES192_CTR:
+        case AES256_CTR:
+            return ne7ssh_cipher::CTR;
+
+        default:
+            return ne7ssh_cipher::CBC;
+    }
+}
+
+const char* ne7ssh_crypt::getHmacAlgo(uint32 method)
+{
+    switch (method)
+    {
+        case HMAC_SHA1:
+        case HMAC_SHA1_ETM:
+            return "SHA-1";
+
+        case HMAC_SHA256:
+        case HMAC_SHA256_ETM:
+            return "SHA-256";
+
+        case HMAC_SHA512:
+        case HMAC_SHA512_ETM:
+            return "SHA-512";
+
+        case UMAC64:
+        case UMAC128:
+        case UMAC64_ETM:
+        case UMAC128_ETM:
+            return "AES-128";
 
         case HMAC_MD5:
             return "MD5";
@@ -618,9 +1181,22 @@ uint32 ne7ssh_crypt::getMacKeyLen(uint32 method)
     switch (method)
     {
         case HMAC_SHA1:
+        case HMAC_SHA1_ETM:
             return 20;
 
+        case HMAC_SHA256:
+        case HMAC_SHA256_ETM:
+            return 32;
+
+        case HMAC_SHA512:
+        case HMAC_SHA512_ETM:
+            return 64;
+
         case HMAC_MD5:
+        case UMAC64:
+        case UMAC128:
+        case UMAC64_ETM:
+        case UMAC128_ETM:
             return 16;
 
         case HMAC_NONE:
@@ -637,11 +1213,26 @@ uint32 ne7ssh_crypt::getMacDigestLen(uint32 method)
     switch (method)
     {
         case HMAC_SHA1:
+        case HMAC_SHA1_ETM:
             return 20;
 
+        case HMAC_SHA256:
+        case HMAC_SHA256_ETM:
+            return 32;
+
+        case HMAC_SHA512:
+        case HMAC_SHA512_ETM:
+            return 64;
+
         case HMAC_MD5:
+        case UMAC128:
+        case UMAC128_ETM:
             return 16;
 
+        case UMAC64:
+        case UMAC64_ETM:
+            return 8;
+
         case HMAC_NONE:
             return 0;
 
@@ -652,266 +1243,496 @@ uint32 ne7ssh_crypt::getMacDigestLen(uint32 method)
 
 size_t ne7ssh_crypt::max_keylength_of(const std::string& name)
 {
-    Algorithm_Factory& af = global_state().algorithm_factory();
-
-    if (const BlockCipher* bc = af.prototype_block_cipher(name))
-    {
-        return bc->key_spec().maximum_keylength();
-    }
-
-    if (const StreamCipher* sc = af.prototype_stream_cipher(name))
-    {
-        return sc->key_spec().maximum_keylength();
-    }
+    const BlockCipher* bc = ne7ssh_impl::s_algorithms->blockCipher(name);
 
-    if (const MessageAuthenticationCode* mac = af.prototype_mac(name))
+    if (!bc)
     {
-        return mac->key_spec().maximum_keylength();
+        return 0;
     }
-
-    return 0;
+    return bc->key_spec().maximum_keylength();
 }
 
-bool ne7ssh_crypt::makeNewKeys()
+bool ne7ssh_crypt::makeNewKeys(bool loopback)
 {
     const char* algo;
     uint32 key_len, iv_len, macLen;
     SecureVector<Botan::byte> key;
     const Botan::BlockCipher* cipher;
     const Botan::HashFunction* hash_algo;
+    const char* hashAlgo = getHashAlgo();
+    std::unique_ptr<HashFunction> hashIt;
+    ne7ssh_string prefix;
 
-    algo = getCryptAlgo(_c2sCryptoMethod);
-    key_len = max_keylength_of(algo);
-    if (key_len == 0)
+    if (!hashAlgo)
     {
         return false;
     }
-    if (_c2sCryptoMethod == BLOWFISH_CBC)
-    {
-        key_len = 16;
-    }
-    else if (_c2sCryptoMethod == TWOFISH_CBC)
-    {
-        key_len = 32;
-    }
-    _encryptBlock = iv_len = block_size_of(algo);
-    macLen = getMacKeyLen(_c2sMacMethod);
-    if (!algo)
+    hashIt.reset(ne7ssh_impl::s_algorithms->makeHash(hashAlgo));
+    if (!hashIt)
     {
+        ne7ssh::errors()->push(_session->getSshChannel(), "Undefined HASH algorithm encountered while computing the key.");
         return false;
     }
+    // All six keys are hashed from the same K || H, encoded once and fed to one hash object
+    prefix.addVectorField(_K);
+    prefix.addVector(_H);
 
-    if (!compute_key(key, 'A', iv_len))
+    if (_c2sCryptoMethod == CHACHA20_POLY1305)
     {
-        return false;
+        // Only a 64 byte key, no IV and no separate MAC
+        if (!compute_key(key, hashIt.get(), prefix.value(), 'C', NE7SSH_CHACHAPOLY_KEY_LEN))
+        {
+            return false;
+        }
+        _chachaEncrypt.reset(new ne7ssh_chachapoly(key.begin()));
+        _encryptBlock = 8;
+        _encrypt.reset();
+        _gcmEncrypt.reset();
+        _hmacOut.reset();
+        _umacOut.reset();
     }
-    InitializationVector c2s_iv(key);
-
-    if (!compute_key(key, 'C', key_len))
+    else
     {
-        return false;
+        algo = getCryptAlgo(_c2sCryptoMethod);
+        key_len = max_keylength_of(algo);
+        if (key_len == 0)
+        {
+            return false;
+        }
+        if (_c2sCryptoMethod == BLOWFISH_CBC)
+        {
+            key_len = 16;
+        }
+        else if (_c2sCryptoMethod == TWOFISH_CBC)
+        {
+            key_len = 32;
+        }
+        _encryptBlock = iv_len = ne7ssh_impl::s_algorithms->blockCipher(algo)->block_size();
+        macLen = getMacKeyLen(_c2sMacMethod);
+        if (isAead(_c2sCryptoMethod))
+        {
+            iv_len = NE7SSH_GCM_IV_LEN;
+            macLen = 0;
+        }
+        if (!algo)
+        {
+            return false;
+        }
+
+        if (!compute_key(key, hashIt.get(), prefix.value(), 'A', iv_len))
+        {
+            return false;
+        }
+        InitializationVector c2s_iv(key);
+
+        if (!compute_key(key, hashIt.get(), prefix.value(), 'C', key_len))
+        {
+            return false;
+        }
+        SymmetricKey c2s_key(key);
+
+        if (!compute_key(key, hashIt.get(), prefix.value(), 'E', macLen))
+        {
+            return false;
+        }
+        SymmetricKey c2s_mac(key);
+
+        cipher = ne7ssh_impl::s_algorithms->blockCipher(algo);
+        if (isAead(_c2sCryptoMethod))
+        {
+            _gcmEncrypt.reset(new ne7ssh_gcm(ne7ssh_aes::create(algo, cipher), c2s_key, c2s_iv));
+            _encrypt.reset();
+        }
+        else
+        {
+            _encrypt.reset(new ne7ssh_cipher(ne7ssh_aes::create(algo, cipher), c2s_key, c2s_iv, getCryptMode(_c2sCryptoMethod), ne7ssh_cipher::ENCRYPT));
+            _gcmEncrypt.reset();
+        }
+
+        _hmacOut.reset();
+        _umacOut.reset();
+        if (macLen && isUmac(_c2sMacMethod))
+        {
+            cipher = ne7ssh_impl::s_algorithms->blockCipher(getHmacAlgo(_c2sMacMethod));
+            _umacOut.reset(new ne7ssh_umac(ne7ssh_aes::create(getHmacAlgo(_c2sMacMethod), cipher), c2s_mac.begin(), getMacDigestLen(_c2sMacMethod)));
+        }
+        else if (macLen)
+        {
+            hash_algo = ne7ssh_impl::s_algorithms->hashFunction(getHmacAlgo(_c2sMacMethod));
+            _hmacOut.reset(new HMAC(hash_algo->clone()));
+            _hmacOut->set_key(c2s_mac);
+        }
+        _chachaEncrypt.reset();
     }
-    SymmetricKey c2s_key(key);
 
-    if (!compute_key(key, 'E', macLen))
+    if (_s2cCryptoMethod == CHACHA20_POLY1305)
     {
-        return false;
+        if (!compute_key(key, hashIt.get(), prefix.value(), loopback ? 'C' : 'D', NE7SSH_CHACHAPOLY_KEY_LEN))
+        {
+            return false;
+        }
+        _chachaDecrypt.reset(new ne7ssh_chachapoly(key.begin()));
+        _decryptBlock = 8;
+        _decrypt.reset();
+        _gcmDecrypt.reset();
+        _hmacIn.reset();
+        _umacIn.reset();
     }
-    SymmetricKey c2s_mac(key);
+    else
+    {
+        algo = getCryptAlgo(_s2cCryptoMethod);
+        key_len = max_keylength_of(algo);
+        if (key_len == 0)
+        {
+            return false;
+        }
+        if (_s2cCryptoMethod == BLOWFISH_CBC)
+        {
+            key_len = 16;
+        }
+        else if (_s2cCryptoMethod == TWOFISH_CBC)
+        {
+            key_len = 32;
+        }
+        _decryptBlock = iv_len = ne7ssh_impl::s_algorithms->blockCipher(algo)->block_size();
+        macLen = getMacKeyLen(_s2cMacMethod);
+        if (isAead(_s2cCryptoMethod))
+        {
+            iv_len = NE7SSH_GCM_IV_LEN;
+            macLen = 0;
+        }
+        if (!algo)
+        {
+            return false;
+        }
 
-    Algorithm_Factory &af = global_state().algorithm_factory();
-    cipher = af.prototype_block_cipher(algo);
-    _encrypt.reset(new Pipe(new CBC_Encryption(cipher->clone(), new Null_Padding, c2s_key, c2s_iv)));
+        if (!compute_key(key, hashIt.get(), prefix.value(), loopback ? 'A' : 'B', iv_len))
+        {
+            return false;
+        }
+        InitializationVector s2c_iv(key);
 
-    if (macLen)
-    {
-        hash_algo = af.prototype_hash_function(getHmacAlgo(_c2sMacMethod));
-        _hmacOut.reset(new HMAC(hash_algo->clone()));
-        _hmacOut->set_key(c2s_mac);
+        if (!compute_key(key, hashIt.get(), prefix.value(), loopback ? 'C' : 'D', key_len))
+        {
+            return false;
+        }
+        SymmetricKey s2c_key(key);
+
+        if (!compute_key(key, hashIt.get(), prefix.value(), loopback ? 'E' : 'F', macLen))
+        {
+            return false;
+        }
+        SymmetricKey s2c_mac(key);
+
+        cipher = ne7ssh_impl::s_algorithms->blockCipher(algo);
+        if (isAead(_s2cCryptoMethod))
+        {
+            _gcmDecrypt.reset(new ne7ssh_gcm(ne7ssh_aes::create(algo, cipher), s2c_key, s2c_iv));
+            _decrypt.reset();
+        }
+        else
+        {
+            _decrypt.reset(new ne7ssh_cipher(ne7ssh_aes::create(algo, cipher), s2c_key, s2c_iv, getCryptMode(_s2cCryptoMethod), ne7ssh_cipher::DECRYPT));
+            _gcmDecrypt.reset();
+        }
+
+        _hmacIn.reset();
+        _umacIn.reset();
+        if (macLen && isUmac(_s2cMacMethod))
+        {
+            cipher = ne7ssh_impl::s_algorithms->blockCipher(getHmacAlgo(_s2cMacMethod));
+            _umacIn.reset(new ne7ssh_umac(ne7ssh_aes::create(getHmacAlgo(_s2cMacMethod), cipher), s2c_mac.begin(), getMacDigestLen(_s2cMacMethod)));
+        }
+        else if (macLen)
+        {
+            hash_algo = ne7ssh_impl::s_algorithms->hashFunction(getHmacAlgo(_s2cMacMethod));
+            _hmacIn.reset(new HMAC(hash_algo->clone()));
+            _hmacIn->set_key(s2c_mac);
+        }
+        _chachaDecrypt.reset();
     }
-//  if (c2sCmprsMethod == ZLIB) compress = new Pipe (new Zlib_Compression(9));
+    // Every key exchange starts the compression contexts over, RFC 4253 section 6.2
+    _compress.reset();
+    _decompress.reset();
+    startCompression();
+
+    _inited = true;
+    return true;
+}
+
+void ne7ssh_crypt::switchKeysOut(ne7ssh_crypt& next)
+{
+    _c2sCryptoMethod = next._c2sCryptoMethod;
+    _c2sMacMethod = next._c2sMacMethod;
+    _c2sCmprsMethod = next._c2sCmprsMethod;
+    _encryptBlock = next._encryptBlock;
+    _encrypt.swap(next._encrypt);
+    _gcmEncrypt.swap(next._gcmEncrypt);
+    _chachaEncrypt.swap(next._chachaEncrypt);
+    _hmacOut.swap(next._hmacOut);
+    _umacOut.swap(next._umacOut);
+    _compress.reset();
+    startCompression();
+}
+
+void ne7ssh_crypt::switchKeysIn(ne7ssh_crypt& next)
+{
+    _s2cCryptoMethod = next._s2cCryptoMethod;
+    _s2cMacMethod = next._s2cMacMethod;
+    _s2cCmprsMethod = next._s2cCmprsMethod;
+    _decryptBlock = next._decryptBlock;
+    _decrypt.swap(next._decrypt);
+    _gcmDecrypt.swap(next._gcmDecrypt);
+    _chachaDecrypt.swap(next._chachaDecrypt);
+    _hmacIn.swap(next._hmacIn);
+    _umacIn.swap(next._umacIn);
+    _decompress.reset();
+    startCompression();
+}
 
-    algo = getCryptAlgo(_s2cCryptoMethod);
-    key_len = max_keylength_of(algo);
-    if (key_len == 0)
+void ne7ssh_crypt::startCompression()
+{
+    // Streams that already run are kept, the key switches drop them first so they restart after each key exchange
+    if (_c2sCmprsMethod == NONE)
     {
-        return false;
+        _compress.reset();
     }
-    if (_s2cCryptoMethod == BLOWFISH_CBC)
+    else if (!_compress && ((_c2sCmprsMethod == ZLIB) || _authenticated))
     {
-        key_len = 16;
+        _compress.reset(new ne7ssh_zlib(ne7ssh_zlib::COMPRESS, ne7ssh_impl::COMPRESSION_LEVEL));
     }
-    else if (_s2cCryptoMethod == TWOFISH_CBC)
+    if (_s2cCmprsMethod == NONE)
     {
-        key_len = 32;
+        _decompress.reset();
     }
-    _decryptBlock = iv_len = block_size_of(algo);
-    macLen = getMacKeyLen(_c2sMacMethod);
-    if (!algo)
+    else if (!_decompress && ((_s2cCmprsMethod == ZLIB) || _authenticated))
     {
-        return false;
+        _decompress.reset(new ne7ssh_zlib(ne7ssh_zlib::DECOMPRESS, ne7ssh_impl::COMPRESSION_LEVEL));
     }
+}
+
+bool ne7ssh_crypt::compute_key(Botan::SecureVector<Botan::byte>& key, Botan::HashFunction* hashIt, const Botan::SecureVector<Botan::byte>& prefix, Botan::byte ID, uint32 nBytes)
+{
+    SecureVector<Botan::byte> newKey;
 
-    if (!compute_key(key, 'B', iv_len))
+    // AEAD ciphers take no MAC key, there is nothing to hash
+    if (!nBytes)
     {
-        return false;
+        key = Botan::SecureVector<Botan::byte>();
+        return true;
     }
-    InitializationVector s2c_iv(key);
 
-    if (!compute_key(key, 'D', key_len))
+    hashIt->update(prefix);
+    hashIt->update(ID);
+    hashIt->update(_session->getSessionID());
+    newKey = hashIt->final();
+
+    while (newKey.size() < nBytes)
     {
-        return false;
+        hashIt->update(prefix);
+        hashIt->update(newKey);
+        newKey += hashIt->final();
     }
-    SymmetricKey s2c_key(key);
+    key = Botan::SecureVector<Botan::byte>(newKey.begin(), nBytes);
+    return true;
+}
+
+bool ne7ssh_crypt::encryptPacket(Botan::SecureVector<Botan::byte> &packet, uint32 seq)
+{
+    uint32 len = packet.size();
+    uint32 macLen = getMacOutLen();
 
-    if (!compute_key(key, 'F', macLen))
+    // The MAC or tag goes right behind the packet, resize() keeps the contents
+    packet.resize(len + macLen);
+    if (_chachaEncrypt)
     {
-        return false;
+        _chachaEncrypt->seal(packet.begin(), len, packet.begin() + len, seq);
+        return true;
+    }
+    if (_gcmEncrypt)
+    {
+        if (!_gcmEncrypt->seal(packet.begin(), len, packet.begin() + len))
+        {
+            ne7ssh::errors()->push(_session->getSshChannel(), "Packet length is not a multiple of the cipher block size.");
+            return false;
+        }
+        return true;
+    }
+    if (isEtm(_c2sMacMethod))
+    {
+        // Length field stays in the clear, the HMAC covers the ciphertext
+        if (!_encrypt->process(packet.begin() + sizeof(uint32), len - sizeof(uint32)))
+        {
+            ne7ssh::errors()->push(_session->getSshChannel(), "Packet length is not a multiple of the cipher block size.");
+            return false;
+        }
+        macOut(packet.begin() + len, packet.begin(), len, seq);
+        return true;
     }
-    SymmetricKey s2c_mac(key);
-
-    cipher = af.prototype_block_cipher(algo);
-    _decrypt.reset(new Pipe(new CBC_Decryption(cipher->clone(), new Null_Padding, s2c_key, s2c_iv)));
 
+    // The HMAC covers the plain text, so it is computed before the packet is encrypted in place
     if (macLen)
     {
-        hash_algo = af.prototype_hash_function(getHmacAlgo(_s2cMacMethod));
-        _hmacIn.reset(new HMAC(hash_algo->clone()));
-        _hmacIn->set_key(s2c_mac);
+        macOut(packet.begin() + len, packet.begin(), len, seq);
+    }
+    if (!_encrypt->process(packet.begin(), len))
+    {
+        ne7ssh::errors()->push(_session->getSshChannel(), "Packet length is not a multiple of the cipher block size.");
+        return false;
     }
-//  if (s2cCmprsMethod == ZLIB) decompress = new Pipe (new Zlib_Decompression);
 
-    _inited = true;
     return true;
 }
 
-bool ne7ssh_crypt::compute_key(Botan::SecureVector<Botan::byte>& key, Botan::byte ID, uint32 nBytes)
+bool ne7ssh_crypt::decryptPacket(Botan::SecureVector<Botan::byte> &decrypted, Botan::SecureVector<Botan::byte> &packet, uint32 len)
 {
-    SecureVector<Botan::byte> hash, newKey;
-    ne7ssh_string hashBytes;
-    HashFunction* hashIt;
-    const char* algo = getHashAlgo();
-    uint32 len;
+    uint32 pLen = packet.size();
 
-    if (!algo)
+    if (len % _decryptBlock)
     {
-        return false;
+        len = len + (len % _decryptBlock);
     }
 
-    hashIt = global_state().algorithm_factory().make_hash_function(algo);
-
-    if (!hashIt)
+    if (len > pLen)
     {
-        ne7ssh::errors()->push(_session->getSshChannel(), "Undefined HASH algorithm encountered while computing the key.");
-        return false;
+        len = pLen;
     }
 
-    hashBytes.addVectorField(_K);
-    hashBytes.addVector(_H);
-    hashBytes.addChar(ID);
-    hashBytes.addVector(_session->getSessionID());
-
-    hash = hashIt->process(hashBytes.value());
-    newKey = hash;
-    len = newKey.size();
+    return decryptPacket(decrypted, packet.begin(), len);
+}
 
-    while (len < nBytes)
+bool ne7ssh_crypt::decryptPacket(Botan::SecureVector<Botan::byte> &decrypted, const Botan::byte* packet, uint32 len)
+{
+    decrypted.resize(len);
+    memcpy(decrypted.begin(), packet, len);
+    if (!_decrypt->process(decrypted.begin(), len))
     {
-        hashBytes.clear();
-        hashBytes.addVectorField(_K);
-        hashBytes.addVector(_H);
-        hashBytes.addVector(newKey);
-        hash = hashIt->process(hashBytes.value());
-        newKey += hash;
-        len = newKey.size();
+        ne7ssh::errors()->push(_session->getSshChannel(), "Received data is not a multiple of the cipher block size.");
+        return false;
     }
-    key = Botan::SecureVector<Botan::byte>(newKey.begin(), nBytes);
-    delete (hashIt);
     return true;
 }
 
-bool ne7ssh_crypt::encryptPacket(Botan::SecureVector<Botan::byte> &crypted, Botan::SecureVector<Botan::byte> &hmac, Botan::SecureVector<Botan::byte> &packet, uint32 seq)
+bool ne7ssh_crypt::decryptAadPacket(Botan::SecureVector<Botan::byte> &decrypted, const Botan::byte* packet, uint32 len, uint32 seq)
 {
-    SecureVector<Botan::byte> macStr;
-    uint32 nSeq = (uint32)htonl(seq);
-
-    _encrypt->start_msg();
-    _encrypt->write(packet.begin(), packet.size());
-    _encrypt->end_msg();
-//  encrypt->process_msg (packet);
-    crypted = _encrypt->read_all(_encrypt->message_count() - 1);
+    bool ok;
 
-    if (_hmacOut)
+    if (!_chachaDecrypt && !_gcmDecrypt)
     {
-        macStr = SecureVector<Botan::byte>((Botan::byte*)&nSeq, 4);
-        macStr += packet;
-        hmac = _hmacOut->process(macStr);
+        // Encrypt-then-MAC, the ciphertext is checked before any of it is decrypted
+        if ((len < sizeof(uint32)) || !verifyMac(packet, len, packet + len, seq))
+        {
+            return false;
+        }
     }
 
+    decrypted.resize(len);
+    memcpy(decrypted.begin(), packet, len);
+    if (_chachaDecrypt)
+    {
+        ok = _chachaDecrypt->open(decrypted.begin(), len, packet + len, seq);
+    }
+    else if (_gcmDecrypt)
+    {
+        ok = _gcmDecrypt->open(decrypted.begin(), len, packet + len);
+    }
+    else
+    {
+        ok = _decrypt->process(decrypted.begin() + sizeof(uint32), len - sizeof(uint32));
+    }
+    if (!ok)
+    {
+        decrypted.clear();
+        return false;
+    }
     return true;
 }
 
-bool ne7ssh_crypt::decryptPacket(Botan::SecureVector<Botan::byte> &decrypted, Botan::SecureVector<Botan::byte> &packet, uint32 len)
+uint32 ne7ssh_crypt::getAadPacketLength(const Botan::byte* packet, uint32 seq)
 {
-    uint32 pLen = packet.size();
+    uint32 len;
 
-    if (len % _decryptBlock)
+    if (_chachaDecrypt)
     {
-        len = len + (len % _decryptBlock);
+        return _chachaDecrypt->getLength(packet, seq);
     }
+    memcpy(&len, packet, sizeof(uint32));
+    return ntohl(len);
+}
 
-    if (len > pLen)
+bool ne7ssh_crypt::compressData(Botan::SecureVector<Botan::byte>& out, const Botan::byte* payload, uint32 len)
+{
+    if (!_compress || !_compress->process(out, payload, len, MAX_PACKET_LEN))
     {
-        len = pLen;
+        ne7ssh::errors()->push(_session->getSshChannel(), "Failure to compress the payload.");
+        return false;
     }
-
-    _decrypt->process_msg(packet.begin(), len);
-    decrypted = _decrypt->read_all(_decrypt->message_count() - 1);
     return true;
 }
 
-void ne7ssh_crypt::compressData(Botan::SecureVector<Botan::byte> &buffer)
+bool ne7ssh_crypt::decompressData(Botan::SecureVector<Botan::byte>& out, const Botan::byte* payload, uint32 len)
 {
-    SecureVector<Botan::byte> tmpVar;
-    if (!_compress)
+    if (!_decompress || !_decompress->process(out, payload, len, MAX_PACKET_LEN))
     {
-        return;
+        ne7ssh::errors()->push(_session->getSshChannel(), "Failure to decompress the payload.");
+        return false;
     }
+    return true;
+}
 
-    tmpVar.swap(buffer);
-    _compress->process_msg(tmpVar);
-    tmpVar = _compress->read_all(_compress->message_count() - 1);
-    buffer = tmpVar;
+void ne7ssh_crypt::setAuthenticated()
+{
+    _authenticated = true;
+    startCompression();
 }
 
-void ne7ssh_crypt::decompressData(Botan::SecureVector<Botan::byte> &buffer)
+bool ne7ssh_crypt::verifyMac(const Botan::byte* packet, uint32 len, const Botan::byte* mac, uint32 seq)
 {
-    SecureVector<Botan::byte> tmpVar;
-    if (!_decompress)
+    // Large enough for the longest digest, SHA-512
+    Botan::byte ourMac[64];
+    uint32 i, macLen = getMacInLen();
+    Botan::byte diff = 0;
+
+    if (!_hmacIn && !_umacIn)
     {
-        return;
+        return false;
     }
-
-    tmpVar.swap(buffer);
-    _decompress->process_msg(tmpVar);
-    tmpVar = _decompress->read_all(_decompress->message_count() - 1);
-    buffer = tmpVar;
+    macIn(ourMac, packet, len, seq);
+    for (i = 0; i < macLen; i++)
+    {
+        diff |= ourMac[i] ^ mac[i];
+    }
+    memset(ourMac, 0, sizeof(ourMac));
+    return !diff;
 }
 
-void ne7ssh_crypt::computeMac(Botan::SecureVector<Botan::byte> &hmac, Botan::SecureVector<Botan::byte> &packet, uint32 seq)
+void ne7ssh_crypt::macOut(Botan::byte* mac, const Botan::byte* packet, uint32 len, uint32 seq)
 {
-    SecureVector<Botan::byte> macStr;
     uint32 nSeq = htonl(seq);
 
-    if (_hmacIn)
+    if (_umacOut)
     {
-        macStr = SecureVector<Botan::byte>((Botan::byte*)&nSeq, 4);
-        macStr += packet;
-        hmac = _hmacIn->process(macStr);
+        _umacOut->update(packet, len);
+        _umacOut->final(mac, seq);
+        return;
     }
-    else
+    _hmacOut->update((Botan::byte*)&nSeq, 4);
+    _hmacOut->update(packet, len);
+    _hmacOut->final(mac);
+}
+
+void ne7ssh_crypt::macIn(Botan::byte* mac, const Botan::byte* packet, uint32 len, uint32 seq)
+{
+    uint32 nSeq = htonl(seq);
+
+    if (_umacIn)
     {
-        hmac.clear();
+        _umacIn->update(packet, len);
+        _umacIn->final(mac, seq);
+        return;
     }
+    _hmacIn->update((Botan::byte*)&nSeq, 4);
+    _hmacIn->update(packet, len);
+    _hmacIn->final(mac);
 }
 
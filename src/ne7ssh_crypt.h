@@ -18,16 +18,20 @@
 #define CRYPT_H
 
 #include "ne7ssh_string.h"
+#include "ne7ssh_cipher.h"
+#include "ne7ssh_gcm.h"
+#include "ne7ssh_chachapoly.h"
+#include "ne7ssh_umac.h"
+#include "ne7ssh_x25519.h"
+#include "ne7ssh_ed25519.h"
 
 #include <botan/dh.h>
+#include <botan/ecdh.h>
+#include <botan/ecdsa.h>
 #include <botan/dsa.h>
 #include <botan/rsa.h>
 
-// #if defined(BOTAN_EXT_COMPRESSOR_ZLIB)
-//   #include <botan/zlib.h>
-// #else
-//   #error "Zlib support is not compiled into Botan"
-// #endif
+#include "ne7ssh_zlib.h"
 
 #include <botan/hmac.h>
 #include <memory>
@@ -42,54 +46,106 @@ class ne7ssh_crypt
 private:
     std::shared_ptr<ne7ssh_session> _session;
 
-    enum kexMethods { DH_GROUP1_SHA1, DH_GROUP14_SHA1 };
+    enum kexMethods { DH_GROUP1_SHA1, DH_GROUP14_SHA1, CURVE25519_SHA256, ECDH_SHA2_NISTP256, ECDH_SHA2_NISTP384, ECDH_SHA2_NISTP521 };
     uint32 _kexMethod;
 
-    enum hostkeyMethods { SSH_DSS, SSH_RSA };
+    enum hostkeyMethods { SSH_DSS, SSH_RSA, SSH_ED25519, ECDSA_SHA2_NISTP256, ECDSA_SHA2_NISTP384, ECDSA_SHA2_NISTP521 };
     uint32 _hostkeyMethod;
 
-    enum cryptoMethods { TDES_CBC, AES128_CBC, AES192_CBC, AES256_CBC, BLOWFISH_CBC, CAST128_CBC, TWOFISH_CBC };
+    enum cryptoMethods { TDES_CBC, AES128_CBC, AES192_CBC, AES256_CBC, BLOWFISH_CBC, CAST128_CBC, TWOFISH_CBC, AES128_CTR, AES192_CTR, AES256_CTR, AES128_GCM, AES256_GCM, CHACHA20_POLY1305 };
     uint32 _c2sCryptoMethod;
     uint32 _s2cCryptoMethod;
 
-    enum macMethods { HMAC_SHA1, HMAC_MD5, HMAC_NONE };
+    enum macMethods { HMAC_SHA1, HMAC_MD5, HMAC_NONE, HMAC_SHA256, HMAC_SHA512, HMAC_SHA1_ETM, HMAC_SHA256_ETM, HMAC_SHA512_ETM, UMAC64, UMAC128, UMAC64_ETM, UMAC128_ETM };
     uint32 _c2sMacMethod;
     uint32 _s2cMacMethod;
 
-    enum cmprsMethods { NONE, ZLIB };
+    enum cmprsMethods { NONE, ZLIB, ZLIB_OPENSSH };
     uint32 _c2sCmprsMethod;
     uint32 _s2cCmprsMethod;
+    bool _authenticated;
 
     bool _inited;
     Botan::SecureVector<Botan::byte> _H;
     Botan::SecureVector<Botan::byte> _K;
 
-    std::unique_ptr<Botan::Pipe> _encrypt;
-    std::unique_ptr<Botan::Pipe> _decrypt;
-    std::unique_ptr<Botan::Pipe> _compress;
-    std::unique_ptr<Botan::Pipe> _decompress;
+    std::unique_ptr<ne7ssh_cipher> _encrypt;
+    std::unique_ptr<ne7ssh_cipher> _decrypt;
+    std::unique_ptr<ne7ssh_gcm> _gcmEncrypt;
+    std::unique_ptr<ne7ssh_gcm> _gcmDecrypt;
+    std::unique_ptr<ne7ssh_chachapoly> _chachaEncrypt;
+    std::unique_ptr<ne7ssh_chachapoly> _chachaDecrypt;
+    std::unique_ptr<ne7ssh_zlib> _compress;
+    std::unique_ptr<ne7ssh_zlib> _decompress;
     std::unique_ptr<Botan::HMAC> _hmacOut;
     std::unique_ptr<Botan::HMAC> _hmacIn;
+    std::unique_ptr<ne7ssh_umac> _umacOut;
+    std::unique_ptr<ne7ssh_umac> _umacIn;
 
     std::unique_ptr<Botan::DH_PrivateKey> _privKexKey;
+    Botan::SecureVector<Botan::byte> _privKexX25519;
+    std::unique_ptr<Botan::ECDH_PrivateKey> _privKexEcdh;
 
     uint32 _encryptBlock;
     uint32 _decryptBlock;
 
     /**
-     * Generates a new Public Key, based on Diffie Helman Group1, SHA1 standard.
+     * Takes a fresh key pair from the ne7ssh_kex_pool and returns its Public Key, based on Diffie Helman Group1, SHA1 standard.
      * @param publicKey Reference to publick Key. The result will be dumped into this var.
      * @return If generation successful returns true, otherwise false is returned.
      */
     bool getDHGroup1Sha1Public(Botan::BigInt& publicKey);
 
     /**
-     * Generates a new Public Key, based on Diffie Helman Group14, SHA1 standard.
+     * Creates the zlib streams the negotiated compression methods call for, or drops them if compression is off.
+     * <p>Existing streams are kept. makeNewKeys(), switchKeysOut() and switchKeysIn() drop theirs first, since
+     * RFC 4253 re-initializes the compression context after each key exchange.
+     */
+    void startCompression();
+
+    /**
+     * Takes a fresh key pair from the ne7ssh_kex_pool and returns its Public Key, based on Diffie Helman Group14, SHA1 standard.
      * @param publicKey Reference to publick Key. The result will be dumped into this var.
      * @return If generation successful returns true, otherwise false is returned.
      */
     bool getDHGroup14Sha1Public(Botan::BigInt &publicKey);
 
+    /**
+     * Takes a fresh X25519 key pair for curve25519-sha256 from the ne7ssh_kex_pool.
+     * @param publicKey The 32 byte public value will be dumped into this var.
+     * @return If generation successful returns true, otherwise false is returned.
+     */
+    bool getCurve25519Public(Botan::SecureVector<Botan::byte>& publicKey);
+
+    /**
+     * Computes the curve25519-sha256 shared secret.
+     * @param result Shared secret, encoded as an mpint, will be dumped into this var.
+     * @param f Reference to the 32 byte public value received from the server.
+     * @return True if the public value was valid, otherwise false is returned.
+     */
+    bool makeCurve25519Secret(Botan::SecureVector<Botan::byte>& result, Botan::SecureVector<Botan::byte>& f);
+
+    /**
+     * Takes a fresh ECDH key pair from the ne7ssh_kex_pool, on the NIST curve of the negotiated ecdh-sha2-nistp* exchange.
+     * @param publicKey The public point, in uncompressed form, will be dumped into this var.
+     * @return If generation successful returns true, otherwise false is returned.
+     */
+    bool getEcdhPublic(Botan::SecureVector<Botan::byte>& publicKey);
+
+    /**
+     * Computes the ecdh-sha2-nistp* shared secret.
+     * @param result Shared secret, the x coordinate encoded as an mpint, will be dumped into this var.
+     * @param f Reference to the public point received from the server.
+     * @return True if the point was valid, otherwise false is returned.
+     */
+    bool makeEcdhSecret(Botan::SecureVector<Botan::byte>& result, Botan::SecureVector<Botan::byte>& f);
+
+    /**
+     * Returns Botan's name of the curve used by the negotiated ecdh-sha2-nistp* exchange.
+     * @return A string containing the curve name, or 0 for other exchanges.
+     */
+    const char* getEcdhCurve();
+
     /**
      * Generates a new DSA public Key from p,q,g,y values extracted from the host key received from the server.
      * @param hostKey Reference to vector containing host key received from a server.
@@ -104,6 +160,36 @@ private:
     */
     std::shared_ptr<Botan::RSA_PublicKey> getRSAKey(Botan::SecureVector<Botan::byte> &hostKey);
 
+    /**
+     * Extracts the public key from an ssh-ed25519 host key received from the server.
+     * @param hostKey Reference to a vector containing host key.
+     * @param publicKey The NE7SSH_ED25519_KEY_LEN byte public key will be dumped into this var.
+     * @return True if the host key is well formed, otherwise false is returned.
+     */
+    bool getEd25519Key(Botan::SecureVector<Botan::byte>& hostKey, Botan::SecureVector<Botan::byte>& publicKey);
+
+    /**
+     * Generates a new ECDSA public Key from the curve point in an ecdsa-sha2-nistp* host key received from the server.
+     * @param hostKey Reference to a vector containing host key.
+     * @return Returns newly generated ECDSA public Key, or an empty pointer if the host key is malformed or the point is not on the curve.
+     */
+    std::shared_ptr<Botan::ECDSA_PublicKey> getECDSAKey(Botan::SecureVector<Botan::byte>& hostKey);
+
+    /**
+     * Converts an ecdsa-sha2-nistp* signature blob, two mpints r and s, into the fixed length r || s form Botan verifies.
+     * @param sigData Reference to the signature blob, replaced by the converted signature.
+     * @param orderBytes Length of the curve order in bytes.
+     * @return True if the blob is well formed, otherwise false is returned.
+     */
+    bool ecdsaSigToRaw(Botan::SecureVector<Botan::byte>& sigData, uint32 orderBytes);
+
+    /**
+     * Returns Botan's name of the curve used by the negotiated ecdsa-sha2-nistp* host key.
+     * @param sshName If not 0, receives the curve identifier the host key blob carries, nistp256 for example.
+     * @return A string containing the curve name, or 0 for other host key algorithms.
+     */
+    const char* getEcdsaCurve(const char** sshName = 0);
+
     /**
      * Returns a string represenation of negotiated one way hash algorithm. For DH1_GROUP1_SHA1, "SHA-1" will be returned.
      * @return A string containing algorithm name.
@@ -117,8 +203,65 @@ private:
      */
     const char* getCryptAlgo(uint32 crypto);
 
+    /**
+     * Returns the block cipher mode used by a negotiated cipher algorithm.
+     * @param crypto Integer represenating a cipher algorithm.
+     * @return Cipher mode.
+     */
+    ne7ssh_cipher::Mode getCryptMode(uint32 crypto);
+
+    /**
+     * Checks if a cipher algorithm is an AEAD cipher, authenticating packets without a separate MAC.
+     * @param crypto Integer represenating a cipher algorithm.
+     * @return True for AEAD ciphers, otherwise false is returned.
+     */
+    bool isAead(uint32 crypto)
+    {
+        return (crypto == AES128_GCM) || (crypto == AES256_GCM) || (crypto == CHACHA20_POLY1305);
+    }
+
+    /**
+     * Checks if a MAC algorithm is an encrypt-then-MAC variant, computed over the encrypted packet.
+     * @param method Integer represenating HMAC algorithm.
+     * @return True for -etm@openssh.com algorithms, otherwise false is returned.
+     */
+    bool isEtm(uint32 method)
+    {
+        return (method == HMAC_SHA1_ETM) || (method == HMAC_SHA256_ETM) || (method == HMAC_SHA512_ETM) || (method == UMAC64_ETM) || (method == UMAC128_ETM);
+    }
+
+    /**
+     * Checks if a MAC algorithm is UMAC rather than HMAC.
+     * @param method Integer represenating MAC algorithm.
+     * @return True for umac-64 and umac-128 algorithms, otherwise false is returned.
+     */
+    bool isUmac(uint32 method)
+    {
+        return (method == UMAC64) || (method == UMAC128) || (method == UMAC64_ETM) || (method == UMAC128_ETM);
+    }
+
+    /**
+     * Computes the MAC of a transmitted packet, with HMAC or UMAC.
+     * <p>HMAC covers the sequence number followed by the packet, UMAC uses the sequence number as its nonce.
+     * @param mac Buffer receiving getMacOutLen() bytes.
+     * @param packet Pointer to the packet.
+     * @param len Length of the packet.
+     * @param seq Transmited packet sequence.
+     */
+    void macOut(Botan::byte* mac, const Botan::byte* packet, uint32 len, uint32 seq);
+
+    /**
+     * Same as above, but for a received packet.
+     * @param mac Buffer receiving getMacInLen() bytes.
+     * @param packet Pointer to the packet.
+     * @param len Length of the packet.
+     * @param seq Receive sequence.
+     */
+    void macIn(Botan::byte* mac, const Botan::byte* packet, uint32 len, uint32 seq);
+
     /**
      * Returns a string represenation of negotiated HMAC algorithm.
+     * <p>For UMAC this is the block cipher it is built on.
      * @param method Integer represenating HMAC algorithm.
      * @return A string containing algorithm name.
      */
@@ -143,12 +286,15 @@ private:
     /**
      * Function used to compute crypto and HMAC keys.
      * <p> Keys are computed using K, H, ID and sessionID values. All these are concated and hashed. If hash is not long enough K, H, and newly generated key is used over and over again, till keys are long enough.
+     * <p> makeNewKeys() encodes K and H once and passes the same prefix and hash object for all six keys.
      * @param key Resulting key will be dumped into this var.
+     * @param hashIt Hash object of the key exchange hash, left ready for the next key.
+     * @param prefix Encoded K followed by H.
      * @param ID Single character ID, as specified in SSH protocol specs.
      * @param nBytes Key length in bytes.
      * @return True if key generation was successful, otherwise false is returned.
      */
-    bool compute_key(Botan::SecureVector<Botan::byte>& key, Botan::byte ID, uint32 nBytes);
+    bool compute_key(Botan::SecureVector<Botan::byte>& key, Botan::HashFunction* hashIt, const Botan::SecureVector<Botan::byte>& prefix, Botan::byte ID, uint32 nBytes);
 
     size_t max_keylength_of(const std::string& name);
 
@@ -199,7 +345,7 @@ public:
      */
     uint32 getMacOutLen()
     {
-        return getMacDigestLen(_c2sMacMethod);
+        return isAeadOut() ? NE7SSH_GCM_TAG_LEN : getMacDigestLen(_c2sMacMethod);
     }
 
     /**
@@ -208,7 +354,48 @@ public:
      */
     uint32 getMacInLen()
     {
-        return getMacDigestLen(_s2cMacMethod);
+        return isAeadIn() ? NE7SSH_GCM_TAG_LEN : getMacDigestLen(_s2cMacMethod);
+    }
+
+    /**
+     * Checks if the negotiated client to server cipher is an AEAD cipher.
+     * <p> AEAD packets leave the length field unencrypted and carry a tag in place of the MAC.
+     * @return True if AEAD cipher is used, otherwise false is returned.
+     */
+    bool isAeadOut()
+    {
+        return isAead(_c2sCryptoMethod);
+    }
+
+    /**
+     * Checks if the negotiated server to client cipher is an AEAD cipher.
+     * @return True if AEAD cipher is used, otherwise false is returned.
+     */
+    bool isAeadIn()
+    {
+        return isAead(_s2cCryptoMethod);
+    }
+
+    /**
+     * Checks if the client to server packet length field is kept out of the block cipher.
+     * <p> True for AEAD ciphers and encrypt-then-MAC. The field is then not counted in the padding,
+     * and is authenticated together with the rest of the packet.
+     * @return True if the length field is handled separately, otherwise false is returned.
+     */
+    bool isAadOut()
+    {
+        return isAeadOut() || isEtm(_c2sMacMethod);
+    }
+
+    /**
+     * Checks if the server to client packet length field is kept out of the block cipher.
+     * <p> The packet length is then known before anything is decrypted, and a packet is authenticated
+     * as a whole before it is decrypted.
+     * @return True if the length field is handled separately, otherwise false is returned.
+     */
+    bool isAadIn()
+    {
+        return isAeadIn() || isEtm(_s2cMacMethod);
     }
 
     /**
@@ -278,18 +465,18 @@ public:
 
     /**
      * Generates KEX public key.
-     * @param publicKey Public key will be dumped into this var.
+     * @param publicKey Public key will be dumped into this var, encoded as it is sent to the server: the bytes of an mpint for Diffie Hellman, the raw point for curve25519.
      * @return True if key generation was successful, otherwise false is returned.
      */
-    bool getKexPublic(Botan::BigInt& publicKey);
+    bool getKexPublic(Botan::SecureVector<Botan::byte>& publicKey);
 
     /**
      * At the end of key exchange this function is used to generate a shared secret key from private KEX key, that one gets from getKexPublic() function and F value received from a server.
      * @param result Secret key will be dumped into this var.
-     * @param f Reference to F value.
+     * @param f Reference to F value, encoded the same way as the public key.
      * @return True if key generation was successful, otherwise false is returned.
      */
-    bool makeKexSecret(Botan::SecureVector<Botan::byte>& result, Botan::BigInt& f);
+    bool makeKexSecret(Botan::SecureVector<Botan::byte>& result, Botan::SecureVector<Botan::byte>& f);
 
     /**
      * Computes H value by checking what hash algorithm is used and hashing "val".
@@ -309,20 +496,34 @@ public:
 
     /**
      * Generates new cipher and HMAC keys.
+     * @param loopback If true, the server to client keys are derived the same way as the client to server ones,
+     * so the object decrypts the packets it encrypted itself. Only meant for benchmarking without a server.
      * @return True if key generation was successful, otherwise false is returned.
      */
-    bool makeNewKeys();
+    bool makeNewKeys(bool loopback = false);
+
+    /**
+     * Starts encrypting with the client to server keys of a re-keying exchange, once 'NEWKEYS' is sent.
+     * @param next Crypto object the exchange made new keys in. Its client to server state is taken over, and compression restarts.
+     */
+    void switchKeysOut(ne7ssh_crypt& next);
+
+    /**
+     * Starts decrypting with the server to client keys of a re-keying exchange, once 'NEWKEYS' is received.
+     * @param next Crypto object the exchange made new keys in. Its server to client state is taken over, and decompression restarts.
+     */
+    void switchKeysIn(ne7ssh_crypt& next);
 
     /**
-     * Encrypts a packet and generates HMAC, if enabled during negotiation.
-     * <p>The entire packet is encrypted, only HMAC stays in raw format.
-     * @param crypted Encrypted packet will be dumped into this var.
-     * @param hmac HMAC will be dumped into this var.
-     * @param packet Reference to vector containing unencrypted packet.
+     * Encrypts a packet in place and appends the HMAC, if enabled during negotiation.
+     * <p>The entire packet is encrypted, only HMAC stays in raw format. With AES-GCM the length field
+     * stays in raw format too, as it does with encrypt-then-MAC, where the HMAC is computed over the encrypted packet.
+     * AEAD ciphers append the authentication tag in place of the HMAC.
+     * @param packet Reference to vector containing unencrypted packet. Replaced by the encrypted packet followed by getMacOutLen() bytes of HMAC.
      * @param seq Transmited packet sequence.
      * @return True if encryption successful, otherwise false is returned.
      */
-    bool encryptPacket(Botan::SecureVector<Botan::byte>& crypted, Botan::SecureVector<Botan::byte>& hmac, Botan::SecureVector<Botan::byte>& packet, uint32 seq);
+    bool encryptPacket(Botan::SecureVector<Botan::byte>& packet, uint32 seq);
 
     /**
      * Decrypts a packet.
@@ -334,39 +535,82 @@ public:
     bool decryptPacket(Botan::SecureVector<Botan::byte>& decrypted, Botan::SecureVector<Botan::byte>& packet, uint32 len);
 
     /**
-     * Computes HMAC from specific packet.
-     * @param hmac Generated HMAC value will be dumped into this var.
-     * @param packet Reference to vector containing packet for HMAC generation.
+     * Same as above, but decrypts a chunk in place of a larger receive buffer.
+     * @param decrypted Decrypted payload will be dumped into this var.
+     * @param packet Pointer to the encrypted chunk.
+     * @param len Length of the chunk. Has to be a multiple of the cipher block size.
+     * @return True if decryption is successful, otherwise false returned.
+     */
+    bool decryptPacket(Botan::SecureVector<Botan::byte>& decrypted, const Botan::byte* packet, uint32 len);
+
+    /**
+     * Authenticates and decrypts a whole packet received with an AEAD cipher or encrypt-then-MAC.
+     * @param decrypted Decrypted packet, including the length field, will be dumped into this var.
+     * @param packet Pointer to the received packet. The tag or MAC is expected to follow it.
+     * @param len Length of the packet, excluding the tag.
+     * @param seq Receive sequence.
+     * @return True if the tag matched and the packet was decrypted, otherwise false is returned.
+     */
+    bool decryptAadPacket(Botan::SecureVector<Botan::byte>& decrypted, const Botan::byte* packet, uint32 len, uint32 seq);
+
+    /**
+     * Reads the length field of a packet received with an AEAD cipher or encrypt-then-MAC.
+     * <p> With chacha20-poly1305@openssh.com the field is encrypted on its own, otherwise it is sent in the clear.
+     * @param packet Pointer to the first 4 bytes of the received packet.
+     * @param seq Receive sequence.
+     * @return Packet length, as found in the length field.
+     */
+    uint32 getAadPacketLength(const Botan::byte* packet, uint32 seq);
+
+    /**
+     * Verifies the HMAC of a received packet, comparing in constant time against the HMAC where it was received.
+     * @param packet Pointer to the decrypted packet, or to the encrypted one with encrypt-then-MAC.
+     * @param len Length of the packet.
+     * @param mac Pointer to the received HMAC, getMacInLen() bytes.
      * @param seq receive sequence.
+     * @return True if the HMAC matched, otherwise false is returned.
      */
-    void computeMac(Botan::SecureVector<Botan::byte>& hmac, Botan::SecureVector<Botan::byte>& packet, uint32 seq);
+    bool verifyMac(const Botan::byte* packet, uint32 len, const Botan::byte* mac, uint32 seq);
 
     /**
-     * Compresses the data.
-     * @param buffer Reference to vector containing payload to be compress. Results will also be dumped into this var.
+     * Compresses an outgoing payload, continuing the client to server zlib stream.
+     * @param out Reference to vector the compressed payload will be dumped into.
+     * @param payload Pointer to the payload.
+     * @param len Length of the payload.
+     * @return True on success, otherwise false is returned.
      */
-    void compressData(Botan::SecureVector<Botan::byte>& buffer);
+    bool compressData(Botan::SecureVector<Botan::byte>& out, const Botan::byte* payload, uint32 len);
 
     /**
-     * Decompresses the data.
-     * @param buffer Reference to vector containing packet payload to decompress. Result will also be dumped into this var.
+     * Decompresses a received payload, continuing the server to client zlib stream.
+     * @param out Reference to vector the decompressed payload will be dumped into.
+     * @param payload Pointer to the payload.
+     * @param len Length of the payload.
+     * @return True on success, false if the payload is corrupt or inflates beyond MAX_PACKET_LEN.
      */
-    void decompressData(Botan::SecureVector<Botan::byte>& buffer);
+    bool decompressData(Botan::SecureVector<Botan::byte>& out, const Botan::byte* payload, uint32 len);
 
     /**
-     * Checks if compression is enabled.
+     * Records that user authentication succeeded, starting any delayed "zlib@openssh.com" compression.
+     */
+    void setAuthenticated();
+
+    /**
+     * Checks if outgoing payloads are compressed.
      * @return If compression is enabled returns true, otherwise false is returned.
      */
-    bool isCompressed()
+    bool isCompressedOut()
+    {
+        return _compress ? true : false;
+    }
+
+    /**
+     * Checks if received payloads are compressed.
+     * @return If decompression is enabled returns true, otherwise false is returned.
+     */
+    bool isCompressedIn()
     {
-        if (_decompress)
-        {
-            return true;
-        }
-        else
-        {
-            return false;
-        }
+        return _decompress ? true : false;
     }
 
     /**
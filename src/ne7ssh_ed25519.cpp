@@ -0,0 +1,390 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+
+#include "ne7ssh_ed25519.h"
+#include "ne7ssh_fe25519.h"
+#include <botan/libstate.h>
+#include <botan/hash.h>
+#include <memory>
+#include <string.h>
+
+using namespace Botan;
+
+namespace
+{
+// Point on the twisted Edwards curve in extended coordinates, x = X/Z, y = Y/Z, x * y = T/Z
+struct EdPoint
+{
+    ne7ssh_fe25519 X, Y, Z, T;
+
+    void identity()
+    {
+        X.zero();
+        Y.one();
+        Z.one();
+        T.zero();
+    }
+};
+
+struct EdConstants
+{
+    ne7ssh_fe25519 d, d2, sqrtm1;
+    EdPoint base;
+};
+
+// Group order L = 2^252 + 27742317777372353535851937790883648493, little endian
+const int64 ORDER[32] =
+{
+    0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10
+};
+
+bool decodePoint(EdPoint& p, const Botan::byte* s, const EdConstants& c);
+
+// Derived once instead of being spelled out as limbs: d = -121665 / 121666, sqrt(-1) = 2^((p - 1) / 4)
+const EdConstants& constants()
+{
+    static const EdConstants c = []()
+    {
+        EdConstants r;
+        ne7ssh_fe25519 t;
+        Botan::byte base[32];
+
+        t.zero();
+        t.v[0] = 121666;
+        ne7ssh_fe25519::invert(t, t);
+        ne7ssh_fe25519::mulSmall(r.d, t, -121665);
+        ne7ssh_fe25519::mulSmall(r.d2, r.d, 2);
+
+        t.zero();
+        t.v[0] = 2;
+        ne7ssh_fe25519::pow22523(r.sqrtm1, t);
+        ne7ssh_fe25519::sq(r.sqrtm1, r.sqrtm1);
+        ne7ssh_fe25519::mul(r.sqrtm1, r.sqrtm1, t);
+
+        // y = 4/5, x positive
+        memset(base, 0x66, sizeof(base));
+        base[0] = 0x58;
+        decodePoint(r.base, base, r);
+        return r;
+    }();
+    return c;
+}
+
+// r = p + q, complete for all points including p == q
+void pointAdd(EdPoint& r, const EdPoint& p, const EdPoint& q, const EdConstants& c)
+{
+    ne7ssh_fe25519 a, b, cc, d, e, f, g, h;
+
+    ne7ssh_fe25519::sub(a, p.Y, p.X);
+    ne7ssh_fe25519::sub(e, q.Y, q.X);
+    ne7ssh_fe25519::mul(a, a, e);
+    ne7ssh_fe25519::add(b, p.Y, p.X);
+    ne7ssh_fe25519::add(e, q.Y, q.X);
+    ne7ssh_fe25519::mul(b, b, e);
+    ne7ssh_fe25519::mul(cc, p.T, q.T);
+    ne7ssh_fe25519::mul(cc, cc, c.d2);
+    ne7ssh_fe25519::mul(d, p.Z, q.Z);
+    ne7ssh_fe25519::mulSmall(d, d, 2);
+    ne7ssh_fe25519::sub(e, b, a);
+    ne7ssh_fe25519::sub(f, d, cc);
+    ne7ssh_fe25519::add(g, d, cc);
+    ne7ssh_fe25519::add(h, b, a);
+
+    ne7ssh_fe25519::mul(r.X, e, f);
+    ne7ssh_fe25519::mul(r.Y, h, g);
+    ne7ssh_fe25519::mul(r.Z, g, f);
+    ne7ssh_fe25519::mul(r.T, e, h);
+}
+
+void pointCswap(EdPoint& p, EdPoint& q, uint32 b)
+{
+    ne7ssh_fe25519::cswap(p.X, q.X, b);
+    ne7ssh_fe25519::cswap(p.Y, q.Y, b);
+    ne7ssh_fe25519::cswap(p.Z, q.Z, b);
+    ne7ssh_fe25519::cswap(p.T, q.T, b);
+}
+
+// r = [s]p, the same additions are done whatever the bits of s are
+void scalarMult(EdPoint& r, const EdPoint& p, const Botan::byte* s, const EdConstants& c)
+{
+    EdPoint q = p;
+    uint32 bit;
+    int i;
+
+    r.identity();
+    for (i = 255; i >= 0; i--)
+    {
+        bit = (s[i >> 3] >> (i & 7)) & 1;
+        pointCswap(r, q, bit);
+        pointAdd(q, q, r, c);
+        pointAdd(r, r, r, c);
+        pointCswap(r, q, bit);
+    }
+}
+
+void encodePoint(Botan::byte* s, const EdPoint& p)
+{
+    ne7ssh_fe25519 zi, x, y;
+
+    ne7ssh_fe25519::invert(zi, p.Z);
+    ne7ssh_fe25519::mul(x, p.X, zi);
+    ne7ssh_fe25519::mul(y, p.Y, zi);
+    y.toBytes(s);
+    s[31] ^= x.isNegative() << 7;
+}
+
+bool decodePoint(EdPoint& p, const Botan::byte* s, const EdConstants& c)
+{
+    ne7ssh_fe25519 u, v, v3, vxx, check;
+
+    p.Y.fromBytes(s);
+    p.Z.one();
+
+    // x^2 = (y^2 - 1) / (d * y^2 + 1) = u / v
+    ne7ssh_fe25519::sq(u, p.Y);
+    ne7ssh_fe25519::mul(v, u, c.d);
+    ne7ssh_fe25519::sub(u, u, p.Z);
+    ne7ssh_fe25519::add(v, v, p.Z);
+
+    // Candidate root x = u * v^3 * (u * v^7)^((p - 5) / 8)
+    ne7ssh_fe25519::sq(v3, v);
+    ne7ssh_fe25519::mul(v3, v3, v);
+    ne7ssh_fe25519::sq(p.X, v3);
+    ne7ssh_fe25519::mul(p.X, p.X, v);
+    ne7ssh_fe25519::mul(p.X, p.X, u);
+    ne7ssh_fe25519::pow22523(p.X, p.X);
+    ne7ssh_fe25519::mul(p.X, p.X, v3);
+    ne7ssh_fe25519::mul(p.X, p.X, u);
+
+    ne7ssh_fe25519::sq(vxx, p.X);
+    ne7ssh_fe25519::mul(vxx, vxx, v);
+    // v * x^2 is either u, or -u when x has to be multiplied by sqrt(-1). mulSmall() carries before the test.
+    ne7ssh_fe25519::sub(check, vxx, u);
+    ne7ssh_fe25519::mulSmall(check, check, 1);
+    if (!check.isZero())
+    {
+        ne7ssh_fe25519::add(check, vxx, u);
+        ne7ssh_fe25519::mulSmall(check, check, 1);
+        if (!check.isZero())
+        {
+            return false;
+        }
+        ne7ssh_fe25519::mul(p.X, p.X, c.sqrtm1);
+    }
+
+    if (p.X.isNegative() != (s[31] >> 7))
+    {
+        ne7ssh_fe25519::neg(p.X, p.X);
+    }
+    ne7ssh_fe25519::mul(p.T, p.X, p.Y);
+    return true;
+}
+
+// Reduces the 64 byte little endian number in x modulo L into r, in constant time
+void modOrder(Botan::byte* r, int64* x)
+{
+    int64 carry;
+    int i, j;
+
+    for (i = 63; i >= 32; i--)
+    {
+        carry = 0;
+        for (j = i - 32; j < i - 12; j++)
+        {
+            x[j] += carry - 16 * x[i] * ORDER[j - (i - 32)];
+            carry = (x[j] + 128) >> 8;
+            x[j] -= carry * 256;
+        }
+        x[j] += carry;
+        x[i] = 0;
+    }
+    carry = 0;
+    for (j = 0; j < 32; j++)
+    {
+        x[j] += carry - (x[31] >> 4) * ORDER[j];
+        carry = x[j] >> 8;
+        x[j] &= 255;
+    }
+    for (j = 0; j < 32; j++)
+    {
+        x[j] -= carry * ORDER[j];
+    }
+    for (i = 0; i < 32; i++)
+    {
+        x[i + 1] += x[i] >> 8;
+        r[i] = (Botan::byte)(x[i] & 255);
+    }
+}
+
+// Reduces a 64 byte hash modulo L, leaving the result in its first 32 bytes
+void reduceHash(Botan::byte* h)
+{
+    int64 x[64];
+    int i;
+
+    for (i = 0; i < 64; i++)
+    {
+        x[i] = h[i];
+    }
+    memset(h, 0, 64);
+    modOrder(h, x);
+}
+
+// s < L, rejects malleable signatures
+bool scalarCanonical(const Botan::byte* s)
+{
+    int i;
+
+    for (i = 31; i >= 0; i--)
+    {
+        if (s[i] != ORDER[i])
+        {
+            return s[i] < ORDER[i];
+        }
+    }
+    return false;
+}
+
+// SHA-512 of up to three concatenated parts
+bool sha512(Botan::byte* out, const Botan::byte* a, uint32 aLen, const Botan::byte* b, uint32 bLen, const Botan::byte* m, uint32 mLen)
+{
+    std::unique_ptr<HashFunction> hashIt(global_state().algorithm_factory().make_hash_function("SHA-512"));
+
+    if (!hashIt)
+    {
+        return false;
+    }
+    hashIt->update(a, aLen);
+    hashIt->update(b, bLen);
+    hashIt->update(m, mLen);
+    hashIt->final(out);
+    return true;
+}
+
+// Secret scalar of a seed, clamped, followed by the nonce prefix
+bool expandSeed(Botan::byte* az, const Botan::byte* seed)
+{
+    if (!sha512(az, seed, NE7SSH_ED25519_KEY_LEN, 0, 0, 0, 0))
+    {
+        return false;
+    }
+    az[0] &= 248;
+    az[31] &= 63;
+    az[31] |= 64;
+    return true;
+}
+}
+
+bool ne7ssh_ed25519::publicKey(Botan::byte* pub, const Botan::byte* seed)
+{
+    const EdConstants& c = constants();
+    Botan::byte az[64];
+    EdPoint a;
+
+    if (!expandSeed(az, seed))
+    {
+        return false;
+    }
+    scalarMult(a, c.base, az, c);
+    encodePoint(pub, a);
+    memset(az, 0, sizeof(az));
+    return true;
+}
+
+bool ne7ssh_ed25519::sign(Botan::byte* sig, const Botan::byte* msg, uint32 len, const Botan::byte* seed, const Botan::byte* pub)
+{
+    const EdConstants& c = constants();
+    Botan::byte az[64], nonce[64], hram[64];
+    int64 x[64];
+    EdPoint r;
+    int i, j;
+
+    if (!expandSeed(az, seed) || !sha512(nonce, az + 32, 32, msg, len, 0, 0))
+    {
+        memset(az, 0, sizeof(az));
+        return false;
+    }
+    reduceHash(nonce);
+    scalarMult(r, c.base, nonce, c);
+    encodePoint(sig, r);
+
+    if (!sha512(hram, sig, 32, pub, NE7SSH_ED25519_KEY_LEN, msg, len))
+    {
+        memset(az, 0, sizeof(az));
+        memset(nonce, 0, sizeof(nonce));
+        return false;
+    }
+    reduceHash(hram);
+
+    // S = nonce + hram * a mod L
+    memset(x, 0, sizeof(x));
+    for (i = 0; i < 32; i++)
+    {
+        x[i] = nonce[i];
+    }
+    for (i = 0; i < 32; i++)
+    {
+        for (j = 0; j < 32; j++)
+        {
+            x[i + j] += (int64)hram[i] * az[j];
+        }
+    }
+    modOrder(sig + 32, x);
+
+    memset(az, 0, sizeof(az));
+    memset(nonce, 0, sizeof(nonce));
+    memset(x, 0, sizeof(x));
+    return true;
+}
+
+bool ne7ssh_ed25519::verify(const Botan::byte* sig, const Botan::byte* msg, uint32 len, const Botan::byte* pub)
+{
+    const EdConstants& c = constants();
+    Botan::byte hram[64], check[32];
+    EdPoint a, p;
+    int i;
+
+    if (!scalarCanonical(sig + 32) || !decodePoint(a, pub, c))
+    {
+        return false;
+    }
+    if (!sha512(hram, sig, 32, pub, NE7SSH_ED25519_KEY_LEN, msg, len))
+    {
+        return false;
+    }
+    reduceHash(hram);
+
+    // [S]B - [h]A, both scalars walked together since nothing here is secret
+    ne7ssh_fe25519::neg(a.X, a.X);
+    ne7ssh_fe25519::neg(a.T, a.T);
+    p.identity();
+    for (i = 255; i >= 0; i--)
+    {
+        pointAdd(p, p, p, c);
+        if ((hram[i >> 3] >> (i & 7)) & 1)
+        {
+            pointAdd(p, p, a, c);
+        }
+        if ((sig[32 + (i >> 3)] >> (i & 7)) & 1)
+        {
+            pointAdd(p, p, c.base, c);
+        }
+    }
+    encodePoint(check, p);
+    return memcmp(check, sig, 32) == 0;
+}
@@ -0,0 +1,65 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+
+#ifndef NE7SSH_ED25519_H
+#define NE7SSH_ED25519_H
+
+#include "ne7ssh_types.h"
+#include <botan/types.h>
+
+#define NE7SSH_ED25519_KEY_LEN 32
+#define NE7SSH_ED25519_SIG_LEN 64
+
+/**
+ * Ed25519 signatures (RFC 8032), used by ssh-ed25519 host and user keys.
+ * <p>Botan 1.10 has no Ed25519. Signing and key derivation run in constant time,
+ * verification only handles public data and does not.
+ */
+class ne7ssh_ed25519
+{
+public:
+    /**
+     * Derives the public key from a private key seed.
+     * @param pub Buffer receiving the NE7SSH_ED25519_KEY_LEN byte public key.
+     * @param seed Pointer to the NE7SSH_ED25519_KEY_LEN byte private key seed.
+     * @return True if the key was derived, false if SHA-512 is not available.
+     */
+    static bool publicKey(Botan::byte* pub, const Botan::byte* seed);
+
+    /**
+     * Signs a message.
+     * @param sig Buffer receiving the NE7SSH_ED25519_SIG_LEN byte signature.
+     * @param msg Pointer to the message.
+     * @param len Length of the message.
+     * @param seed Pointer to the NE7SSH_ED25519_KEY_LEN byte private key seed.
+     * @param pub Pointer to the NE7SSH_ED25519_KEY_LEN byte public key belonging to the seed.
+     * @return True if the message was signed, false if SHA-512 is not available.
+     */
+    static bool sign(Botan::byte* sig, const Botan::byte* msg, uint32 len, const Botan::byte* seed, const Botan::byte* pub);
+
+    /**
+     * Verifies a signature.
+     * @param sig Pointer to the NE7SSH_ED25519_SIG_LEN byte signature.
+     * @param msg Pointer to the message.
+     * @param len Length of the message.
+     * @param pub Pointer to the NE7SSH_ED25519_KEY_LEN byte public key.
+     * @return True if the signature is valid, otherwise false is returned.
+     */
+    static bool verify(const Botan::byte* sig, const Botan::byte* msg, uint32 len, const Botan::byte* pub);
+};
+
+#endif
@@ -0,0 +1,381 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_fe25519.h"
+#include <string.h>
+
+using namespace Botan;
+
+namespace
+{
+// Bit position of each limb, ceil(25.5 * i)
+const int LIMB_POS[10] = { 0, 26, 51, 77, 102, 128, 153, 179, 204, 230 };
+
+int limbBits(int i)
+{
+    return (i & 1) ? 25 : 26;
+}
+
+// Moves the excess of limb i into limb i + 1, rounding so limbs may end up negative
+inline void carryStep(int64* t, int i)
+{
+    int bits = limbBits(i);
+    int64 c = (t[i] + ((int64)1 << (bits - 1))) >> bits;
+
+    t[i] -= c * ((int64)1 << bits);
+    if (i == 9)
+    {
+        t[0] += 19 * c;
+    }
+    else
+    {
+        t[i + 1] += c;
+    }
+}
+
+// Brings every limb back to its 26 or 25 bit range.
+// Two carry chains run side by side, starting at limbs 0 and 4, as in the ref10 code.
+void carry(ne7ssh_fe25519& h, int64* t)
+{
+    int i;
+
+    carryStep(t, 0);
+    carryStep(t, 4);
+    carryStep(t, 1);
+    carryStep(t, 5);
+    carryStep(t, 2);
+    carryStep(t, 6);
+    carryStep(t, 3);
+    carryStep(t, 7);
+    carryStep(t, 4);
+    carryStep(t, 8);
+    carryStep(t, 9);
+    carryStep(t, 0);
+
+    for (i = 0; i < 10; i++)
+    {
+        h.v[i] = (int32)t[i];
+    }
+}
+}
+
+void ne7ssh_fe25519::zero()
+{
+    memset(v, 0, sizeof(v));
+}
+
+void ne7ssh_fe25519::one()
+{
+    zero();
+    v[0] = 1;
+}
+
+void ne7ssh_fe25519::fromBytes(const Botan::byte* s)
+{
+    uint64 word;
+    int i, j, first;
+
+    for (i = 0; i < 10; i++)
+    {
+        first = LIMB_POS[i] / 8;
+        word = 0;
+        for (j = 7; j >= 0; j--)
+        {
+            word <<= 8;
+            if (first + j < 32)
+            {
+                word |= s[first + j];
+            }
+        }
+        v[i] = (int32)((word >> (LIMB_POS[i] % 8)) & ((1 << limbBits(i)) - 1));
+    }
+}
+
+void ne7ssh_fe25519::toBytes(Botan::byte* s) const
+{
+    int32 h[10];
+    int32 q, c;
+    uint64 acc = 0;
+    int i, accBits = 0, out = 0;
+
+    memcpy(h, v, sizeof(h));
+
+    // q is 1 if the value is at least p, 0 otherwise
+    q = (19 * h[9] + (1 << 24)) >> 25;
+    for (i = 0; i < 10; i++)
+    {
+        q = (h[i] + q) >> limbBits(i);
+    }
+
+    // Subtract q * p, then carry without rounding so all limbs end up non-negative
+    h[0] += 19 * q;
+    for (i = 0; i < 9; i++)
+    {
+        c = h[i] >> limbBits(i);
+        h[i + 1] += c;
+        h[i] -= c * (1 << limbBits(i));
+    }
+    c = h[9] >> 25;
+    h[9] -= c * (1 << 25);
+
+    for (i = 0; i < 10; i++)
+    {
+        acc |= (uint64)h[i] << accBits;
+        accBits += limbBits(i);
+        while (accBits >= 8)
+        {
+            s[out++] = (Botan::byte)acc;
+            acc >>= 8;
+            accBits -= 8;
+        }
+    }
+    s[out] = (Botan::byte)acc;
+}
+
+bool ne7ssh_fe25519::isZero() const
+{
+    Botan::byte s[32];
+    Botan::byte diff = 0;
+    int i;
+
+    toBytes(s);
+    for (i = 0; i < 32; i++)
+    {
+        diff |= s[i];
+    }
+    return diff == 0;
+}
+
+int ne7ssh_fe25519::isNegative() const
+{
+    Botan::byte s[32];
+
+    toBytes(s);
+    return s[0] & 1;
+}
+
+void ne7ssh_fe25519::add(ne7ssh_fe25519& h, const ne7ssh_fe25519& f, const ne7ssh_fe25519& g)
+{
+    int i;
+
+    for (i = 0; i < 10; i++)
+    {
+        h.v[i] = f.v[i] + g.v[i];
+    }
+}
+
+void ne7ssh_fe25519::sub(ne7ssh_fe25519& h, const ne7ssh_fe25519& f, const ne7ssh_fe25519& g)
+{
+    int i;
+
+    for (i = 0; i < 10; i++)
+    {
+        h.v[i] = f.v[i] - g.v[i];
+    }
+}
+
+void ne7ssh_fe25519::neg(ne7ssh_fe25519& h, const ne7ssh_fe25519& f)
+{
+    int i;
+
+    for (i = 0; i < 10; i++)
+    {
+        h.v[i] = -f.v[i];
+    }
+}
+
+void ne7ssh_fe25519::mul(ne7ssh_fe25519& h, const ne7ssh_fe25519& f, const ne7ssh_fe25519& g)
+{
+    int64 t[19];
+    int64 g2[10];
+    int64 fi;
+    int i, j;
+
+    // Two odd limbs are each half a bit short of their position, so their product is counted twice
+    for (j = 0; j < 10; j++)
+    {
+        g2[j] = (int64)g.v[j] * (1 + (j & 1));
+    }
+    memset(t, 0, sizeof(t));
+    for (i = 0; i < 10; i += 2)
+    {
+        fi = f.v[i];
+        for (j = 0; j < 10; j++)
+        {
+            t[i + j] += fi * g.v[j];
+        }
+        fi = f.v[i + 1];
+        for (j = 0; j < 10; j++)
+        {
+            t[i + 1 + j] += fi * g2[j];
+        }
+    }
+    // 2^255 = 19 mod p
+    for (i = 18; i >= 10; i--)
+    {
+        t[i - 10] += 19 * t[i];
+    }
+    carry(h, t);
+}
+
+void ne7ssh_fe25519::sq(ne7ssh_fe25519& h, const ne7ssh_fe25519& f)
+{
+    mul(h, f, f);
+}
+
+void ne7ssh_fe25519::mulSmall(ne7ssh_fe25519& h, const ne7ssh_fe25519& f, int32 n)
+{
+    int64 t[10];
+    int i;
+
+    for (i = 0; i < 10; i++)
+    {
+        t[i] = (int64)f.v[i] * n;
+    }
+    carry(h, t);
+}
+
+void ne7ssh_fe25519::invert(ne7ssh_fe25519& h, const ne7ssh_fe25519& z)
+{
+    ne7ssh_fe25519 t0, t1, t2, t3;
+    int i;
+
+    // Addition chain for 2^255 - 21
+    sq(t0, z);
+    sq(t1, t0);
+    sq(t1, t1);
+    mul(t1, z, t1);
+    mul(t0, t0, t1);
+    sq(t2, t0);
+    mul(t1, t1, t2);
+    sq(t2, t1);
+    for (i = 1; i < 5; i++)
+    {
+        sq(t2, t2);
+    }
+    mul(t1, t2, t1);
+    sq(t2, t1);
+    for (i = 1; i < 10; i++)
+    {
+        sq(t2, t2);
+    }
+    mul(t2, t2, t1);
+    sq(t3, t2);
+    for (i = 1; i < 20; i++)
+    {
+        sq(t3, t3);
+    }
+    mul(t2, t3, t2);
+    for (i = 0; i < 10; i++)
+    {
+        sq(t2, t2);
+    }
+    mul(t1, t2, t1);
+    sq(t2, t1);
+    for (i = 1; i < 50; i++)
+    {
+        sq(t2, t2);
+    }
+    mul(t2, t2, t1);
+    sq(t3, t2);
+    for (i = 1; i < 100; i++)
+    {
+        sq(t3, t3);
+    }
+    mul(t2, t3, t2);
+    for (i = 0; i < 50; i++)
+    {
+        sq(t2, t2);
+    }
+    mul(t1, t2, t1);
+    for (i = 0; i < 5; i++)
+    {
+        sq(t1, t1);
+    }
+    mul(h, t1, t0);
+}
+
+void ne7ssh_fe25519::pow22523(ne7ssh_fe25519& h, const ne7ssh_fe25519& z)
+{
+    ne7ssh_fe25519 t0, t1, t2;
+    int i;
+
+    // Addition chain for 2^252 - 3
+    sq(t0, z);
+    sq(t1, t0);
+    sq(t1, t1);
+    mul(t1, z, t1);
+    mul(t0, t0, t1);
+    sq(t0, t0);
+    mul(t0, t1, t0);
+    sq(t1, t0);
+    for (i = 1; i < 5; i++)
+    {
+        sq(t1, t1);
+    }
+    mul(t0, t1, t0);
+    sq(t1, t0);
+    for (i = 1; i < 10; i++)
+    {
+        sq(t1, t1);
+    }
+    mul(t1, t1, t0);
+    sq(t2, t1);
+    for (i = 1; i < 20; i++)
+    {
+        sq(t2, t2);
+    }
+    mul(t1, t2, t1);
+    for (i = 0; i < 10; i++)
+    {
+        sq(t1, t1);
+    }
+    mul(t0, t1, t0);
+    sq(t1, t0);
+    for (i = 1; i < 50; i++)
+    {
+        sq(t1, t1);
+    }
+    mul(t1, t1, t0);
+    sq(t2, t1);
+    for (i = 1; i < 100; i++)
+    {
+        sq(t2, t2);
+    }
+    mul(t1, t2, t1);
+    for (i = 0; i < 50; i++)
+    {
+        sq(t1, t1);
+    }
+    mul(t0, t1, t0);
+    sq(t0, t0);
+    sq(t0, t0);
+    mul(h, t0, z);
+}
+
+void ne7ssh_fe25519::cswap(ne7ssh_fe25519& f, ne7ssh_fe25519& g, uint32 b)
+{
+    int32 mask = -(int32)b;
+    int32 x;
+    int i;
+
+    for (i = 0; i < 10; i++)
+    {
+        x = (f.v[i] ^ g.v[i]) & mask;
+        f.v[i] ^= x;
+        g.v[i] ^= x;
+    }
+}
@@ -0,0 +1,114 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_FE25519_H
+#define NE7SSH_FE25519_H
+
+#include "ne7ssh_types.h"
+#include <botan/types.h>
+
+/**
+ * Element of the field of integers modulo 2^255 - 19, as used by Curve25519 and Ed25519.
+ * <p>Stored in ten signed limbs of alternately 26 and 25 bits, so products fit in 64 bits on any platform.
+ * None of the operations branch on or index by the value, they all run in constant time.
+ * Results of add() and sub() are not carried and have to go through mul() or sq() before another add() or sub().
+ */
+class ne7ssh_fe25519
+{
+public:
+    int32 v[10];
+
+    /**
+     * Sets the element to 0.
+     */
+    void zero();
+
+    /**
+     * Sets the element to 1.
+     */
+    void one();
+
+    /**
+     * Loads a 32 byte little endian number, the top bit is ignored.
+     * @param s Pointer to 32 bytes.
+     */
+    void fromBytes(const Botan::byte* s);
+
+    /**
+     * Stores the fully reduced element as a 32 byte little endian number.
+     * @param s Buffer receiving 32 bytes.
+     */
+    void toBytes(Botan::byte* s) const;
+
+    /**
+     * Checks if the element is 0.
+     * @return True if the element is 0, otherwise false is returned.
+     */
+    bool isZero() const;
+
+    /**
+     * Returns the lowest bit of the fully reduced element, which Ed25519 uses as the sign of x.
+     * @return 1 if the element is odd, 0 otherwise.
+     */
+    int isNegative() const;
+
+    /**
+     * h = f + g
+     */
+    static void add(ne7ssh_fe25519& h, const ne7ssh_fe25519& f, const ne7ssh_fe25519& g);
+
+    /**
+     * h = f - g
+     */
+    static void sub(ne7ssh_fe25519& h, const ne7ssh_fe25519& f, const ne7ssh_fe25519& g);
+
+    /**
+     * h = f * g. h may be the same object as f or g.
+     */
+    static void mul(ne7ssh_fe25519& h, const ne7ssh_fe25519& f, const ne7ssh_fe25519& g);
+
+    /**
+     * h = -f
+     */
+    static void neg(ne7ssh_fe25519& h, const ne7ssh_fe25519& f);
+
+    /**
+     * h = f * f
+     */
+    static void sq(ne7ssh_fe25519& h, const ne7ssh_fe25519& f);
+
+    /**
+     * h = f * n, for a small constant n.
+     */
+    static void mulSmall(ne7ssh_fe25519& h, const ne7ssh_fe25519& f, int32 n);
+
+    /**
+     * h = 1 / z, computed as z^(p - 2). The inverse of 0 is 0.
+     */
+    static void invert(ne7ssh_fe25519& h, const ne7ssh_fe25519& z);
+
+    /**
+     * h = z^((p - 5) / 8), the exponent used for square roots.
+     */
+    static void pow22523(ne7ssh_fe25519& h, const ne7ssh_fe25519& z);
+
+    /**
+     * Swaps f and g if b is 1, leaves them if b is 0.
+     */
+    static void cswap(ne7ssh_fe25519& f, ne7ssh_fe25519& g, uint32 b);
+};
+
+#endif
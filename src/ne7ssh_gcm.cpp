@@ -0,0 +1,372 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_gcm.h"
+#include "ne7ssh_aes.h"
+#include <algorithm>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) && \
+    (defined(_MSC_VER) || defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 5)))
+#   define NE7SSH_GCM_CLMUL
+#   include <wmmintrin.h>
+#   include <tmmintrin.h>
+#   ifdef _MSC_VER
+#       define NE7SSH_CLMUL_TARGET
+#   else
+#       define NE7SSH_CLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+#   endif
+#endif
+
+using namespace Botan;
+
+#define NE7SSH_GCM_BLOCK 16
+// Counter blocks encrypted per encrypt_n() call
+#define NE7SSH_GCM_BATCH 16
+
+namespace
+{
+// Reduction constants for the 4 bit table method, shifted into the top 16 bits
+const uint64 REM_4BIT[16] =
+{
+    (uint64)0x0000 << 48, (uint64)0x1C20 << 48, (uint64)0x3840 << 48, (uint64)0x2460 << 48,
+    (uint64)0x7080 << 48, (uint64)0x6CA0 << 48, (uint64)0x48C0 << 48, (uint64)0x54E0 << 48,
+    (uint64)0xE100 << 48, (uint64)0xFD20 << 48, (uint64)0xD940 << 48, (uint64)0xC560 << 48,
+    (uint64)0x9180 << 48, (uint64)0x8DA0 << 48, (uint64)0xA9C0 << 48, (uint64)0xB5E0 << 48
+};
+
+uint64 load64(const Botan::byte* in)
+{
+    uint64 result = 0;
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        result = (result << 8) | in[i];
+    }
+    return result;
+}
+
+void store64(Botan::byte* out, uint64 val)
+{
+    int i;
+
+    for (i = 7; i >= 0; i--)
+    {
+        out[i] = (Botan::byte)val;
+        val >>= 8;
+    }
+}
+
+#ifdef NE7SSH_GCM_CLMUL
+// GHASH with carry-less multiplication, as in Intel's "Carry-Less Multiplication and Its Usage for Computing the GCM Mode".
+// Operands are byte reflected so the bit reflected GCM field maps onto PCLMULQDQ, product is shifted left one bit and reduced.
+NE7SSH_CLMUL_TARGET
+void ghashClmul(const uint64* h, Botan::byte* x, const Botan::byte* data, uint32 len)
+{
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i hKey = _mm_set_epi64x((long long)h[0], (long long)h[1]);
+    __m128i acc = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)x), reverse);
+    __m128i lo, mid, hi, t1, t2, t3;
+    Botan::byte block[NE7SSH_GCM_BLOCK];
+
+    while (len)
+    {
+        if (len >= NE7SSH_GCM_BLOCK)
+        {
+            t1 = _mm_loadu_si128((const __m128i*)data);
+            data += NE7SSH_GCM_BLOCK;
+            len -= NE7SSH_GCM_BLOCK;
+        }
+        else
+        {
+            memset(block, 0, sizeof(block));
+            memcpy(block, data, len);
+            t1 = _mm_loadu_si128((const __m128i*)block);
+            len = 0;
+        }
+        acc = _mm_xor_si128(acc, _mm_shuffle_epi8(t1, reverse));
+
+        lo = _mm_clmulepi64_si128(acc, hKey, 0x00);
+        mid = _mm_xor_si128(_mm_clmulepi64_si128(acc, hKey, 0x10), _mm_clmulepi64_si128(acc, hKey, 0x01));
+        hi = _mm_clmulepi64_si128(acc, hKey, 0x11);
+        lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+        hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+        // Shift the 256 bit product left by one
+        t1 = _mm_srli_epi32(lo, 31);
+        t2 = _mm_srli_epi32(hi, 31);
+        lo = _mm_slli_epi32(lo, 1);
+        hi = _mm_slli_epi32(hi, 1);
+        t3 = _mm_srli_si128(t1, 12);
+        t2 = _mm_slli_si128(t2, 4);
+        t1 = _mm_slli_si128(t1, 4);
+        lo = _mm_or_si128(lo, t1);
+        hi = _mm_or_si128(_mm_or_si128(hi, t2), t3);
+
+        // Reduce modulo x^128 + x^7 + x^2 + x + 1
+        t1 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+        t2 = _mm_srli_si128(t1, 4);
+        lo = _mm_xor_si128(lo, _mm_slli_si128(t1, 12));
+        t3 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+        lo = _mm_xor_si128(lo, _mm_xor_si128(t3, t2));
+        acc = _mm_xor_si128(hi, lo);
+    }
+    _mm_storeu_si128((__m128i*)x, _mm_shuffle_epi8(acc, reverse));
+}
+#endif
+
+void inc32(Botan::byte* counter)
+{
+    int i;
+
+    for (i = NE7SSH_GCM_BLOCK - 1; i >= NE7SSH_GCM_BLOCK - 4; i--)
+    {
+        if (++counter[i])
+        {
+            break;
+        }
+    }
+}
+}
+
+ne7ssh_gcm::ne7ssh_gcm(Botan::BlockCipher* cipher, const Botan::SymmetricKey& key, const Botan::InitializationVector& iv)
+    : _cipher(cipher),
+    _iv(NE7SSH_GCM_IV_LEN),
+    _hTable(32),
+    _keyStream(NE7SSH_GCM_BLOCK * NE7SSH_GCM_BATCH)
+{
+    Botan::byte h[NE7SSH_GCM_BLOCK];
+    uint64 vHi, vLo, t;
+    int i, j;
+
+    _cipher->set_key(key);
+    memcpy(_iv.begin(), iv.begin(), std::min<size_t>(iv.length(), NE7SSH_GCM_IV_LEN));
+
+    memset(h, 0, sizeof(h));
+    _cipher->encrypt(h);
+    vHi = load64(h);
+    vLo = load64(h + 8);
+    memset(h, 0, sizeof(h));
+
+    // Table of H multiplied by every 4 bit value, entry 8 is H itself
+    _hTable[16] = vHi;
+    _hTable[17] = vLo;
+    for (i = 4; i > 0; i >>= 1)
+    {
+        t = (uint64)0xe100000000000000ULL & (0 - (vLo & 1));
+        vLo = (vHi << 63) | (vLo >> 1);
+        vHi = (vHi >> 1) ^ t;
+        _hTable[2 * i] = vHi;
+        _hTable[2 * i + 1] = vLo;
+    }
+    for (i = 2; i < 16; i <<= 1)
+    {
+        for (j = 1; j < i; j++)
+        {
+            _hTable[2 * (i + j)] = _hTable[2 * i] ^ _hTable[2 * j];
+            _hTable[2 * (i + j) + 1] = _hTable[2 * i + 1] ^ _hTable[2 * j + 1];
+        }
+    }
+}
+
+void ne7ssh_gcm::gmult(Botan::byte* x) const
+{
+    const uint64* table = _hTable.begin();
+    uint64 zHi, zLo, rem;
+    Botan::byte nLo, nHi;
+    int cnt = 15;
+
+    nLo = x[15];
+    nHi = nLo >> 4;
+    nLo &= 0x0f;
+    zHi = table[2 * nLo];
+    zLo = table[2 * nLo + 1];
+
+    while (true)
+    {
+        rem = zLo & 0x0f;
+        zLo = (zHi << 60) | (zLo >> 4);
+        zHi = (zHi >> 4) ^ REM_4BIT[rem];
+        zHi ^= table[2 * nHi];
+        zLo ^= table[2 * nHi + 1];
+
+        if (--cnt < 0)
+        {
+            break;
+        }
+
+        nLo = x[cnt];
+        nHi = nLo >> 4;
+        nLo &= 0x0f;
+
+        rem = zLo & 0x0f;
+        zLo = (zHi << 60) | (zLo >> 4);
+        zHi = (zHi >> 4) ^ REM_4BIT[rem];
+        zHi ^= table[2 * nLo];
+        zLo ^= table[2 * nLo + 1];
+    }
+
+    store64(x, zHi);
+    store64(x + 8, zLo);
+}
+
+void ne7ssh_gcm::ghash(Botan::byte* x, const Botan::byte* data, uint32 len) const
+{
+    uint32 i, chunk;
+
+#ifdef NE7SSH_GCM_CLMUL
+    if (ne7ssh_aes::hasClmul())
+    {
+        // Entry 8 of the table is H
+        ghashClmul(_hTable.begin() + 16, x, data, len);
+        return;
+    }
+#endif
+    while (len)
+    {
+        chunk = std::min<uint32>(len, NE7SSH_GCM_BLOCK);
+        for (i = 0; i < chunk; i++)
+        {
+            x[i] ^= data[i];
+        }
+        gmult(x);
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+void ne7ssh_gcm::ctr(Botan::byte* counter, Botan::byte* data, uint32 len)
+{
+    Botan::byte* keyStream = _keyStream.begin();
+    uint32 i, n, blocks, batch;
+
+    blocks = (len + NE7SSH_GCM_BLOCK - 1) / NE7SSH_GCM_BLOCK;
+    while (blocks)
+    {
+        batch = std::min<uint32>(blocks, NE7SSH_GCM_BATCH);
+        for (n = 0; n < batch; n++)
+        {
+            memcpy(keyStream + n * NE7SSH_GCM_BLOCK, counter, NE7SSH_GCM_BLOCK);
+            inc32(counter);
+        }
+        _cipher->encrypt_n(keyStream, keyStream, batch);
+
+        n = std::min<uint32>(len, batch * NE7SSH_GCM_BLOCK);
+        for (i = 0; i < n; i++)
+        {
+            data[i] ^= keyStream[i];
+        }
+
+        data += n;
+        len -= n;
+        blocks -= batch;
+    }
+}
+
+void ne7ssh_gcm::authenticate(Botan::byte* tag, const Botan::byte* aad, uint32 aadLen, const Botan::byte* data, uint32 len) const
+{
+    Botan::byte lengths[NE7SSH_GCM_BLOCK];
+
+    memset(tag, 0, NE7SSH_GCM_BLOCK);
+    ghash(tag, aad, aadLen);
+    ghash(tag, data, len);
+
+    store64(lengths, (uint64)aadLen * 8);
+    store64(lengths + 8, (uint64)len * 8);
+    ghash(tag, lengths, NE7SSH_GCM_BLOCK);
+}
+
+void ne7ssh_gcm::startCounter(Botan::byte* counter, Botan::byte* tagMask)
+{
+    memcpy(counter, _iv.begin(), NE7SSH_GCM_IV_LEN);
+    counter[12] = counter[13] = counter[14] = 0;
+    counter[15] = 1;
+    _cipher->encrypt(counter, tagMask);
+    inc32(counter);
+}
+
+void ne7ssh_gcm::nextIv()
+{
+    int i;
+
+    // Invocation counter is the last 8 bytes of the IV
+    for (i = NE7SSH_GCM_IV_LEN - 1; i >= NE7SSH_GCM_IV_LEN - 8; i--)
+    {
+        if (++_iv[i])
+        {
+            break;
+        }
+    }
+}
+
+void ne7ssh_gcm::encrypt(const Botan::byte* aad, uint32 aadLen, Botan::byte* data, uint32 len, Botan::byte* tag)
+{
+    Botan::byte counter[NE7SSH_GCM_BLOCK];
+    Botan::byte tagMask[NE7SSH_GCM_BLOCK];
+    uint32 i;
+
+    startCounter(counter, tagMask);
+    ctr(counter, data, len);
+    authenticate(tag, aad, aadLen, data, len);
+    for (i = 0; i < NE7SSH_GCM_TAG_LEN; i++)
+    {
+        tag[i] ^= tagMask[i];
+    }
+    nextIv();
+}
+
+bool ne7ssh_gcm::decrypt(const Botan::byte* aad, uint32 aadLen, Botan::byte* data, uint32 len, const Botan::byte* tag)
+{
+    Botan::byte counter[NE7SSH_GCM_BLOCK];
+    Botan::byte tagMask[NE7SSH_GCM_BLOCK];
+    Botan::byte ourTag[NE7SSH_GCM_BLOCK];
+    Botan::byte diff = 0;
+    uint32 i;
+
+    startCounter(counter, tagMask);
+    authenticate(ourTag, aad, aadLen, data, len);
+    for (i = 0; i < NE7SSH_GCM_TAG_LEN; i++)
+    {
+        diff |= ourTag[i] ^ tagMask[i] ^ tag[i];
+    }
+    if (diff)
+    {
+        return false;
+    }
+    ctr(counter, data, len);
+    nextIv();
+    return true;
+}
+
+bool ne7ssh_gcm::seal(Botan::byte* packet, uint32 len, Botan::byte* tag)
+{
+    if ((len < sizeof(uint32)) || ((len - sizeof(uint32)) % NE7SSH_GCM_BLOCK))
+    {
+        return false;
+    }
+    encrypt(packet, sizeof(uint32), packet + sizeof(uint32), len - sizeof(uint32), tag);
+    return true;
+}
+
+bool ne7ssh_gcm::open(Botan::byte* packet, uint32 len, const Botan::byte* tag)
+{
+    if ((len < sizeof(uint32)) || ((len - sizeof(uint32)) % NE7SSH_GCM_BLOCK))
+    {
+        return false;
+    }
+    return decrypt(packet, sizeof(uint32), packet + sizeof(uint32), len - sizeof(uint32), tag);
+}
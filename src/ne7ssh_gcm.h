@@ -0,0 +1,137 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_GCM_H
+#define NE7SSH_GCM_H
+
+#include "ne7ssh_types.h"
+#include <botan/block_cipher.h>
+#include <botan/symkey.h>
+#include <memory>
+
+#define NE7SSH_GCM_IV_LEN 12
+#define NE7SSH_GCM_TAG_LEN 16
+
+/**
+ * AES-GCM as used by the aes128-gcm@openssh.com and aes256-gcm@openssh.com ciphers (RFC 5647).
+ * <p>Botan 1.10 has no GCM, so the mode is built here on top of the block cipher.
+ * The packet length field is authenticated as associated data and left in the clear, the rest of the
+ * packet is encrypted and authenticated in the same pass. The 64 bit invocation counter in the IV
+ * is advanced after every packet.
+ */
+class ne7ssh_gcm
+{
+private:
+    std::unique_ptr<Botan::BlockCipher> _cipher;
+    Botan::SecureVector<Botan::byte> _iv;
+    Botan::SecureVector<uint64> _hTable;
+    Botan::SecureVector<Botan::byte> _keyStream;
+
+    /**
+     * Multiplies the GHASH accumulator by H in GF(2^128), 4 bits at a time.
+     * @param x 16 byte accumulator, updated in place.
+     */
+    void gmult(Botan::byte* x) const;
+
+    /**
+     * Absorbs data into the GHASH accumulator. A partial last block is zero padded.
+     * @param x 16 byte accumulator.
+     * @param data Pointer to the data.
+     * @param len Length of the data.
+     */
+    void ghash(Botan::byte* x, const Botan::byte* data, uint32 len) const;
+
+    /**
+     * Sets up the counter block for the current packet.
+     * @param counter 16 byte buffer receiving the first counter block used for data.
+     * @param tagMask 16 byte buffer receiving the encrypted initial counter block, which masks the tag.
+     */
+    void startCounter(Botan::byte* counter, Botan::byte* tagMask);
+
+    /**
+     * XORs CTR keystream into the data. Counter blocks are generated in batches.
+     * @param counter 16 byte counter block, advanced past the processed blocks.
+     * @param data Pointer to the data.
+     * @param len Length of the data.
+     */
+    void ctr(Botan::byte* counter, Botan::byte* data, uint32 len);
+
+    /**
+     * Computes the GHASH of the associated data and ciphertext, finished with the length block.
+     * @param tag Result is written here.
+     * @param aad Pointer to the associated data.
+     * @param aadLen Length of the associated data.
+     * @param data Pointer to the ciphertext.
+     * @param len Length of the ciphertext.
+     */
+    void authenticate(Botan::byte* tag, const Botan::byte* aad, uint32 aadLen, const Botan::byte* data, uint32 len) const;
+
+    /**
+     * Advances the invocation counter in the IV.
+     */
+    void nextIv();
+
+public:
+    /**
+     * ne7ssh_gcm class constructor.
+     * @param cipher AES block cipher. The object takes ownership of it.
+     * @param key Cipher key.
+     * @param iv Initial 12 byte IV derived during the key exchange.
+     */
+    ne7ssh_gcm(Botan::BlockCipher* cipher, const Botan::SymmetricKey& key, const Botan::InitializationVector& iv);
+
+    /**
+     * Encrypts data in place, computes its tag and advances the invocation counter.
+     * <p>The general GCM operation with a 12 byte IV, seal() calls it with the packet length as associated data.
+     * @param aad Pointer to the associated data.
+     * @param aadLen Length of the associated data.
+     * @param data Pointer to the data.
+     * @param len Length of the data, any length.
+     * @param tag Buffer receiving NE7SSH_GCM_TAG_LEN bytes of the tag.
+     */
+    void encrypt(const Botan::byte* aad, uint32 aadLen, Botan::byte* data, uint32 len, Botan::byte* tag);
+
+    /**
+     * Verifies the tag of data and decrypts it in place, then advances the invocation counter.
+     * @param aad Pointer to the associated data.
+     * @param aadLen Length of the associated data.
+     * @param data Pointer to the data.
+     * @param len Length of the data, excluding the tag.
+     * @param tag Pointer to the received tag, NE7SSH_GCM_TAG_LEN bytes.
+     * @return True if the tag matched. False otherwise, in which case the data is left encrypted and the IV unchanged.
+     */
+    bool decrypt(const Botan::byte* aad, uint32 aadLen, Botan::byte* data, uint32 len, const Botan::byte* tag);
+
+    /**
+     * Encrypts a packet in place and computes its tag.
+     * @param packet Pointer to the whole packet. The first 4 bytes (packet length) are left as they are.
+     * @param len Length of the packet. Minus the length field it must be a multiple of the block size.
+     * @param tag Buffer receiving NE7SSH_GCM_TAG_LEN bytes of the tag.
+     * @return True on success. False if the packet is malformed.
+     */
+    bool seal(Botan::byte* packet, uint32 len, Botan::byte* tag);
+
+    /**
+     * Verifies the tag of a packet and decrypts it in place.
+     * @param packet Pointer to the whole packet. The first 4 bytes (packet length) are not encrypted.
+     * @param len Length of the packet, excluding the tag.
+     * @param tag Pointer to the received tag, NE7SSH_GCM_TAG_LEN bytes.
+     * @return True if the tag matched. False otherwise, in which case the packet is left encrypted.
+     */
+    bool open(Botan::byte* packet, uint32 len, const Botan::byte* tag);
+};
+
+#endif
@@ -17,7 +17,12 @@
 #include "ne7ssh_impl.h"
 #include "ne7ssh_connection.h"
 #include "ne7ssh_rng.h"
+#include "ne7ssh_algorithms.h"
 #include "ne7ssh_keys.h"
+#include "ne7ssh_kex_pool.h"
+#include "ne7ssh_key_cache.h"
+#include "ne7ssh_known_hosts.h"
+#include "ne7ssh_calibration.h"
 #include <botan/init.h>
 #if defined(WIN32) || defined(__MINGW32__)
 #   include <winsock.h>
@@ -29,6 +34,10 @@ using namespace std;
 const char* ne7ssh_impl::SSH_VERSION = "SSH-2.0-NetSieben_" NE7SSH_SHORT_VERSION;
 Ne7sshError* ne7ssh_impl::s_errs = NULL;
 std::unique_ptr<RandomNumberGenerator> ne7ssh_impl::s_rng;
+std::unique_ptr<ne7ssh_algorithms> ne7ssh_impl::s_algorithms;
+std::unique_ptr<ne7ssh_kex_pool> ne7ssh_impl::s_kexPool;
+std::unique_ptr<ne7ssh_key_cache> ne7ssh_impl::s_keyCache;
+std::unique_ptr<ne7ssh_known_hosts> ne7ssh_impl::s_knownHosts;
 
 #ifdef _DEMO_BUILD
 const char* ne7ssh_impl::MAC_ALGORITHMS = "none";
@@ -36,19 +45,27 @@ const char* ne7ssh_impl::CIPHER_ALGORITHMS = "3des-cbc";
 const char* ne7ssh_impl::KEX_ALGORITHMS = "diffie-hellman-group1-sha1";
 const char* ne7ssh_impl::HOSTKEY_ALGORITHMS = "ssh-dss";
 #else
-const char* ne7ssh_impl::MAC_ALGORITHMS = "hmac-md5,hmac-sha1,none";
-const char* ne7ssh_impl::CIPHER_ALGORITHMS = "aes256-cbc,aes192-cbc,twofish-cbc,twofish256-cbc,blowfish-cbc,3des-cbc,aes128-cbc,cast128-cbc";
-const char* ne7ssh_impl::KEX_ALGORITHMS = "diffie-hellman-group1-sha1,diffie-hellman-group14-sha1";
-const char* ne7ssh_impl::HOSTKEY_ALGORITHMS = "ssh-dss,ssh-rsa";
+const char* ne7ssh_impl::MAC_ALGORITHMS = "umac-64-etm@openssh.com,umac-128-etm@openssh.com,hmac-sha2-256-etm@openssh.com,hmac-sha2-512-etm@openssh.com,hmac-sha1-etm@openssh.com,umac-64@openssh.com,umac-128@openssh.com,hmac-sha2-256,hmac-sha2-512,hmac-md5,hmac-sha1,none";
+const char* ne7ssh_impl::CIPHER_ALGORITHMS = "chacha20-poly1305@openssh.com,aes256-gcm@openssh.com,aes128-gcm@openssh.com,aes256-ctr,aes192-ctr,aes128-ctr,aes256-cbc,aes192-cbc,twofish-cbc,twofish256-cbc,blowfish-cbc,3des-cbc,aes128-cbc,cast128-cbc";
+const char* ne7ssh_impl::KEX_ALGORITHMS = "curve25519-sha256,curve25519-sha256@libssh.org,ecdh-sha2-nistp256,ecdh-sha2-nistp384,ecdh-sha2-nistp521,diffie-hellman-group1-sha1,diffie-hellman-group14-sha1";
+const char* ne7ssh_impl::HOSTKEY_ALGORITHMS = "ssh-ed25519,ecdsa-sha2-nistp256,ecdsa-sha2-nistp384,ecdsa-sha2-nistp521,ssh-dss,ssh-rsa";
 #endif
 
 const char* ne7ssh_impl::COMPRESSION_ALGORITHMS = "none";
+int ne7ssh_impl::COMPRESSION_LEVEL = 0;
+uint64 ne7ssh_impl::REKEY_BYTES = NE7SSH_REKEY_BYTES;
+uint32 ne7ssh_impl::REKEY_PACKETS = NE7SSH_REKEY_PACKETS;
+uint32 ne7ssh_impl::REKEY_SECONDS = NE7SSH_REKEY_SECONDS;
 std::string ne7ssh_impl::PREFERED_CIPHER;
 std::string ne7ssh_impl::PREFERED_MAC;
+const char* ne7ssh_impl::s_defaultMacs = NULL;
+const char* ne7ssh_impl::s_defaultCiphers = NULL;
+std::string ne7ssh_impl::s_calibratedMacs;
+std::string ne7ssh_impl::s_calibratedCiphers;
 std::recursive_mutex ne7ssh_impl::s_mutex;
 volatile bool ne7ssh_impl::s_running = false;
 
-std::shared_ptr<ne7ssh_impl> ne7ssh_impl::create()
+std::shared_ptr<ne7ssh_impl> ne7ssh_impl::create(bool calibrate)
 {
     std::shared_ptr<ne7ssh_impl> ret(new ne7ssh_impl());
     ret->_selectThread = std::thread(&ne7ssh_impl::selectThread, ret);
@@ -56,6 +73,26 @@ std::shared_ptr<ne7ssh_impl> ne7ssh_impl::create()
     {
         s_rng.reset(new ne7ssh_rng());
     }
+    if (s_algorithms == NULL)
+    {
+        s_algorithms.reset(new ne7ssh_algorithms());
+    }
+    if (s_kexPool == NULL)
+    {
+        s_kexPool.reset(new ne7ssh_kex_pool());
+    }
+    if (s_keyCache == NULL)
+    {
+        s_keyCache.reset(new ne7ssh_key_cache());
+    }
+    if (s_knownHosts == NULL)
+    {
+        s_knownHosts.reset(new ne7ssh_known_hosts());
+    }
+    if (calibrate)
+    {
+        ne7ssh_impl::calibrate();
+    }
 
     return ret;
 }
@@ -77,9 +114,24 @@ void ne7ssh_impl::destroy()
     }
     _selectThread.join();
     _connections.clear();
+    // Pooled and cached keys hold Botan memory, they have to go before the library is shut down
+    s_kexPool.reset();
+    s_keyCache.reset();
+    s_knownHosts.reset();
+    // The prototypes are owned by Botan's algorithm factory, which the library shutdown destroys
+    s_algorithms.reset();
 
     ne7ssh_impl::PREFERED_CIPHER.clear();
     ne7ssh_impl::PREFERED_MAC.clear();
+    setCompression(0);
+    setRekeyLimits(NE7SSH_REKEY_BYTES, NE7SSH_REKEY_PACKETS, NE7SSH_REKEY_SECONDS);
+    if (s_defaultCiphers)
+    {
+        ne7ssh_impl::CIPHER_ALGORITHMS = s_defaultCiphers;
+        ne7ssh_impl::MAC_ALGORITHMS = s_defaultMacs;
+        s_calibratedCiphers.clear();
+        s_calibratedMacs.clear();
+    }
     if (s_errs)
     {
         delete (s_errs);
@@ -251,6 +303,38 @@ int ne7ssh_impl::connectWithPassword(const char* host, const short port, const c
 }
 
 int ne7ssh_impl::connectWithKey(const char* host, const short port, const char* username, const char* privKeyFileName, bool shell, const int timeout)
+{
+    std::shared_ptr<ne7ssh_keys> keyPair = s_keyCache->getKeyPair(privKeyFileName);
+
+    if (!keyPair)
+    {
+        return -1;
+    }
+    return connectWithKeyPair(host, port, username, keyPair, shell, timeout);
+}
+
+int ne7ssh_impl::connectWithKeyHandle(const char* host, const short port, const char* username, int keyHandle, bool shell, const int timeout)
+{
+    std::shared_ptr<ne7ssh_keys> keyPair = s_keyCache->getKeyPair(keyHandle);
+
+    if (!keyPair)
+    {
+        return -1;
+    }
+    return connectWithKeyPair(host, port, username, keyPair, shell, timeout);
+}
+
+int ne7ssh_impl::loadKeyPair(const char* privKey, uint32 length)
+{
+    return s_keyCache->addKeyPair(privKey, length);
+}
+
+bool ne7ssh_impl::unloadKeyPair(int keyHandle)
+{
+    return s_keyCache->removeKeyPair(keyHandle);
+}
+
+int ne7ssh_impl::connectWithKeyPair(const char* host, const short port, const char* username, std::shared_ptr<ne7ssh_keys> keyPair, bool shell, const int timeout)
 {
     int channel;
     uint32 currentRecord = 0, z;
@@ -270,7 +354,7 @@ int ne7ssh_impl::connectWithKey(const char* host, const short port, const char*
         return -1;
     }
 
-    channel = con->connectWithKey(channelID, host, port, username, privKeyFileName, shell, timeout);
+    channel = con->connectWithKey(channelID, host, port, username, keyPair, shell, timeout);
 
     if (channel == -1)
     {
@@ -558,7 +642,6 @@ bool ne7ssh_impl::waitFor(int channel, const char* str, uint32 timeSec)
 const char* ne7ssh_impl::read(int channel)
 {
     uint32 i;
-    SecureVector<Botan::byte> data;
 
     if (channel == -1)
     {
@@ -572,8 +655,7 @@ const char* ne7ssh_impl::read(int channel)
         {
             if (channel == _connections[i]->getChannelNo())
             {
-                data = _connections[i]->getReceived();
-                if (data.size())
+                if (_connections[i]->getReceived().size())
                 {
                     return ((const char*)_connections[i]->getReceived().begin());
                 }
@@ -658,6 +740,30 @@ uint32 ne7ssh_impl::getChannelNo()
     }
 }
 
+void ne7ssh_impl::calibrate()
+{
+    ne7ssh_calibration calibration;
+    std::string ciphers, macs;
+
+    if (s_defaultCiphers == NULL)
+    {
+        s_defaultCiphers = ne7ssh_impl::CIPHER_ALGORITHMS;
+        s_defaultMacs = ne7ssh_impl::MAC_ALGORITHMS;
+    }
+    ciphers = s_defaultCiphers;
+    macs = s_defaultMacs;
+    if (!calibration.run(ciphers, macs))
+    {
+        s_errs->push(-1, "Calibration failed, keeping the default algorithm order.");
+        return;
+    }
+
+    s_calibratedCiphers = ciphers;
+    s_calibratedMacs = macs;
+    ne7ssh_impl::CIPHER_ALGORITHMS = s_calibratedCiphers.c_str();
+    ne7ssh_impl::MAC_ALGORITHMS = s_calibratedMacs.c_str();
+}
+
 void ne7ssh_impl::setOptions(const char* prefCipher, const char* prefHmac)
 {
     if (prefCipher)
@@ -671,6 +777,36 @@ void ne7ssh_impl::setOptions(const char* prefCipher, const char* prefHmac)
     }
 }
 
+void ne7ssh_impl::setKnownHostsFile(const char* knownHostsFile)
+{
+    s_knownHosts->setFile(knownHostsFile);
+}
+
+void ne7ssh_impl::setCompression(int level)
+{
+    if (level > 9)
+    {
+        level = 9;
+    }
+    if (level > 0)
+    {
+        ne7ssh_impl::COMPRESSION_ALGORITHMS = "zlib@openssh.com,zlib,none";
+        ne7ssh_impl::COMPRESSION_LEVEL = level;
+    }
+    else
+    {
+        ne7ssh_impl::COMPRESSION_ALGORITHMS = "none";
+        ne7ssh_impl::COMPRESSION_LEVEL = 0;
+    }
+}
+
+void ne7ssh_impl::setRekeyLimits(uint64 bytes, uint32 packets, uint32 seconds)
+{
+    ne7ssh_impl::REKEY_BYTES = bytes;
+    ne7ssh_impl::REKEY_PACKETS = packets;
+    ne7ssh_impl::REKEY_SECONDS = seconds;
+}
+
 Ne7sshError* ne7ssh_impl::errors()
 {
     return s_errs;
@@ -679,14 +815,22 @@ Ne7sshError* ne7ssh_impl::errors()
 bool ne7ssh_impl::generateKeyPair(const char* type, const char* fqdn, const char* privKeyFileName, const char* pubKeyFileName, uint16 keySize)
 {
     ne7ssh_keys keyPair;
-    enum keyAlgos { UNKNOWN, DSA, RSA };
+    enum keyAlgos { UNKNOWN, DSA, RSA, ED25519, ECDSA };
     uint8 keyAlgo = UNKNOWN;
 
-    if (!memcmp(type, "dsa", 3))
+    if (!strncmp(type, "ed25519", 7))
+    {
+        keyAlgo = ED25519;
+    }
+    else if (!strncmp(type, "ecdsa", 5))
+    {
+        keyAlgo = ECDSA;
+    }
+    else if (!strncmp(type, "dsa", 3))
     {
         keyAlgo = DSA;
     }
-    else if (!memcmp(type, "rsa", 3))
+    else if (!strncmp(type, "rsa", 3))
     {
         keyAlgo = RSA;
     }
@@ -713,6 +857,19 @@ bool ne7ssh_impl::generateKeyPair(const char* type, const char* fqdn, const char
                 return keyPair.generateRSAKeys(fqdn, privKeyFileName, pubKeyFileName, keySize);
             }
 
+        case ED25519:
+            return keyPair.generateEd25519Keys(fqdn, privKeyFileName, pubKeyFileName);
+
+        case ECDSA:
+            if (!keySize)
+            {
+                return keyPair.generateECDSAKeys(fqdn, privKeyFileName, pubKeyFileName);
+            }
+            else
+            {
+                return keyPair.generateECDSAKeys(fqdn, privKeyFileName, pubKeyFileName, keySize);
+            }
+
         default:
             s_errs->push(-1, "The specfied key algorithm: %i not supported", keyAlgo);
     }
@@ -53,7 +53,17 @@
 #define SSH2_MSG_CHANNEL_SUCCESS                        99
 #define SSH2_MSG_CHANNEL_FAILURE                        100
 
+// Default re-keying limits, as recommended by RFC 4253 and RFC 4344
+#define NE7SSH_REKEY_BYTES      (1ULL << 30)
+#define NE7SSH_REKEY_PACKETS    (1U << 31)
+#define NE7SSH_REKEY_SECONDS    3600
+
 class ne7ssh_connection;
+class ne7ssh_algorithms;
+class ne7ssh_kex_pool;
+class ne7ssh_key_cache;
+class ne7ssh_keys;
+class ne7ssh_known_hosts;
 
 /** definitions for Botan */
 namespace Botan
@@ -91,6 +101,25 @@ private:
 
     static Ne7sshError* s_errs;
 
+    /**
+    * Opens a connection with publickey authentication, and registers it under a new channel.
+    * <p> For Internal use only
+    * @return Returns newly assigned channel ID, or -1 if connection failed.
+    */
+    int connectWithKeyPair(const char* host, const short port, const char* username, std::shared_ptr<ne7ssh_keys> keyPair, bool shell, const int timeout);
+
+    // Algorithm lists as compiled in, and the measured order that replaces them after calibrate()
+    static const char* s_defaultMacs;
+    static const char* s_defaultCiphers;
+    static std::string s_calibratedMacs;
+    static std::string s_calibratedCiphers;
+
+    /**
+    * Measures the supported ciphers and MACs, and reorders CIPHER_ALGORITHMS and MAC_ALGORITHMS fastest first.
+    * <p> For Internal use only
+    */
+    static void calibrate();
+
     /**
     * Default constructor. Used to allocate required memory, as well as initializing cryptographic routines.
     * Becuase this class is a singleton, you cannot copy it or assign it.
@@ -106,11 +135,19 @@ public:
     static const char* MAC_ALGORITHMS;
     static const char* CIPHER_ALGORITHMS;
     static const char* COMPRESSION_ALGORITHMS;
+    static int COMPRESSION_LEVEL;
+    static uint64 REKEY_BYTES;
+    static uint32 REKEY_PACKETS;
+    static uint32 REKEY_SECONDS;
     static std::string PREFERED_CIPHER;
     static std::string PREFERED_MAC;
     static std::unique_ptr<Botan::RandomNumberGenerator> s_rng;
+    static std::unique_ptr<ne7ssh_algorithms> s_algorithms;
+    static std::unique_ptr<ne7ssh_kex_pool> s_kexPool;
+    static std::unique_ptr<ne7ssh_key_cache> s_keyCache;
+    static std::unique_ptr<ne7ssh_known_hosts> s_knownHosts;
 
-    static std::shared_ptr<ne7ssh_impl> create();
+    static std::shared_ptr<ne7ssh_impl> create(bool calibrate = false);
     void destroy();
     /**
     * Destructor.
@@ -143,6 +180,33 @@ public:
     */
     int connectWithKey(const char* host, const short port, const char* username, const char* privKeyFileName, bool shell = true, const int timeout = 0);
 
+    /**
+    * Connect to remote host using SSH2 protocol, with publickey authentication, using a key loaded with loadKeyPair().
+    * @param host Hostname or IP to connect to.
+    * @param port Port to connect to.
+    * @param username Username to use in authentication.
+    * @param keyHandle Handle returned by loadKeyPair().
+    * @param shell Set this to true if you wish to launch the shell on the remote end. By default set to true.
+    * @param timeout Timeout for the connection procedure, in seconds.
+    * @return Returns newly assigned channel ID, or -1 if connection failed.
+    */
+    int connectWithKeyHandle(const char* host, const short port, const char* username, int keyHandle, bool shell = true, const int timeout = 0);
+
+    /**
+    * Parses a private key held in memory, and keeps it for connectWithKeyHandle().
+    * @param privKey PEM encoded or OpenSSH format private key, as it would appear in a key file. Need not be NULL terminated.
+    * @param length Length of the key.
+    * @return Returns the key handle, or -1 if the key could not be parsed.
+    */
+    int loadKeyPair(const char* privKey, uint32 length);
+
+    /**
+    * Forgets a key loaded with loadKeyPair(). Open connections are not affected.
+    * @param keyHandle Handle returned by loadKeyPair().
+    * @return Returns true if the handle was valid, otherwise false is returned.
+    */
+    bool unloadKeyPair(int keyHandle);
+
     /**
     * Retreives count of current connections
     * <p> For internal use only.
@@ -200,18 +264,38 @@ public:
     /**
     * Sets prefered cipher and hmac algorithms.
     * <p> This function as to be executed before connection functions, just after initialization of ne7ssh class.
-    * @param prefCipher prefered cipher algorithm string representation. Possible cipher algorithms are aes256-cbc, twofish-cbc, twofish256-cbc, blowfish-cbc, 3des-cbc, aes128-cbc, cast128-cbc.
-    * @param prefHmac preferede hmac algorithm string representation. Possible hmac algorithms are hmac-md5, hmac-sha1, none.
+    * @param prefCipher prefered cipher algorithm string representation. Possible cipher algorithms are chacha20-poly1305@openssh.com, aes256-gcm@openssh.com, aes128-gcm@openssh.com, aes256-ctr, aes192-ctr, aes128-ctr, aes256-cbc, twofish-cbc, twofish256-cbc, blowfish-cbc, 3des-cbc, aes128-cbc, cast128-cbc.
+    * @param prefHmac preferede hmac algorithm string representation. Possible hmac algorithms are umac-64-etm@openssh.com, umac-128-etm@openssh.com, hmac-sha2-256-etm@openssh.com, hmac-sha2-512-etm@openssh.com, hmac-sha1-etm@openssh.com, umac-64@openssh.com, umac-128@openssh.com, hmac-sha2-256, hmac-sha2-512, hmac-md5, hmac-sha1, none.
     */
     void setOptions(const char* prefCipher, const char* prefHmac);
 
+    /**
+    * Sets the known_hosts file host keys are checked against.
+    * @param knownHostsFile Full path to an OpenSSH known_hosts file, or 0 to stop checking.
+    */
+    void setKnownHostsFile(const char* knownHostsFile);
+
+    /**
+    * Enables zlib compression of the transport, or disables it.
+    * @param level Compression level from 1 to 9, or 0 to disable compression.
+    */
+    static void setCompression(int level);
+
+    /**
+    * Sets when connections re-run the key exchange.
+    * @param bytes Data sent and received, in bytes. 0 for no limit.
+    * @param packets Packets sent and received. 0 for no limit.
+    * @param seconds Time since the last key exchange. 0 for no limit.
+    */
+    static void setRekeyLimits(uint64 bytes, uint32 packets, uint32 seconds);
+
     /**
     * Generate key pair.
-    * @param type String specifying key type. Currently "dsa" and "rsa" are supported.
+    * @param type String specifying key type. Currently "dsa", "rsa", "ed25519" and "ecdsa" are supported.
     * @param fqdn User id. Usually an Email. For example "test@netsieben.com"
     * @param privKeyFileName Full path to a file where generated private key should be written.
     * @param pubKeyFileName Full path to a file where generated public key should be written.
-    * @param keySize Desired key size in bits. If not specified will default to 2048.
+    * @param keySize Desired key size in bits. If not specified will default to 2048, or 256 for "ecdsa" keys. Ignored for "ed25519" keys.
     * @return Return true if keys generated and written to the files. Otherwise false is returned.
     */
     bool generateKeyPair(const char* type, const char* fqdn, const char* privKeyFileName, const char* pubKeyFileName, uint16 keySize = 0);
@@ -15,13 +15,22 @@
  ***************************************************************************/
 
 #include "ne7ssh_kex.h"
+#include "ne7ssh_reader.h"
 #include "ne7ssh_impl.h"
+#include "ne7ssh_known_hosts.h"
 #include "ne7ssh.h"
 
 using namespace Botan;
 
 ne7ssh_kex::ne7ssh_kex(std::shared_ptr<ne7ssh_session> session)
-    : _session(session)
+    : _session(session),
+    _crypto(session->_crypto)
+{
+}
+
+ne7ssh_kex::ne7ssh_kex(std::shared_ptr<ne7ssh_session> session, std::shared_ptr<ne7ssh_crypt> crypto)
+    : _session(session),
+    _crypto(crypto)
 {
 }
 
@@ -127,37 +136,38 @@ void ne7ssh_kex::constructLocalKex()
 
 bool ne7ssh_kex::sendInit()
 {
-    std::shared_ptr<ne7ssh_transport> transport;
-
-    if (!_session->_transport)
+    if (!sendLocalInit())
     {
-        ne7ssh::errors()->push(_session->getSshChannel(), "No transport. Cannot initialize key exchange.");
         return false;
     }
-    transport = _session->_transport;
-
-    constructLocalKex();
-
-    if (!transport->sendPacket(_localKex.value()))
+    if (!_session->_transport->waitForPacket(SSH2_MSG_KEXINIT))
     {
+        ne7ssh::errors()->push(_session->getSshChannel(), "Timeout while waiting for key exchange init reply");
         return false;
     }
-    if (!transport->waitForPacket(SSH2_MSG_KEXINIT))
+
+    return true;
+}
+
+bool ne7ssh_kex::sendLocalInit()
+{
+    if (!_session->_transport)
     {
-        ne7ssh::errors()->push(_session->getSshChannel(), "Timeout while waiting for key exchange init reply");
+        ne7ssh::errors()->push(_session->getSshChannel(), "No transport. Cannot initialize key exchange.");
         return false;
     }
 
-    return true;
+    constructLocalKex();
+    return _session->_transport->sendPacket(_localKex.value());
 }
 
 bool ne7ssh_kex::handleInit()
 {
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    std::shared_ptr<ne7ssh_crypt> crypto = _session->_crypto;
+    std::shared_ptr<ne7ssh_crypt> crypto = _crypto;
     SecureVector<Botan::byte> packet;
     uint32 padLen = transport->getPacket(packet);
-    ne7ssh_string remoteKex(packet, 17);
+    ne7ssh_reader remoteKex(packet, 17);
     SecureVector<Botan::byte> algos;
     SecureVector<Botan::byte> agreed;
 
@@ -228,28 +238,36 @@ bool ne7ssh_kex::handleInit()
     {
         return false;
     }
-    if (!crypto->agree(agreed, (char*)_hmacs.begin(), algos))
-    {
-        ne7ssh::errors()->push(_session->getSshChannel(), "No compatible HMAC algorithms.");
-        return false;
-    }
-    if (!crypto->negotiatedMacC2s(agreed))
+    // AEAD ciphers carry their own tag, the MAC list is not used for that direction
+    if (!crypto->isAeadOut())
     {
-        return false;
+        if (!crypto->agree(agreed, (char*)_hmacs.begin(), algos))
+        {
+            ne7ssh::errors()->push(_session->getSshChannel(), "No compatible HMAC algorithms.");
+            return false;
+        }
+        if (!crypto->negotiatedMacC2s(agreed))
+        {
+            return false;
+        }
     }
 
     if (!remoteKex.getString(algos))
     {
         return false;
     }
-    if (!crypto->agree(agreed, (char*)_hmacs.begin(), algos))
-    {
-        ne7ssh::errors()->push(_session->getSshChannel(), "No compatible HMAC algorithms.");
-        return false;
-    }
-    if (!crypto->negotiatedMacS2c(agreed))
+    // AEAD ciphers carry their own tag, the MAC list is not used for that direction
+    if (!crypto->isAeadIn())
     {
-        return false;
+        if (!crypto->agree(agreed, (char*)_hmacs.begin(), algos))
+        {
+            ne7ssh::errors()->push(_session->getSshChannel(), "No compatible HMAC algorithms.");
+            return false;
+        }
+        if (!crypto->negotiatedMacS2c(agreed))
+        {
+            return false;
+        }
     }
 
     if (!remoteKex.getString(algos))
@@ -284,50 +302,52 @@ bool ne7ssh_kex::handleInit()
 }
 
 bool ne7ssh_kex::sendKexDHInit()
+{
+    if (!sendKexDHPublic())
+    {
+        return false;
+    }
+    if (!_session->_transport->waitForPacket(SSH2_MSG_KEXDH_REPLY))
+    {
+        ne7ssh::errors()->push(_session->getSshChannel(), "Timeout while waiting for key exchange dh reply.");
+        return false;
+    }
+    return true;
+}
+
+bool ne7ssh_kex::sendKexDHPublic()
 {
     ne7ssh_string dhInit;
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    std::shared_ptr<ne7ssh_crypt> crypto = _session->_crypto;
-    BigInt publicKey;
+    std::shared_ptr<ne7ssh_crypt> crypto = _crypto;
     SecureVector<Botan::byte> eVector;
 
-    if (!crypto->getKexPublic(publicKey))
+    if (!crypto->getKexPublic(eVector))
     {
         return false;
     }
 
+    // SSH2_MSG_KEX_ECDH_INIT has the same number and layout, e is a string either way (an mpint is one too)
     dhInit.addChar(SSH2_MSG_KEXDH_INIT);
-    dhInit.addBigInt(publicKey);
-    ne7ssh_string::bn2vector(eVector, publicKey);
+    dhInit.addVectorField(eVector);
     _e.clear();
     _e.addVector(eVector);
 
-    if (!transport->sendPacket(dhInit.value()))
-    {
-        return false;
-    }
-
-    if (!transport->waitForPacket(SSH2_MSG_KEXDH_REPLY))
-    {
-        ne7ssh::errors()->push(_session->getSshChannel(), "Timeout while waiting for key exchange dh reply.");
-        return false;
-    }
-    return true;
+    return transport->sendPacket(dhInit.value());
 }
 
 bool ne7ssh_kex::handleKexDHReply()
 {
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    std::shared_ptr<ne7ssh_crypt> crypto = _session->_crypto;
+    std::shared_ptr<ne7ssh_crypt> crypto = _crypto;
     SecureVector<Botan::byte> packet;
     transport->getPacket(packet);
     if (packet.empty() == true)
     {
         return false;
     }
-    ne7ssh_string remoteKexDH(packet, 1);
+    ne7ssh_reader remoteKexDH(packet, 1);
     SecureVector<Botan::byte> field, fVector, hSig, kVector, hVector;
-    BigInt publicKey;
 
     if (!remoteKexDH.getString(field))
     {
@@ -336,11 +356,10 @@ bool ne7ssh_kex::handleKexDHReply()
     _hostKey.clear();
     _hostKey.addVector(field);
 
-    if (!remoteKexDH.getBigInt(publicKey))
+    if (!remoteKexDH.getString(fVector))
     {
         return false;
     }
-    ne7ssh_string::bn2vector(fVector, publicKey);
     _f.clear();
     _f.addVector(fVector);
 
@@ -349,7 +368,7 @@ bool ne7ssh_kex::handleKexDHReply()
         return false;
     }
 
-    if (!crypto->makeKexSecret(kVector, publicKey))
+    if (!crypto->makeKexSecret(kVector, fVector))
     {
         return false;
     }
@@ -361,7 +380,8 @@ bool ne7ssh_kex::handleKexDHReply()
     {
         return false;
     }
-    if (!crypto->isInited())
+    // The session ID is the H of the first exchange, re-keying keeps it
+    if (_session->getSessionID().empty())
     {
         _session->setSessionID(hVector);
     }
@@ -371,13 +391,32 @@ bool ne7ssh_kex::handleKexDHReply()
         return false;
     }
 
+    switch (ne7ssh_impl::s_knownHosts->check(_session->getRemoteHost(), _session->getRemotePort(), _hostKey.value()))
+    {
+        case ne7ssh_known_hosts::DISABLED:
+        case ne7ssh_known_hosts::KNOWN:
+            break;
+
+        case ne7ssh_known_hosts::UNKNOWN:
+            ne7ssh::errors()->push(_session->getSshChannel(), "Host key of '%s' is not in the known hosts file.", _session->getRemoteHost().c_str());
+            return false;
+
+        case ne7ssh_known_hosts::CHANGED:
+            ne7ssh::errors()->push(_session->getSshChannel(), "Host key of '%s' does not match the known hosts file. Someone could be eavesdropping.", _session->getRemoteHost().c_str());
+            return false;
+
+        default:
+            ne7ssh::errors()->push(_session->getSshChannel(), "Host key of '%s' is revoked.", _session->getRemoteHost().c_str());
+            return false;
+    }
+
     return true;
 }
 
 bool ne7ssh_kex::sendKexNewKeys()
 {
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    std::shared_ptr<ne7ssh_crypt> crypto = _session->_crypto;
+    std::shared_ptr<ne7ssh_crypt> crypto = _crypto;
     ne7ssh_string newKeys;
 
     if (!transport->waitForPacket(SSH2_MSG_NEWKEYS))
@@ -403,7 +442,7 @@ bool ne7ssh_kex::sendKexNewKeys()
 
 void ne7ssh_kex::makeH(Botan::SecureVector<Botan::byte> &hVector)
 {
-    std::shared_ptr<ne7ssh_crypt> crypto = _session->_crypto;
+    std::shared_ptr<ne7ssh_crypt> crypto = _crypto;
     ne7ssh_string hashBytes;
 
     hashBytes.addVectorField(_session->getLocalVersion());
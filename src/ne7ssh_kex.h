@@ -27,6 +27,7 @@ class ne7ssh_kex
 {
 private:
     std::shared_ptr<ne7ssh_session> _session;
+    std::shared_ptr<ne7ssh_crypt> _crypto;
     ne7ssh_string _localKex;
     ne7ssh_string _remotKex;
     ne7ssh_string _hostKey;
@@ -54,6 +55,14 @@ public:
      */
     ne7ssh_kex(std::shared_ptr<ne7ssh_session> session);
 
+    /**
+     * ne7ssh_kex class constructor, for re-keying.
+     * <p> Algorithms are negotiated and keys made in crypto, while packets keep going through the session's current keys.
+     * @param _session Pointer to ne7ssh_session variable.
+     * @param crypto Crypto object that receives the new keys.
+     */
+    ne7ssh_kex(std::shared_ptr<ne7ssh_session> session, std::shared_ptr<ne7ssh_crypt> crypto);
+
     /**
      * ne7ssh_kex class destructor.
      */
@@ -65,6 +74,12 @@ public:
      */
     bool sendInit();
 
+    /**
+     * Sends the 'KEX_INIT' packet, without waiting for the reply.
+     * @return True if successful, otherwise false is returned.
+     */
+    bool sendLocalInit();
+
     /**
      * After sendInit() function returnes true, this functions is used to parse the received 'KEX_INIT' packet.
      * <p> Used to agree on cipher, hmac, etc. algorithms used in communication between client and server.
@@ -78,6 +93,12 @@ public:
      */
     bool sendKexDHInit();
 
+    /**
+     * Sends the 'KEXDH_INIT' packet, without waiting for the reply.
+     * @return True if successful, otherwise false is returned.
+     */
+    bool sendKexDHPublic();
+
     /**
      * After sendKexDHInit() returns true, this function is used to handle the received 'KEXDH_REPLY'.
      * <p> This is the function to create the shared secret K. It also extracts the host key and signature fields from the payload, generates DSA/RSA keys, and verifies the signature.
@@ -0,0 +1,190 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+
+#include "ne7ssh_kex_pool.h"
+#include "ne7ssh_x25519.h"
+#include "ne7ssh_impl.h"
+#include "ne7ssh.h"
+
+using namespace Botan;
+
+ne7ssh_kex_pool::ne7ssh_kex_pool()
+    : _running(true)
+{
+    uint32 i;
+
+    for (i = 0; i < KEY_TYPES; i++)
+    {
+        _wanted[i] = false;
+    }
+    // First choice in KEX_ALGORITHMS, and cheap to keep ready
+    _wanted[X25519] = true;
+    _fillThread = std::thread(&ne7ssh_kex_pool::fill, this);
+}
+
+ne7ssh_kex_pool::~ne7ssh_kex_pool()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _cond.notify_all();
+    _fillThread.join();
+}
+
+void ne7ssh_kex_pool::fill()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::unique_ptr<kexKey> key;
+    uint32 type, i;
+
+    while (_running)
+    {
+        // The used type with the fewest ready keys goes first
+        type = KEY_TYPES;
+        for (i = 0; i < KEY_TYPES; i++)
+        {
+            if (_wanted[i] && _keys[i].size() < NE7SSH_KEX_POOL_SIZE && (type == KEY_TYPES || _keys[i].size() < _keys[type].size()))
+            {
+                type = i;
+            }
+        }
+        if (type == KEY_TYPES)
+        {
+            _cond.wait(lock);
+            continue;
+        }
+
+        lock.unlock();
+        try
+        {
+            key = generate(type);
+        }
+        catch (const std::exception &ex)
+        {
+            ne7ssh::errors()->push(-1, "Failure to pre-generate key exchange key: %s.", ex.what());
+            key.reset();
+        }
+        lock.lock();
+
+        if (key)
+        {
+            _keys[type].push_back(std::move(key));
+        }
+        else
+        {
+            // Do not spin on a type that cannot be generated, take() still generates inline
+            _wanted[type] = false;
+        }
+    }
+}
+
+std::unique_ptr<ne7ssh_kex_pool::kexKey> ne7ssh_kex_pool::generate(uint32 type)
+{
+    std::unique_ptr<kexKey> key(new kexKey());
+
+    switch (type)
+    {
+        case DH_GROUP1:
+            key->dh.reset(new DH_PrivateKey(*ne7ssh_impl::s_rng, DL_Group("modp/ietf/1024")));
+            break;
+
+        case DH_GROUP14:
+            key->dh.reset(new DH_PrivateKey(*ne7ssh_impl::s_rng, DL_Group("modp/ietf/2048")));
+            break;
+
+        case X25519:
+            key->x25519.resize(2 * NE7SSH_X25519_LEN);
+            ne7ssh_impl::s_rng->randomize(key->x25519.begin(), NE7SSH_X25519_LEN);
+            ne7ssh_x25519::scalarMultBase(key->x25519.begin() + NE7SSH_X25519_LEN, key->x25519.begin());
+            break;
+
+        case ECDH_NISTP256:
+            key->ecdh.reset(new ECDH_PrivateKey(*ne7ssh_impl::s_rng, EC_Group("secp256r1")));
+            break;
+
+        case ECDH_NISTP384:
+            key->ecdh.reset(new ECDH_PrivateKey(*ne7ssh_impl::s_rng, EC_Group("secp384r1")));
+            break;
+
+        case ECDH_NISTP521:
+            key->ecdh.reset(new ECDH_PrivateKey(*ne7ssh_impl::s_rng, EC_Group("secp521r1")));
+            break;
+
+        default:
+            key.reset();
+            break;
+    }
+    return key;
+}
+
+std::unique_ptr<ne7ssh_kex_pool::kexKey> ne7ssh_kex_pool::take(uint32 type)
+{
+    std::unique_ptr<kexKey> key;
+
+    if (type >= KEY_TYPES)
+    {
+        return key;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wanted[type] = true;
+        if (!_keys[type].empty())
+        {
+            key = std::move(_keys[type].front());
+            _keys[type].pop_front();
+        }
+    }
+    _cond.notify_one();
+
+    if (!key)
+    {
+        key = generate(type);
+    }
+    return key;
+}
+
+std::unique_ptr<DH_PrivateKey> ne7ssh_kex_pool::takeDH(uint32 type)
+{
+    std::unique_ptr<kexKey> key = take(type);
+
+    if (!key)
+    {
+        return std::unique_ptr<DH_PrivateKey>();
+    }
+    return std::move(key->dh);
+}
+
+std::unique_ptr<ECDH_PrivateKey> ne7ssh_kex_pool::takeECDH(uint32 type)
+{
+    std::unique_ptr<kexKey> key = take(type);
+
+    if (!key)
+    {
+        return std::unique_ptr<ECDH_PrivateKey>();
+    }
+    return std::move(key->ecdh);
+}
+
+void ne7ssh_kex_pool::takeX25519(Botan::SecureVector<Botan::byte>& privateKey, Botan::SecureVector<Botan::byte>& publicKey)
+{
+    std::unique_ptr<kexKey> key = take(X25519);
+
+    privateKey = SecureVector<Botan::byte>(key->x25519.begin(), NE7SSH_X25519_LEN);
+    publicKey = SecureVector<Botan::byte>(key->x25519.begin() + NE7SSH_X25519_LEN, NE7SSH_X25519_LEN);
+}
@@ -0,0 +1,115 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+
+#ifndef NE7SSH_KEX_POOL_H
+#define NE7SSH_KEX_POOL_H
+
+#include "ne7ssh_types.h"
+#include <botan/dh.h>
+#include <botan/ecdh.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#define NE7SSH_KEX_POOL_SIZE 4
+
+/**
+ * Pool of pre-generated ephemeral key exchange key pairs.
+ * <p>A background thread keeps up to NE7SSH_KEX_POOL_SIZE key pairs ready for each exchange type that has been used,
+ * so sending KEXDH_INIT does not have to wait for key generation. Every key is handed out once and then belongs to the caller.
+ * When the pool of a type is empty the key is generated in the calling thread, as it was before the pool existed.
+ */
+class ne7ssh_kex_pool
+{
+public:
+    enum keyTypes { DH_GROUP1, DH_GROUP14, X25519, ECDH_NISTP256, ECDH_NISTP384, ECDH_NISTP521, KEY_TYPES };
+
+private:
+    // One key pair, only the member matching its type is set
+    struct kexKey
+    {
+        std::unique_ptr<Botan::DH_PrivateKey> dh;
+        std::unique_ptr<Botan::ECDH_PrivateKey> ecdh;
+        // Private scalar followed by the public value
+        Botan::SecureVector<Botan::byte> x25519;
+    };
+
+    std::deque<std::unique_ptr<kexKey> > _keys[KEY_TYPES];
+    bool _wanted[KEY_TYPES];
+    bool _running;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::thread _fillThread;
+
+    ne7ssh_kex_pool(const ne7ssh_kex_pool&);
+    ne7ssh_kex_pool& operator=(const ne7ssh_kex_pool&);
+
+    /**
+     * Background thread, generates keys whenever a used type is below NE7SSH_KEX_POOL_SIZE.
+     */
+    void fill();
+
+    /**
+     * Generates a key pair.
+     * @param type One of keyTypes.
+     * @return The new key pair.
+     */
+    static std::unique_ptr<kexKey> generate(uint32 type);
+
+    /**
+     * Takes a key pair out of the pool, or generates one if none is ready. Marks the type as used.
+     * @param type One of keyTypes.
+     * @return The key pair.
+     */
+    std::unique_ptr<kexKey> take(uint32 type);
+
+public:
+    /**
+     * ne7ssh_kex_pool class constructor. Starts the background thread.
+     */
+    ne7ssh_kex_pool();
+
+    /**
+     * ne7ssh_kex_pool class destructor. Stops the background thread and wipes unused keys.
+     */
+    ~ne7ssh_kex_pool();
+
+    /**
+     * Takes a Diffie Hellman key pair.
+     * @param type DH_GROUP1 or DH_GROUP14.
+     * @return The key pair.
+     */
+    std::unique_ptr<Botan::DH_PrivateKey> takeDH(uint32 type);
+
+    /**
+     * Takes an ECDH key pair.
+     * @param type ECDH_NISTP256, ECDH_NISTP384 or ECDH_NISTP521.
+     * @return The key pair.
+     */
+    std::unique_ptr<Botan::ECDH_PrivateKey> takeECDH(uint32 type);
+
+    /**
+     * Takes an X25519 key pair.
+     * @param privateKey Receives the NE7SSH_X25519_LEN byte private scalar.
+     * @param publicKey Receives the NE7SSH_X25519_LEN byte public value.
+     */
+    void takeX25519(Botan::SecureVector<Botan::byte>& privateKey, Botan::SecureVector<Botan::byte>& publicKey);
+};
+
+#endif
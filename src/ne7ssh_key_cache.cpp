@@ -0,0 +1,113 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_key_cache.h"
+#include "ne7ssh_keys.h"
+#include "ne7ssh.h"
+
+ne7ssh_key_cache::ne7ssh_key_cache()
+    : _nextHandle(0)
+{
+}
+
+ne7ssh_key_cache::~ne7ssh_key_cache()
+{
+}
+
+std::shared_ptr<ne7ssh_keys> ne7ssh_key_cache::getKeyPair(const char* privKeyFileName)
+{
+    std::shared_ptr<ne7ssh_keys> keys;
+    std::map<std::string, entry>::iterator it;
+    struct stat status;
+    entry fresh;
+
+    if (stat(privKeyFileName, &status) < 0)
+    {
+        ne7ssh::errors()->push(-1, "Cannot read file status: '%s'.", privKeyFileName);
+        return keys;
+    }
+
+    // Held while parsing, so a burst of connections with a new key reads the file once
+    std::unique_lock<std::mutex> lock(_mutex);
+    it = _entries.find(privKeyFileName);
+    if ((it != _entries.end()) && (it->second.device == status.st_dev) && (it->second.inode == status.st_ino) &&
+        (it->second.size == status.st_size) && (it->second.modified == status.st_mtime) && (it->second.changed == status.st_ctime))
+    {
+        return it->second.keys;
+    }
+
+    keys.reset(new ne7ssh_keys());
+    if (!keys->getKeyPairFromFile(privKeyFileName))
+    {
+        if (it != _entries.end())
+        {
+            _entries.erase(it);
+        }
+        return std::shared_ptr<ne7ssh_keys>();
+    }
+
+    fresh.device = status.st_dev;
+    fresh.inode = status.st_ino;
+    fresh.size = status.st_size;
+    fresh.modified = status.st_mtime;
+    fresh.changed = status.st_ctime;
+    fresh.keys = keys;
+    _entries[privKeyFileName] = fresh;
+    return keys;
+}
+
+int ne7ssh_key_cache::addKeyPair(const char* privKey, uint32 length)
+{
+    std::shared_ptr<ne7ssh_keys> keys(new ne7ssh_keys());
+    int keyHandle;
+
+    if (!keys->getKeyPairFromMemory(privKey, length))
+    {
+        return -1;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    keyHandle = _nextHandle++;
+    _handles[keyHandle] = keys;
+    return keyHandle;
+}
+
+std::shared_ptr<ne7ssh_keys> ne7ssh_key_cache::getKeyPair(int keyHandle)
+{
+    std::map<int, std::shared_ptr<ne7ssh_keys> >::iterator it;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    it = _handles.find(keyHandle);
+    if (it == _handles.end())
+    {
+        ne7ssh::errors()->push(-1, "Unknown key handle: %i.", keyHandle);
+        return std::shared_ptr<ne7ssh_keys>();
+    }
+    return it->second;
+}
+
+bool ne7ssh_key_cache::removeKeyPair(int keyHandle)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _handles.erase(keyHandle) > 0;
+}
+
+void ne7ssh_key_cache::clear()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _entries.clear();
+    _handles.clear();
+}
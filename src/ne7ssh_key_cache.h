@@ -0,0 +1,105 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_KEY_CACHE_H
+#define NE7SSH_KEY_CACHE_H
+
+#include "ne7ssh_types.h"
+#include <sys/stat.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class ne7ssh_keys;
+
+/**
+ * Private keys shared by all connections.
+ * <p>Keys read by ne7ssh::connectWithKey() are cached by file name. A key file is read and parsed once, and later connections
+ * get the same ne7ssh_keys object for as long as the file keeps its device, inode, size, modification and change time.
+ * A replaced, edited or chmod-ed file is read again.
+ * <p>Keys loaded from memory with ne7ssh::loadKeyPair() are kept under a handle until ne7ssh::unloadKeyPair().
+ */
+class ne7ssh_key_cache
+{
+private:
+    struct entry
+    {
+        dev_t device;
+        ino_t inode;
+        off_t size;
+        time_t modified;
+        time_t changed;
+        std::shared_ptr<ne7ssh_keys> keys;
+    };
+
+    std::map<std::string, entry> _entries;
+    std::map<int, std::shared_ptr<ne7ssh_keys> > _handles;
+    int _nextHandle;
+    std::mutex _mutex;
+
+    ne7ssh_key_cache(const ne7ssh_key_cache&);
+    ne7ssh_key_cache& operator=(const ne7ssh_key_cache&);
+
+public:
+    /**
+     * ne7ssh_key_cache class constructor.
+     */
+    ne7ssh_key_cache();
+
+    /**
+     * ne7ssh_key_cache class destructor.
+     */
+    ~ne7ssh_key_cache();
+
+    /**
+     * Returns the key pair stored in a file, reading the file only if it is not cached or has changed.
+     * <p>The returned object is shared and must only be used to sign and to get the public key.
+     * @param privKeyFileName Full path to the private key file.
+     * @return The key pair, or an empty pointer if the file could not be read or parsed.
+     */
+    std::shared_ptr<ne7ssh_keys> getKeyPair(const char* privKeyFileName);
+
+    /**
+     * Parses a key held in memory and keeps it under a new handle.
+     * @param privKey PEM encoded or OpenSSH format key. Need not be NULL terminated.
+     * @param length Length of the key.
+     * @return The handle, or -1 if the key could not be parsed.
+     */
+    int addKeyPair(const char* privKey, uint32 length);
+
+    /**
+     * Returns the key pair kept under a handle.
+     * <p>The returned object is shared and must only be used to sign and to get the public key.
+     * @param keyHandle Handle returned by addKeyPair().
+     * @return The key pair, or an empty pointer if there is no such handle.
+     */
+    std::shared_ptr<ne7ssh_keys> getKeyPair(int keyHandle);
+
+    /**
+     * Forgets the key pair kept under a handle. Connections already using it keep it until they close.
+     * @param keyHandle Handle returned by addKeyPair().
+     * @return True if the handle existed, otherwise false is returned.
+     */
+    bool removeKeyPair(int keyHandle);
+
+    /**
+     * Drops all cached keys and handles.
+     */
+    void clear();
+};
+
+#endif
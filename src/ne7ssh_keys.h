@@ -21,6 +21,7 @@
 #include "ne7ssh_string.h"
 #include <botan/dsa.h>
 #include <botan/rsa.h>
+#include <botan/ecdsa.h>
 #include <memory>
 
 /**
@@ -31,14 +32,20 @@ class ne7ssh_keys
 private:
     std::shared_ptr<Botan::DSA_PrivateKey> _dsaPrivateKey;
     std::shared_ptr<Botan::RSA_PrivateKey> _rsaPrivateKey;
+    std::shared_ptr<Botan::ECDSA_PrivateKey> _ecdsaPrivateKey;
+    Botan::SecureVector<Botan::byte> _ed25519Key;
     ne7ssh_string _publicKeyBlob;
-    Botan::SecureVector<Botan::byte> _signature;
     const static std::string s_headerDSA;
     const static std::string s_footerDSA;
     const static std::string s_headerRSA;
     const static std::string s_footerRSA;
+    const static std::string s_headerEC;
+    const static std::string s_footerEC;
+    const static std::string s_headerOpenSSH;
+    const static std::string s_footerOpenSSH;
 
     uint8 keyAlgo;
+    uint8 _ecdsaCurve;
 
     /**
      * Extracts DSA key pair from a PEM encoded stream.
@@ -56,8 +63,59 @@ private:
      */
     bool getRSAKeys(char* buffer, uint32 size);
 
+    /**
+     * Extracts ECDSA key pair from a PEM encoded SEC1 stream, as written by OpenSSL and ssh-keygen -m PEM.
+     * @param buffer PEM encoded string.
+     * @param size Length of the stream.
+     * @return True if keys succesfully extracted. Otherwise False is returned.
+     */
+    bool getECKeys(char* buffer, uint32 size);
+
+    /**
+     * Extracts an Ed25519 or ECDSA key pair from an unencrypted OpenSSH format stream, as written by ssh-keygen.
+     * @param buffer Base64 encoded string, including the header and footer lines.
+     * @param size Length of the stream.
+     * @return True if keys succesfully extracted. Otherwise False is returned.
+     */
+    bool getOpenSSHKeys(char* buffer, uint32 size);
+
+    /**
+     * Creates the ECDSA private key and its public key blob.
+     * @param curve Index of the curve in the supported curve table.
+     * @param x Private value.
+     * @return True if the key was created. Otherwise False is returned.
+     */
+    bool setECDSAKey(uint8 curve, const Botan::BigInt& x);
+
+    /**
+     * Determines the type of key, then passes processing to getDSAKeys(), getRSAKeys(), getECKeys() or getOpenSSHKeys().
+     * @param privKey PEM encoded or OpenSSH format key.
+     * @param length Length of the key.
+     * @param source File name or other description of where the key came from, for error messages.
+     * @return True if key succesfully extracted, otherwise False is returned.
+     */
+    bool parseKeyPair(const char* privKey, uint32 length, const char* source);
+
+    /**
+     * Writes an OpenSSH style public key file: key type, base64 encoded key blob and user id on a single line.
+     * @param keyType SSH name of the key algorithm, ssh-rsa for example.
+     * @param pubKeyBlob Public key blob.
+     * @param fqdn User id.
+     * @param pubKeyFileName Full path to the file.
+     * @return True if the file was written. Otherwise false is returned.
+     */
+    bool writePublicKeyFile(const char* keyType, ne7ssh_string& pubKeyBlob, const char* fqdn, const char* pubKeyFileName);
+
+    /**
+     * Writes an encoded private key to a file.
+     * @param privKeyEncoded Encoded private key.
+     * @param privKeyFileName Full path to the file.
+     * @return True if the file was written. Otherwise false is returned.
+     */
+    bool writePrivateKeyFile(const std::string& privKeyEncoded, const char* privKeyFileName);
+
 public:
-    enum keyAlgos { DSA, RSA };
+    enum keyAlgos { DSA, RSA, ED25519, ECDSA };
 
     /**
      * ne7ssh_keys constructor.
@@ -91,21 +149,50 @@ public:
     bool generateRSAKeys(const char* fqdn, const char* privKeyFileName, const char* pubKeyFileName, uint16 keySize = 2048);
 
     /**
-     * Extracts key pair from a PEM encoded file.
-     * <p>Reads the file and determines the type of key, then passes processing to either getDsaKeys() or getRSAKeys(*) functions.
+     * Generates Ed25519 Key pair and saves keys in specified files.
+     * <p>The private key is written in the OpenSSH format, unencrypted, as ssh-keygen does for this key type.
+     * @param fqdn User id. Usually an Email. For example "test@netsieben.com"
+     * @param privKeyFileName Full path to a file where generated private key should be written.
+     * @param pubKeyFileName Full path to a file where generated public key should be written.
+     * @return True if keys generated and written to the files. Otherwise false is returned.
+     */
+    bool generateEd25519Keys(const char* fqdn, const char* privKeyFileName, const char* pubKeyFileName);
+
+    /**
+     * Generates ECDSA Key pair and saves keys in specified files.
+     * @param fqdn User id. Usually an Email. For example "test@netsieben.com"
+     * @param privKeyFileName Full path to a file where generated private key should be written.
+     * @param pubKeyFileName Full path to a file where generated public key should be written.
+     * @param keySize Size of the NIST curve in bits, 256, 384 or 521. If not specified will default to 256.
+     * @return True if keys generated and written to the files. Otherwise false is returned.
+     */
+    bool generateECDSAKeys(const char* fqdn, const char* privKeyFileName, const char* pubKeyFileName, uint16 keySize = 256);
+
+    /**
+     * Extracts key pair from a PEM encoded or OpenSSH format file.
+     * <p>Checks the file permissions, reads the file and passes it to parseKeyPair().
      * @param privKeyFileName Full path to PEM encoded file.
      * @return True if key succesfully extracted, otherwise False is returned.
      */
     bool getKeyPairFromFile(const char* privKeyFileName);
 
     /**
-     * Generates a SHA-1 signature from sessionID and packet data provided.
-     * <p>Determines key type and passed the processing either to generateDSASignature() or generateRSAKeys() functions.
+     * Extracts key pair from a PEM encoded or OpenSSH format key held in memory.
+     * @param privKey The key, in the same format as the file getKeyPairFromFile() reads. Need not be NULL terminated.
+     * @param length Length of the key.
+     * @return True if key succesfully extracted, otherwise False is returned.
+     */
+    bool getKeyPairFromMemory(const char* privKey, uint32 length);
+
+    /**
+     * Generates a signature from sessionID and packet data provided.
+     * <p>Determines key type and passes the processing to generateDSASignature(), generateRSASignature(), generateEd25519Signature() or generateECDSASignature().
+     * Does not change the object, so a key pair from ne7ssh_key_cache can sign for several connections at once.
      * @param sessionID SSH2 SessionID.
      * @param signingData Packet data to sign.
      * @return Returns signature, or 0 length vector if operation failed.
      */
-    Botan::SecureVector<Botan::byte>& generateSignature(Botan::SecureVector<Botan::byte>& sessionID, Botan::SecureVector<Botan::byte>& signingData);
+    Botan::SecureVector<Botan::byte> generateSignature(Botan::SecureVector<Botan::byte>& sessionID, Botan::SecureVector<Botan::byte>& signingData);
 
     /**
      * Generates a SHA-1 signature from sessionID and packet data provided, using DSA private key initialized before.
@@ -123,6 +210,23 @@ public:
      */
     Botan::SecureVector<Botan::byte> generateRSASignature(Botan::SecureVector<Botan::byte>& sessionID, Botan::SecureVector<Botan::byte>& signingData);
 
+    /**
+     * Generates an Ed25519 signature from sessionID and packet data provided, using Ed25519 private key initialized before.
+     * @param sessionID SSH2 SessionID.
+     * @param signingData Packet data to sign.
+     * @return Returns signature, or 0 length vector if operation failed.
+     */
+    Botan::SecureVector<Botan::byte> generateEd25519Signature(Botan::SecureVector<Botan::byte>& sessionID, Botan::SecureVector<Botan::byte>& signingData);
+
+    /**
+     * Generates an ECDSA signature from sessionID and packet data provided, using ECDSA private key initialized before.
+     * <p>The hash is SHA-256, SHA-384 or SHA-512 depending on the curve.
+     * @param sessionID SSH2 SessionID.
+     * @param signingData Packet data to sign.
+     * @return Returns signature, or 0 length vector if operation failed.
+     */
+    Botan::SecureVector<Botan::byte> generateECDSASignature(Botan::SecureVector<Botan::byte>& sessionID, Botan::SecureVector<Botan::byte>& signingData);
+
     /**
      * After key pair has been initialized, this function returns public key blob, as specified by SSH2 specs.
      * @return Public key blob or zero length vector, if there are initialized keys.
@@ -137,6 +241,12 @@ public:
     {
         return keyAlgo;
     }
+
+    /**
+     * Returns SSH name of the initialized keys' algorithm, as sent in public key authentication.
+     * @return A string such as "ssh-rsa" or "ecdsa-sha2-nistp256", or 0 if no keys are initialized.
+     */
+    const char* getKeyAlgoName();
 };
 
 #endif
@@ -0,0 +1,384 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_known_hosts.h"
+#include "ne7ssh_reader.h"
+#include "ne7ssh.h"
+#include <botan/libstate.h>
+#include <botan/hmac.h>
+#include <botan/base64.h>
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+using namespace Botan;
+
+namespace
+{
+const std::string HASH_MAGIC = "|1|";
+
+std::string toLower(const std::string& str)
+{
+    std::string result(str);
+
+    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+    return result;
+}
+
+// Host name in the form known_hosts uses for it
+std::string hostName(const std::string& host, short port)
+{
+    std::ostringstream name;
+
+    if ((unsigned short)port == 22)
+    {
+        return toLower(host);
+    }
+    name << '[' << toLower(host) << "]:" << (unsigned short)port;
+    return name.str();
+}
+
+std::string decodeBase64(const std::string& str)
+{
+    SecureVector<Botan::byte> raw;
+
+    try
+    {
+        raw = base64_decode(str, false);
+    }
+    catch (const std::exception&)
+    {
+        return std::string();
+    }
+    return std::string((const char*)raw.begin(), raw.size());
+}
+}
+
+ne7ssh_known_hosts::ne7ssh_known_hosts()
+{
+}
+
+ne7ssh_known_hosts::~ne7ssh_known_hosts()
+{
+}
+
+void ne7ssh_known_hosts::setFile(const char* fileName)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _fileName.assign(fileName ? fileName : "");
+    _index.reset();
+}
+
+std::shared_ptr<ne7ssh_known_hosts::hostIndex> ne7ssh_known_hosts::current(bool& enabled)
+{
+    std::shared_ptr<hostIndex> index;
+    struct stat status;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    enabled = !_fileName.empty();
+    if (!enabled)
+    {
+        return index;
+    }
+    if (stat(_fileName.c_str(), &status) < 0)
+    {
+        ne7ssh::errors()->push(-1, "Cannot read file status: '%s'.", _fileName.c_str());
+        return index;
+    }
+    if (_index && (_index->device == status.st_dev) && (_index->inode == status.st_ino) && (_index->size == status.st_size) &&
+        (_index->modified == status.st_mtime) && (_index->changed == status.st_ctime))
+    {
+        return _index;
+    }
+
+    // Lookups still holding the old index keep using it until they are done
+    index.reset(new hostIndex());
+    index->device = status.st_dev;
+    index->inode = status.st_ino;
+    index->size = status.st_size;
+    index->modified = status.st_mtime;
+    index->changed = status.st_ctime;
+    if (!load(*index, _fileName))
+    {
+        ne7ssh::errors()->push(-1, "Cannot read known hosts file: '%s'.", _fileName.c_str());
+        _index.reset();
+        return std::shared_ptr<hostIndex>();
+    }
+    _index = index;
+    return index;
+}
+
+bool ne7ssh_known_hosts::load(hostIndex& index, const std::string& fileName)
+{
+    std::ifstream file(fileName.c_str());
+    std::string line;
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+    while (std::getline(file, line))
+    {
+        addLine(index, line);
+    }
+    return true;
+}
+
+void ne7ssh_known_hosts::addLine(hostIndex& index, const std::string& line)
+{
+    std::istringstream fields(line);
+    std::string marker, hosts, keyType, key, pattern;
+    std::vector<std::string> patterns;
+    std::istringstream hostList;
+    hashedEntry hashed;
+    patternEntry wild;
+    bool plain = true;
+    size_t saltEnd;
+    uint32 i;
+
+    if (!(fields >> hosts) || (hosts[0] == '#'))
+    {
+        return;
+    }
+    if (hosts[0] == '@')
+    {
+        marker = hosts;
+        if (!(fields >> hosts))
+        {
+            return;
+        }
+    }
+    if (!(fields >> keyType >> key))
+    {
+        return;
+    }
+    key = decodeBase64(key);
+    if (key.empty())
+    {
+        return;
+    }
+
+    if (marker == "@revoked")
+    {
+        index.revoked.insert(key);
+        return;
+    }
+    else if (!marker.empty())
+    {
+        // @cert-authority, host certificates are not supported
+        return;
+    }
+
+    if (hosts.compare(0, HASH_MAGIC.length(), HASH_MAGIC) == 0)
+    {
+        saltEnd = hosts.find('|', HASH_MAGIC.length());
+        if (saltEnd == std::string::npos)
+        {
+            return;
+        }
+        try
+        {
+            hashed.salt = base64_decode(hosts.substr(HASH_MAGIC.length(), saltEnd - HASH_MAGIC.length()), false);
+            hashed.hash = base64_decode(hosts.substr(saltEnd + 1), false);
+        }
+        catch (const std::exception&)
+        {
+            return;
+        }
+        hashed.keyType = keyType;
+        hashed.key = key;
+        index.hashed.push_back(hashed);
+        return;
+    }
+
+    hostList.str(toLower(hosts));
+    while (std::getline(hostList, pattern, ','))
+    {
+        if (pattern.empty())
+        {
+            continue;
+        }
+        if (pattern.find_first_of("*?!") != std::string::npos)
+        {
+            plain = false;
+        }
+        patterns.push_back(pattern);
+    }
+
+    if (plain)
+    {
+        for (i = 0; i < patterns.size(); i++)
+        {
+            index.plain[patterns[i] + " " + keyType].push_back(key);
+        }
+    }
+    else
+    {
+        wild.patterns = patterns;
+        wild.keyType = keyType;
+        wild.key = key;
+        index.patterns.push_back(wild);
+    }
+}
+
+std::vector<std::string> ne7ssh_known_hosts::matchHashed(hostIndex& index, const std::string& name, const std::string& keyType)
+{
+    std::vector<std::string> result;
+    std::string lookup = name + " " + keyType;
+    std::unordered_map<std::string, std::vector<std::string> >::iterator it;
+    SecureVector<Botan::byte> digest;
+    uint32 i;
+
+    if (index.hashed.empty())
+    {
+        return result;
+    }
+    {
+        std::unique_lock<std::mutex> lock(index.resolvedMutex);
+        it = index.resolved.find(lookup);
+        if (it != index.resolved.end())
+        {
+            return it->second;
+        }
+    }
+
+    // Every hashed entry has its own salt, so each one costs an HMAC. Done once per host and key type.
+    HMAC hmac(global_state().algorithm_factory().make_hash_function("SHA-160"));
+    for (i = 0; i < index.hashed.size(); i++)
+    {
+        if (index.hashed[i].keyType != keyType)
+        {
+            continue;
+        }
+        hmac.set_key(index.hashed[i].salt.begin(), index.hashed[i].salt.size());
+        hmac.update((const Botan::byte*)name.c_str(), name.length());
+        digest = hmac.final();
+        if (digest == index.hashed[i].hash)
+        {
+            result.push_back(index.hashed[i].key);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(index.resolvedMutex);
+    index.resolved[lookup] = result;
+    return result;
+}
+
+bool ne7ssh_known_hosts::matchPatterns(const std::vector<std::string>& patterns, const std::string& name)
+{
+    bool matched = false;
+    uint32 i;
+
+    for (i = 0; i < patterns.size(); i++)
+    {
+        if (patterns[i][0] == '!')
+        {
+            if (matchWildcard(patterns[i].c_str() + 1, name.c_str()))
+            {
+                return false;
+            }
+        }
+        else if (matchWildcard(patterns[i].c_str(), name.c_str()))
+        {
+            matched = true;
+        }
+    }
+    return matched;
+}
+
+bool ne7ssh_known_hosts::matchWildcard(const char* pattern, const char* name)
+{
+    for (; *pattern; pattern++, name++)
+    {
+        if (*pattern == '*')
+        {
+            // Try every possible length for the star
+            for (; ; name++)
+            {
+                if (matchWildcard(pattern + 1, name))
+                {
+                    return true;
+                }
+                if (!*name)
+                {
+                    return false;
+                }
+            }
+        }
+        if (!*name || ((*pattern != '?') && (*pattern != *name)))
+        {
+            return false;
+        }
+    }
+    return !*name;
+}
+
+uint8 ne7ssh_known_hosts::check(const std::string& host, short port, const Botan::SecureVector<Botan::byte>& hostKey)
+{
+    std::shared_ptr<hostIndex> index;
+    std::unordered_map<std::string, std::vector<std::string> >::const_iterator it;
+    std::vector<std::string> candidates;
+    std::string name, keyType, key;
+    ne7ssh_reader blob(hostKey, 0);
+    const Botan::byte* type;
+    uint32 typeLen;
+    bool enabled;
+    uint32 i;
+
+    index = current(enabled);
+    if (!enabled)
+    {
+        return DISABLED;
+    }
+    if (!index || !blob.getString(type, typeLen))
+    {
+        return UNKNOWN;
+    }
+    keyType.assign((const char*)type, typeLen);
+    key.assign((const char*)hostKey.begin(), hostKey.size());
+
+    if (index->revoked.count(key))
+    {
+        return REVOKED;
+    }
+
+    name = hostName(host, port);
+    it = index->plain.find(name + " " + keyType);
+    if (it != index->plain.end())
+    {
+        candidates = it->second;
+    }
+    std::vector<std::string> hashed = matchHashed(*index, name, keyType);
+    candidates.insert(candidates.end(), hashed.begin(), hashed.end());
+    for (i = 0; i < index->patterns.size(); i++)
+    {
+        if ((index->patterns[i].keyType == keyType) && matchPatterns(index->patterns[i].patterns, name))
+        {
+            candidates.push_back(index->patterns[i].key);
+        }
+    }
+
+    if (candidates.empty())
+    {
+        return UNKNOWN;
+    }
+    if (std::find(candidates.begin(), candidates.end(), key) != candidates.end())
+    {
+        return KNOWN;
+    }
+    return CHANGED;
+}
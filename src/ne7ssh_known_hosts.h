@@ -0,0 +1,161 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_KNOWN_HOSTS_H
+#define NE7SSH_KNOWN_HOSTS_H
+
+#include "ne7ssh_types.h"
+#include <botan/secmem.h>
+#include <sys/stat.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Host key verification against an OpenSSH known_hosts file.
+ * <p>The file is parsed once into an index keyed by host name and key type, and parsed again only when
+ * its device, inode, size, modification or change time differ on the next lookup. Plain, hashed (|1|salt|hash),
+ * wildcard and negated host patterns are understood, and so are @revoked lines. @cert-authority lines are skipped.
+ * <p>Lookups share the index without a lock, the mutex only guards swapping in a new one, so any number of
+ * connections can check their host key at the same time.
+ */
+class ne7ssh_known_hosts
+{
+public:
+    enum checkResults { DISABLED, KNOWN, UNKNOWN, CHANGED, REVOKED };
+
+private:
+    // Entry whose host field is hashed, the host name can only be tested, not looked up
+    struct hashedEntry
+    {
+        Botan::SecureVector<Botan::byte> salt;
+        Botan::SecureVector<Botan::byte> hash;
+        std::string keyType;
+        std::string key;
+    };
+
+    // Entry with wildcards or negations in its host field
+    struct patternEntry
+    {
+        std::vector<std::string> patterns;
+        std::string keyType;
+        std::string key;
+    };
+
+    // Parsed file, never changed once built except for the hashed lookup results
+    struct hostIndex
+    {
+        dev_t device;
+        ino_t inode;
+        off_t size;
+        time_t modified;
+        time_t changed;
+        // "host keytype" to the keys listed for it
+        std::unordered_map<std::string, std::vector<std::string> > plain;
+        std::vector<hashedEntry> hashed;
+        std::vector<patternEntry> patterns;
+        std::unordered_set<std::string> revoked;
+        // Hashed entries matched per "host keytype", filled on first lookup of each host
+        std::unordered_map<std::string, std::vector<std::string> > resolved;
+        std::mutex resolvedMutex;
+    };
+
+    std::string _fileName;
+    std::shared_ptr<hostIndex> _index;
+    std::mutex _mutex;
+
+    ne7ssh_known_hosts(const ne7ssh_known_hosts&);
+    ne7ssh_known_hosts& operator=(const ne7ssh_known_hosts&);
+
+    /**
+     * Returns the index for the current file contents, parsing the file if it changed since the last call.
+     * @param enabled Set to false if no file is set.
+     * @return The index, or an empty pointer if no file is set or it cannot be read.
+     */
+    std::shared_ptr<hostIndex> current(bool& enabled);
+
+    /**
+     * Parses a known_hosts file.
+     * @param index Index to fill.
+     * @param fileName Full path to the file.
+     * @return True if the file could be read, otherwise false is returned.
+     */
+    static bool load(hostIndex& index, const std::string& fileName);
+
+    /**
+     * Adds one line of a known_hosts file to the index. Lines that cannot be parsed are skipped.
+     * @param index Index to fill.
+     * @param line The line, without the line break.
+     */
+    static void addLine(hostIndex& index, const std::string& line);
+
+    /**
+     * Collects the keys the hashed entries list for a host.
+     * @param index Parsed file.
+     * @param name Host name as written to known_hosts.
+     * @param keyType SSH name of the key type.
+     * @return Keys of all matching hashed entries.
+     */
+    static std::vector<std::string> matchHashed(hostIndex& index, const std::string& name, const std::string& keyType);
+
+    /**
+     * Matches a host name against a comma separated host field, as OpenSSH does.
+     * @param patterns The patterns of the field. A pattern starting with '!' excludes the hosts it matches.
+     * @param name Host name as written to known_hosts.
+     * @return True if a pattern matched and no negated pattern did, otherwise false is returned.
+     */
+    static bool matchPatterns(const std::vector<std::string>& patterns, const std::string& name);
+
+    /**
+     * Matches a host name against a single pattern with '*' and '?' wildcards.
+     * @param pattern The pattern.
+     * @param name Host name.
+     * @return True if the pattern matches the whole name, otherwise false is returned.
+     */
+    static bool matchWildcard(const char* pattern, const char* name);
+
+public:
+    /**
+     * ne7ssh_known_hosts class constructor. No file is set, so checking is disabled.
+     */
+    ne7ssh_known_hosts();
+
+    /**
+     * ne7ssh_known_hosts class destructor.
+     */
+    ~ne7ssh_known_hosts();
+
+    /**
+     * Sets the known_hosts file to check host keys against.
+     * @param fileName Full path to the file, or 0 to stop checking host keys.
+     */
+    void setFile(const char* fileName);
+
+    /**
+     * Looks up a host key.
+     * @param host Host name or IP, as passed to the connect functions.
+     * @param port Port of the SSH server. Hosts on other ports than 22 are looked up as [host]:port.
+     * @param hostKey Host key blob sent by the server.
+     * @return DISABLED if no file is set, KNOWN if the file lists this key for the host, UNKNOWN if it lists no key of this type for the host,
+     * CHANGED if it lists other keys of this type for the host, REVOKED if the key is marked as revoked.
+     */
+    uint8 check(const std::string& host, short port, const Botan::SecureVector<Botan::byte>& hostKey);
+};
+
+#endif
@@ -0,0 +1,84 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_payload.h"
+#include <algorithm>
+#include <string.h>
+#if !defined(WIN32) && !defined(__MINGW32__)
+#   include <arpa/inet.h>
+#else
+#   include <Winsock2.h>
+#endif
+
+using namespace Botan;
+
+ne7ssh_payload::ne7ssh_payload()
+{
+}
+
+void ne7ssh_payload::reserve(Botan::MemoryRegion<Botan::byte>& buffer, ne7ssh_capacity& capacity, uint32 len)
+{
+    uint32 used = buffer.size();
+
+    if (used + len <= capacity.of(buffer))
+    {
+        return;
+    }
+    // MemoryRegion keeps its allocation when resized down. Should it ever move, capacity.of() sees the new memory.
+    buffer.resize(used + len);
+    capacity.set(buffer, used + len);
+    buffer.resize(used);
+}
+
+Botan::byte* ne7ssh_payload::grow(Botan::MemoryRegion<Botan::byte>& buffer, ne7ssh_capacity& capacity, uint32 len)
+{
+    uint32 used = buffer.size();
+    uint32 allocated = capacity.of(buffer);
+
+    if (used + len > allocated)
+    {
+        reserve(buffer, capacity, std::max(used + len, allocated * 2) - used);
+    }
+    buffer.resize(used + len);
+    return buffer.begin() + used;
+}
+
+void ne7ssh_payload::reserve(uint32 len)
+{
+    reserve(_buffer, _capacity, len);
+}
+
+void ne7ssh_payload::addBytes(const Botan::byte* buff, uint32 len)
+{
+    memcpy(grow(_buffer, _capacity, len), buff, len);
+}
+
+void ne7ssh_payload::addChar(const char ch)
+{
+    *grow(_buffer, _capacity, 1) = (Botan::byte)ch;
+}
+
+void ne7ssh_payload::addInt(const uint32 var)
+{
+    uint32 nVar = htonl(var);
+
+    memcpy(grow(_buffer, _capacity, sizeof(uint32)), &nVar, sizeof(uint32));
+}
+
+void ne7ssh_payload::chop(uint32 nBytes)
+{
+    _buffer.resize(_buffer.size() - nBytes);
+}
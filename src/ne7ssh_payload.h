@@ -0,0 +1,172 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_PAYLOAD_H
+#define NE7SSH_PAYLOAD_H
+
+#include "ne7ssh_types.h"
+#include <botan/secmem.h>
+
+/**
+ * Storage for bulk channel and SFTP data.
+ * <p>Locked, zeroizing SecureVector memory is kept for keys, passwords and key exchange secrets.
+ * User data (command output, file contents) goes to the ordinary allocator, unless the library is
+ * built with NE7SSH_LOCKED_PAYLOAD, in which case it is locked as well.
+ */
+#ifdef NE7SSH_LOCKED_PAYLOAD
+typedef Botan::SecureVector<Botan::byte> ne7ssh_payload_vector;
+#else
+typedef Botan::MemoryVector<Botan::byte> ne7ssh_payload_vector;
+#endif
+
+/**
+ * Allocation size of a Botan memory region, which MemoryRegion does not expose.
+ * <p>The size is tied to the memory it was measured for. Once the region holds other memory, after a swap,
+ * an assignment or a reallocation, only the bytes in use are known to be allocated.
+ */
+class ne7ssh_capacity
+{
+private:
+    const Botan::byte* _base;
+    uint32 _size;
+
+public:
+    /**
+     * ne7ssh_capacity class default constructor.
+     */
+    ne7ssh_capacity() : _base(0), _size(0)
+    {
+    }
+
+    /**
+     * Returns the known allocation size of a buffer.
+     * @param buffer The buffer.
+     * @return Allocation size, at least the size of the buffer.
+     */
+    uint32 of(const Botan::MemoryRegion<Botan::byte>& buffer)
+    {
+        if ((buffer.begin() != _base) || (_size < buffer.size()))
+        {
+            _base = buffer.begin();
+            _size = buffer.size();
+        }
+        return _size;
+    }
+
+    /**
+     * Records the allocation size of a buffer that has just been given its memory.
+     * @param buffer The buffer.
+     * @param size Allocation size of the buffer.
+     */
+    void set(const Botan::MemoryRegion<Botan::byte>& buffer, uint32 size)
+    {
+        _base = buffer.begin();
+        _size = size;
+    }
+};
+
+/**
+ * Growable buffer for user data, backed by ne7ssh_payload_vector.
+ */
+class ne7ssh_payload
+{
+private:
+    ne7ssh_payload_vector _buffer;
+    ne7ssh_capacity _capacity;
+
+public:
+    /**
+     * ne7ssh_payload class default constructor.
+     */
+    ne7ssh_payload();
+
+    /**
+     * Empties the buffer. Allocated memory is kept for reuse.
+     */
+    void clear()
+    {
+        _buffer.clear();
+    }
+
+    /**
+     * Makes sure the buffer can take len more bytes without reallocating.
+     * @param len Number of bytes about to be added.
+     */
+    void reserve(uint32 len);
+
+    /**
+     * Adds a byte stream to the buffer.
+     * @param buff Pointer to the byte stream.
+     * @param len Length of the byte stream.
+     */
+    void addBytes(const Botan::byte* buff, uint32 len);
+
+    /**
+     * Adds a single character to the buffer.
+     * @param ch a single character.
+     */
+    void addChar(const char ch);
+
+    /**
+     * Adds a single integer to the buffer, converted to network format.
+     * @param var a single integer.
+     */
+    void addInt(const uint32 var);
+
+    /**
+     * Chops bytes off of the end of the buffer.
+     * @param nBytes How many bytes to chop off the end of the buffer.
+     */
+    void chop(uint32 nBytes);
+
+    /**
+     * Returns the buffer as a vector.
+     * @return Reference to the underlying vector.
+     */
+    ne7ssh_payload_vector& value()
+    {
+        return _buffer;
+    }
+
+    /**
+     * Returns current length of the buffer.
+     * @return Length of the buffer.
+     */
+    uint32 length()
+    {
+        return _buffer.size();
+    }
+
+    /**
+     * Makes sure a buffer can take len more bytes without reallocating.
+     * <p> Shared with ne7ssh_string, works on any Botan memory region.
+     * @param buffer Buffer to reserve space in.
+     * @param capacity Allocation size of the buffer. Updated on growth.
+     * @param len Number of bytes about to be added.
+     */
+    static void reserve(Botan::MemoryRegion<Botan::byte>& buffer, ne7ssh_capacity& capacity, uint32 len);
+
+    /**
+     * Extends a buffer by len bytes, growing the allocation geometrically.
+     * @param buffer Buffer to extend.
+     * @param capacity Allocation size of the buffer. Updated on growth.
+     * @param len Number of bytes to append.
+     * @return Pointer to the first appended byte, to be filled in by the caller.
+     */
+    static Botan::byte* grow(Botan::MemoryRegion<Botan::byte>& buffer, ne7ssh_capacity& capacity, uint32 len);
+};
+
+#endif
@@ -0,0 +1,233 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_poly1305.h"
+#include <string.h>
+
+using namespace Botan;
+
+namespace
+{
+uint32 load32(const Botan::byte* in)
+{
+    return (uint32)in[0] | ((uint32)in[1] << 8) | ((uint32)in[2] << 16) | ((uint32)in[3] << 24);
+}
+
+void store32(Botan::byte* out, uint32 val)
+{
+    out[0] = (Botan::byte)val;
+    out[1] = (Botan::byte)(val >> 8);
+    out[2] = (Botan::byte)(val >> 16);
+    out[3] = (Botan::byte)(val >> 24);
+}
+}
+
+ne7ssh_poly1305::ne7ssh_poly1305(const Botan::byte* key)
+    : _buffered(0)
+{
+    // r is clamped as required by the spec
+    _r[0] = load32(key) & 0x3ffffff;
+    _r[1] = (load32(key + 3) >> 2) & 0x3ffff03;
+    _r[2] = (load32(key + 6) >> 4) & 0x3ffc0ff;
+    _r[3] = (load32(key + 9) >> 6) & 0x3f03fff;
+    _r[4] = (load32(key + 12) >> 8) & 0x00fffff;
+
+    memset(_h, 0, sizeof(_h));
+
+    _pad[0] = load32(key + 16);
+    _pad[1] = load32(key + 20);
+    _pad[2] = load32(key + 24);
+    _pad[3] = load32(key + 28);
+}
+
+ne7ssh_poly1305::~ne7ssh_poly1305()
+{
+    volatile Botan::byte* p = (volatile Botan::byte*)this;
+    size_t i;
+
+    for (i = 0; i < sizeof(*this); i++)
+    {
+        p[i] = 0;
+    }
+}
+
+void ne7ssh_poly1305::blocks(const Botan::byte* data, uint32 len, uint32 hibit)
+{
+    const uint32 r0 = _r[0], r1 = _r[1], r2 = _r[2], r3 = _r[3], r4 = _r[4];
+    const uint32 s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32 h0 = _h[0], h1 = _h[1], h2 = _h[2], h3 = _h[3], h4 = _h[4];
+    uint64 d0, d1, d2, d3, d4;
+    uint32 c;
+
+    while (len >= 16)
+    {
+        h0 += load32(data) & 0x3ffffff;
+        h1 += (load32(data + 3) >> 2) & 0x3ffffff;
+        h2 += (load32(data + 6) >> 4) & 0x3ffffff;
+        h3 += (load32(data + 9) >> 6) & 0x3ffffff;
+        h4 += (load32(data + 12) >> 8) | hibit;
+
+        d0 = ((uint64)h0 * r0) + ((uint64)h1 * s4) + ((uint64)h2 * s3) + ((uint64)h3 * s2) + ((uint64)h4 * s1);
+        d1 = ((uint64)h0 * r1) + ((uint64)h1 * r0) + ((uint64)h2 * s4) + ((uint64)h3 * s3) + ((uint64)h4 * s2);
+        d2 = ((uint64)h0 * r2) + ((uint64)h1 * r1) + ((uint64)h2 * r0) + ((uint64)h3 * s4) + ((uint64)h4 * s3);
+        d3 = ((uint64)h0 * r3) + ((uint64)h1 * r2) + ((uint64)h2 * r1) + ((uint64)h3 * r0) + ((uint64)h4 * s4);
+        d4 = ((uint64)h0 * r4) + ((uint64)h1 * r3) + ((uint64)h2 * r2) + ((uint64)h3 * r1) + ((uint64)h4 * r0);
+
+        c = (uint32)(d0 >> 26);
+        h0 = (uint32)d0 & 0x3ffffff;
+        d1 += c;
+        c = (uint32)(d1 >> 26);
+        h1 = (uint32)d1 & 0x3ffffff;
+        d2 += c;
+        c = (uint32)(d2 >> 26);
+        h2 = (uint32)d2 & 0x3ffffff;
+        d3 += c;
+        c = (uint32)(d3 >> 26);
+        h3 = (uint32)d3 & 0x3ffffff;
+        d4 += c;
+        c = (uint32)(d4 >> 26);
+        h4 = (uint32)d4 & 0x3ffffff;
+        h0 += c * 5;
+        c = h0 >> 26;
+        h0 &= 0x3ffffff;
+        h1 += c;
+
+        data += 16;
+        len -= 16;
+    }
+
+    _h[0] = h0;
+    _h[1] = h1;
+    _h[2] = h2;
+    _h[3] = h3;
+    _h[4] = h4;
+}
+
+void ne7ssh_poly1305::update(const Botan::byte* data, uint32 len)
+{
+    uint32 want, full;
+
+    if (_buffered)
+    {
+        want = 16 - _buffered;
+        if (want > len)
+        {
+            want = len;
+        }
+        memcpy(_buffer + _buffered, data, want);
+        _buffered += want;
+        data += want;
+        len -= want;
+        if (_buffered < 16)
+        {
+            return;
+        }
+        blocks(_buffer, 16, 1 << 24);
+        _buffered = 0;
+    }
+
+    full = len & ~15U;
+    if (full)
+    {
+        blocks(data, full, 1 << 24);
+        data += full;
+        len -= full;
+    }
+    if (len)
+    {
+        memcpy(_buffer, data, len);
+        _buffered = len;
+    }
+}
+
+void ne7ssh_poly1305::final(Botan::byte* tag)
+{
+    uint32 h0, h1, h2, h3, h4, c;
+    uint32 g0, g1, g2, g3, g4, mask;
+    uint64 f;
+
+    if (_buffered)
+    {
+        _buffer[_buffered++] = 1;
+        memset(_buffer + _buffered, 0, 16 - _buffered);
+        blocks(_buffer, 16, 0);
+        _buffered = 0;
+    }
+
+    h0 = _h[0];
+    h1 = _h[1];
+    h2 = _h[2];
+    h3 = _h[3];
+    h4 = _h[4];
+
+    c = h1 >> 26;
+    h1 &= 0x3ffffff;
+    h2 += c;
+    c = h2 >> 26;
+    h2 &= 0x3ffffff;
+    h3 += c;
+    c = h3 >> 26;
+    h3 &= 0x3ffffff;
+    h4 += c;
+    c = h4 >> 26;
+    h4 &= 0x3ffffff;
+    h0 += c * 5;
+    c = h0 >> 26;
+    h0 &= 0x3ffffff;
+    h1 += c;
+
+    // h - p, picked instead of h when it does not underflow
+    g0 = h0 + 5;
+    c = g0 >> 26;
+    g0 &= 0x3ffffff;
+    g1 = h1 + c;
+    c = g1 >> 26;
+    g1 &= 0x3ffffff;
+    g2 = h2 + c;
+    c = g2 >> 26;
+    g2 &= 0x3ffffff;
+    g3 = h3 + c;
+    c = g3 >> 26;
+    g3 &= 0x3ffffff;
+    g4 = h4 + c - (1 << 26);
+
+    mask = (g4 >> 31) - 1;
+    g0 &= mask;
+    g1 &= mask;
+    g2 &= mask;
+    g3 &= mask;
+    g4 &= mask;
+    mask = ~mask;
+    h0 = (h0 & mask) | g0;
+    h1 = (h1 & mask) | g1;
+    h2 = (h2 & mask) | g2;
+    h3 = (h3 & mask) | g3;
+    h4 = (h4 & mask) | g4;
+
+    h0 = h0 | (h1 << 26);
+    h1 = (h1 >> 6) | (h2 << 20);
+    h2 = (h2 >> 12) | (h3 << 14);
+    h3 = (h3 >> 18) | (h4 << 8);
+
+    f = (uint64)h0 + _pad[0];
+    store32(tag, (uint32)f);
+    f = (uint64)h1 + _pad[1] + (f >> 32);
+    store32(tag + 4, (uint32)f);
+    f = (uint64)h2 + _pad[2] + (f >> 32);
+    store32(tag + 8, (uint32)f);
+    f = (uint64)h3 + _pad[3] + (f >> 32);
+    store32(tag + 12, (uint32)f);
+}
@@ -0,0 +1,73 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_POLY1305_H
+#define NE7SSH_POLY1305_H
+
+#include "ne7ssh_types.h"
+#include <botan/secmem.h>
+
+#define NE7SSH_POLY1305_KEY_LEN 32
+#define NE7SSH_POLY1305_TAG_LEN 16
+
+/**
+ * Poly1305 one-time authenticator.
+ * <p>Uses 26 bit limbs, so every multiplication fits in 64 bits on any platform.
+ */
+class ne7ssh_poly1305
+{
+private:
+    uint32 _r[5];
+    uint32 _h[5];
+    uint32 _pad[4];
+    Botan::byte _buffer[16];
+    uint32 _buffered;
+
+    /**
+     * Absorbs whole 16 byte blocks.
+     * @param data Pointer to the data.
+     * @param len Length of the data, a multiple of 16.
+     * @param hibit 1 << 24 for full blocks, 0 for the padded final block.
+     */
+    void blocks(const Botan::byte* data, uint32 len, uint32 hibit);
+
+public:
+    /**
+     * ne7ssh_poly1305 class constructor.
+     * @param key Pointer to a 32 byte one-time key.
+     */
+    ne7ssh_poly1305(const Botan::byte* key);
+
+    /**
+     * ne7ssh_poly1305 class destructor. Wipes the key and the state.
+     */
+    ~ne7ssh_poly1305();
+
+    /**
+     * Adds data to the authenticated message.
+     * @param data Pointer to the data.
+     * @param len Length of the data.
+     */
+    void update(const Botan::byte* data, uint32 len);
+
+    /**
+     * Finishes the computation.
+     * @param tag Buffer receiving the 16 byte tag.
+     */
+    void final(Botan::byte* tag);
+};
+
+#endif
@@ -0,0 +1,134 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_reader.h"
+#include <string.h>
+#if !defined(WIN32) && !defined(__MINGW32__)
+#   include <arpa/inet.h>
+#else
+#   include <Winsock2.h>
+#endif
+
+using namespace Botan;
+
+ne7ssh_reader::ne7ssh_reader(const Botan::MemoryRegion<Botan::byte>& var, uint32 position)
+    : _data(var.begin()),
+    _length(var.size()),
+    _offset(position)
+{
+    if (_offset > _length)
+    {
+        _offset = _length;
+    }
+}
+
+ne7ssh_reader::ne7ssh_reader(const Botan::byte* data, uint32 len)
+    : _data(data),
+    _length(len),
+    _offset(0)
+{
+}
+
+bool ne7ssh_reader::getString(const Botan::byte*& str, uint32& len)
+{
+    uint32 fieldLen;
+
+    if (remaining() < sizeof(uint32))
+    {
+        return false;
+    }
+    memcpy(&fieldLen, current(), sizeof(uint32));
+    fieldLen = ntohl(fieldLen);
+    if (fieldLen > remaining() - sizeof(uint32))
+    {
+        return false;
+    }
+
+    str = current() + sizeof(uint32);
+    len = fieldLen;
+    _offset += sizeof(uint32) + fieldLen;
+    return true;
+}
+
+bool ne7ssh_reader::getString(Botan::SecureVector<Botan::byte>& result)
+{
+    const Botan::byte* str;
+    uint32 len;
+
+    if (!getString(str, len))
+    {
+        return false;
+    }
+    result = SecureVector<Botan::byte>(str, len);
+    return true;
+}
+
+bool ne7ssh_reader::getBigInt(Botan::BigInt& result)
+{
+    const Botan::byte* str;
+    uint32 len;
+
+    if (!getString(str, len))
+    {
+        return false;
+    }
+    BigInt tmpBI(str, len);
+    result.swap(tmpBI);
+    return true;
+}
+
+uint32 ne7ssh_reader::getInt()
+{
+    uint32 result;
+
+    if (remaining() < sizeof(uint32))
+    {
+        _offset = _length;
+        return 0;
+    }
+    memcpy(&result, current(), sizeof(uint32));
+    _offset += sizeof(uint32);
+    return ntohl(result);
+}
+
+uint64 ne7ssh_reader::getInt64()
+{
+    uint64 result;
+
+    result = (uint64)getInt() << 32;
+    result |= (uint64)getInt();
+    return result;
+}
+
+Botan::byte ne7ssh_reader::getByte()
+{
+    if (!remaining())
+    {
+        return 0;
+    }
+    return _data[_offset++];
+}
+
+bool ne7ssh_reader::skip(uint32 nBytes)
+{
+    if (nBytes > remaining())
+    {
+        _offset = _length;
+        return false;
+    }
+    _offset += nBytes;
+    return true;
+}
@@ -0,0 +1,118 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_READER_H
+#define NE7SSH_READER_H
+
+#include "ne7ssh_types.h"
+#include <botan/bigint.h>
+
+/**
+ * Read cursor over a received SSH payload.
+ * <p>Unlike ne7ssh_string getters, the reader never copies or shrinks the underlying buffer,
+ * it only advances an offset. String fields are returned as pointers into the buffer, so the
+ * buffer must outlive the reader and any pointers it handed out.
+ */
+class ne7ssh_reader
+{
+private:
+    const Botan::byte* _data;
+    uint32 _length;
+    uint32 _offset;
+
+public:
+    /**
+     * ne7ssh_reader class constructor.
+     * @param var Reference to a vector containing the payload. The vector is not copied.
+     * @param position Position in the vector to start reading from.
+     */
+    ne7ssh_reader(const Botan::MemoryRegion<Botan::byte>& var, uint32 position);
+
+    /**
+     * Same as above constructor, but works with a raw byte stream.
+     * @param data Pointer to the byte stream.
+     * @param len Length of the byte stream.
+     */
+    ne7ssh_reader(const Botan::byte* data, uint32 len);
+
+    /**
+     * Extracts a single string field without copying it.
+     * @param str Set to point at the first byte of the string inside the payload.
+     * @param len Set to the length of the string.
+     * @return True if string field was found and successfully parsed, otherwise false is returned.
+     */
+    bool getString(const Botan::byte*& str, uint32& len);
+
+    /**
+     * Extracts a single string field into a vector.
+     * <p>Only to be used when the field has to outlive the payload.
+     * @param result Reference to a buffer where the result will be stored.
+     * @return True if string field was found and successfully parsed, otherwise false is returned.
+     */
+    bool getString(Botan::SecureVector<Botan::byte>& result);
+
+    /**
+     * Extracts a single BigInt variable.
+     * @param result Reference to a BigInt variable where the result will be stored.
+     * @return True if BigInt field was found and successfully parsed, otherwise false is returned.
+     */
+    bool getBigInt(Botan::BigInt& result);
+
+    /**
+     * Extracts a single unsigned integer (uint32).
+     * @return The integer extracted from the next 4 bytes of the payload, or 0 if the payload is too short.
+     */
+    uint32 getInt();
+
+    /**
+     * Extracts a single 64 bit unsigned integer, as used by SFTP.
+     * @return The integer extracted from the next 8 bytes of the payload, or 0 if the payload is too short.
+     */
+    uint64 getInt64();
+
+    /**
+     * Extracts a single byte.
+     * @return A byte extracted from the next byte of the payload, or 0 if the payload is exhausted.
+     */
+    Botan::byte getByte();
+
+    /**
+     * Advances the cursor without reading.
+     * @param nBytes How many bytes to skip.
+     * @return True if the payload was long enough, otherwise false is returned.
+     */
+    bool skip(uint32 nBytes);
+
+    /**
+     * Returns pointer to the unread part of the payload.
+     * @return Pointer to the byte under the cursor.
+     */
+    const Botan::byte* current() const
+    {
+        return _data + _offset;
+    }
+
+    /**
+     * Returns how many bytes are left to read.
+     * @return Length of the unread part of the payload.
+     */
+    uint32 remaining() const
+    {
+        return _length - _offset;
+    }
+};
+
+#endif
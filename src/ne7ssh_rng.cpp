@@ -0,0 +1,109 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_rng.h"
+
+using namespace Botan;
+
+ne7ssh_rng::threadRng::threadRng()
+    : owner(NULL),
+    rng(NULL),
+    output(0)
+{
+}
+
+ne7ssh_rng::threadRng::~threadRng()
+{
+    if (owner)
+    {
+        std::unique_lock<std::mutex> lock(owner->_mutex);
+        owner->_free.push_back(rng);
+    }
+}
+
+ne7ssh_rng::ne7ssh_rng()
+{
+}
+
+ne7ssh_rng::~ne7ssh_rng()
+{
+}
+
+ne7ssh_rng::threadRng& ne7ssh_rng::local()
+{
+    static thread_local threadRng state;
+
+    if (state.owner != this)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_free.empty())
+        {
+            _all.push_back(std::unique_ptr<RandomNumberGenerator>(new AutoSeeded_RNG()));
+            state.rng = _all.back().get();
+        }
+        else
+        {
+            // Left behind by an exited thread, do not continue its output stream
+            state.rng = _free.back();
+            _free.pop_back();
+            state.rng->reseed(NE7SSH_RNG_RESEED_BITS);
+        }
+        state.owner = this;
+        state.output = 0;
+    }
+    return state;
+}
+
+void ne7ssh_rng::randomize(Botan::byte output[], size_t length)
+{
+    threadRng& state = local();
+
+    state.rng->randomize(output, length);
+    state.output += length;
+    if (state.output >= NE7SSH_RNG_RESEED_BYTES)
+    {
+        state.rng->reseed(NE7SSH_RNG_RESEED_BITS);
+        state.output = 0;
+    }
+}
+
+void ne7ssh_rng::clear() throw()
+{
+    local().rng->clear();
+}
+
+std::string ne7ssh_rng::name() const
+{
+    return "AutoSeeded_RNG per thread";
+}
+
+void ne7ssh_rng::reseed(size_t bits_to_collect)
+{
+    threadRng& state = local();
+
+    state.rng->reseed(bits_to_collect);
+    state.output = 0;
+}
+
+void ne7ssh_rng::add_entropy_source(Botan::EntropySource* source)
+{
+    local().rng->add_entropy_source(source);
+}
+
+void ne7ssh_rng::add_entropy(const Botan::byte in[], size_t length)
+{
+    local().rng->add_entropy(in, length);
+}
@@ -18,58 +18,74 @@
 #define NE7SSH_RNG_H
 
 #include <memory>
+#include <mutex>
+#include <vector>
 #include <botan/auto_rng.h>
 
+// Output after which a thread's generator reseeds itself from the system sources
+#define NE7SSH_RNG_RESEED_BYTES (1024 * 1024)
+#define NE7SSH_RNG_RESEED_BITS 256
+
+/**
+ * Random number generator shared by the whole library.
+ * <p>Every thread that asks for random data gets an AutoSeeded_RNG of its own, so parallel handshakes do not
+ * wait on each other. The lock is only taken when a thread uses the generator for the first time and when it exits.
+ * The generator of an exited thread is kept and handed to the next new thread, after a reseed.
+ */
 class ne7ssh_rng : public Botan::RandomNumberGenerator
 {
-public:
-    ne7ssh_rng()
-        : _rng(new Botan::AutoSeeded_RNG())
+private:
+    // Generator of the calling thread
+    struct threadRng
     {
-    }
+        ne7ssh_rng* owner;
+        Botan::RandomNumberGenerator* rng;
+        size_t output;
 
-    ~ne7ssh_rng()
-    {
-    }
+        threadRng();
+        ~threadRng();
+    };
 
-    void randomize(Botan::byte output[], size_t length)
-    {
-        std::unique_lock<std::recursive_mutex> lock(_mutex);
-        _rng->randomize(output, length);
-    }
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<Botan::RandomNumberGenerator> > _all;
+    std::vector<Botan::RandomNumberGenerator*> _free;
 
-    void clear() throw()
-    {
-        std::unique_lock<std::recursive_mutex> lock(_mutex);
-        _rng->clear();
-    }
+    ne7ssh_rng(const ne7ssh_rng&);
+    ne7ssh_rng& operator=(const ne7ssh_rng&);
 
-    std::string name() const
-    {
-        return _rng->name();
-    }
+    /**
+     * Returns the generator of the calling thread, assigning one on first use.
+     * @return Per thread state.
+     */
+    threadRng& local();
 
-    void reseed(size_t bits_to_collect)
-    {
-        std::unique_lock<std::recursive_mutex> lock(_mutex);
-        _rng->reseed(bits_to_collect);
-    }
+public:
+    ne7ssh_rng();
+    ~ne7ssh_rng();
 
-    void add_entropy_source(Botan::EntropySource* source)
-    {
-        std::unique_lock<std::recursive_mutex> lock(_mutex);
-        _rng->add_entropy_source(source);
-    }
+    void randomize(Botan::byte output[], size_t length);
 
-    void add_entropy(const Botan::byte in[], size_t length)
-    {
-        std::unique_lock<std::recursive_mutex> lock(_mutex);
-        _rng->add_entropy(in, length);
-    }
+    /**
+     * Clears the state of the calling thread's generator only.
+     */
+    void clear() throw();
 
-private:
-    std::recursive_mutex _mutex;
-    std::unique_ptr<Botan::RandomNumberGenerator> _rng;
+    std::string name() const;
+
+    /**
+     * Reseeds the calling thread's generator only.
+     */
+    void reseed(size_t bits_to_collect);
+
+    /**
+     * Adds the source to the calling thread's generator only.
+     */
+    void add_entropy_source(Botan::EntropySource* source);
+
+    /**
+     * Mixes the input into the calling thread's generator only.
+     */
+    void add_entropy(const Botan::byte in[], size_t length);
 };
 
 #endif
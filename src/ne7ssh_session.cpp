@@ -21,6 +21,7 @@ ne7ssh_session::ne7ssh_session()
     _receiveChannel(0),
     _maxPacket(0),
     _channelID(-1),
+    _remotePort(0),
     _transport(0)
 {
 }
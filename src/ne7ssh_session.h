@@ -19,6 +19,7 @@
 
 #include "ne7ssh_transport.h"
 #include "ne7ssh_crypt.h"
+#include "ne7ssh_buffer_pool.h"
 
 /**
 @author Andrew Useckas
@@ -33,10 +34,13 @@ private:
     uint32 _receiveChannel;
     uint32 _maxPacket;
     int32 _channelID;
+    std::string _remoteHost;
+    short _remotePort;
 
 public:
     std::shared_ptr<ne7ssh_transport> _transport;
     std::shared_ptr<ne7ssh_crypt> _crypto;
+    ne7ssh_buffer_pool _pool;
 
     /**
      * ne7ssh_session class constructor.
@@ -84,6 +88,35 @@ public:
         return _remoteVersion;
     }
 
+    /**
+     * Sets the host name and port the session is connected to, as given by the user.
+     * @param host Host name or IP.
+     * @param port Port number.
+     */
+    void setRemoteHost(const char* host, short port)
+    {
+        _remoteHost.assign(host);
+        _remotePort = port;
+    }
+
+    /**
+     * Returns the remote host name, as given by the user.
+     * @return Host name or IP.
+     */
+    const std::string& getRemoteHost() const
+    {
+        return _remoteHost;
+    }
+
+    /**
+     * Returns the remote port.
+     * @return Port number.
+     */
+    short getRemotePort() const
+    {
+        return _remotePort;
+    }
+
     /**
      * Sets SSH session ID, a.k.a. H from the first KEX.
      * @param session Reference to a vector containing the session ID.
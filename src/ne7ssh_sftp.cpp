@@ -77,53 +77,56 @@ bool Ne7sshSftp::init()
     return status;
 }
 
-bool Ne7sshSftp::handleData(Botan::SecureVector<Botan::byte>& packet)
+bool Ne7sshSftp::handleData(ne7ssh_reader& packet)
 {
-    ne7ssh_string mainBuffer(packet, 0);
-    SecureVector<Botan::byte> sftpBuffer;
+    const Botan::byte* data;
+    uint32 dataLen;
+    ne7ssh_payload_vector message;
     uint32 len = 0;
     Botan::byte cmd;
 
-    mainBuffer.getInt();
+    packet.getInt();
 
-    if (!mainBuffer.getString(sftpBuffer))
+    if (!packet.getString(data, dataLen))
     {
         return false;
     }
-    if (!sftpBuffer.size())
+    if (!dataLen)
     {
         ne7ssh::errors()->push(_session->getSshChannel(), "Abnormal. End of stream detected in SFTP subsystem.");
     }
 
-    adjustRecvWindow(sftpBuffer.size());
+    adjustRecvWindow(dataLen);
 
     if (_seq >= SFTP_MAX_SEQUENCE)
     {
         _seq = 0;
     }
 
-    mainBuffer.clear();
-
-    len = _commBuffer.length();
-
-    if (len)
+    // Only fragmented SFTP messages are reassembled, complete ones are parsed in place.
+    if (_commBuffer.length())
     {
-        mainBuffer.addVector(_commBuffer.value());
+        _commBuffer.addBytes(data, dataLen);
+        message.swap(_commBuffer.value());
+        data = message.begin();
+        dataLen = message.size();
     }
 
-    _commBuffer.addVector(sftpBuffer);
-    mainBuffer.addVector(sftpBuffer);
-
+    ne7ssh_reader mainBuffer(data, dataLen);
     len = mainBuffer.getInt();
 
-    if (len > mainBuffer.length())
+    if (len > mainBuffer.remaining())
     {
+        if (message.empty())
+        {
+            _commBuffer.addBytes(data, dataLen);
+        }
+        else
+        {
+            _commBuffer.value().swap(message);
+        }
         return true;
     }
-    else
-    {
-        _commBuffer.clear();
-    }
 
     cmd = mainBuffer.getByte();
 
@@ -131,22 +134,22 @@ bool Ne7sshSftp::handleData(Botan::SecureVector<Botan::byte>& packet)
     switch (cmd)
     {
         case SSH2_FXP_VERSION:
-            return handleVersion(mainBuffer.value());
+            return handleVersion(mainBuffer);
 
         case SSH2_FXP_HANDLE:
-            return addOpenHandle(mainBuffer.value());
+            return addOpenHandle(mainBuffer);
 
         case SSH2_FXP_STATUS:
-            return handleStatus(mainBuffer.value());
+            return handleStatus(mainBuffer);
 
         case SSH2_FXP_DATA:
-            return handleSftpData(mainBuffer.value());
+            return handleSftpData(mainBuffer);
 
         case SSH2_FXP_NAME:
-            return handleNames(mainBuffer.value());
+            return handleNames(mainBuffer);
 
         case SSH2_FXP_ATTRS:
-            return processAttrs(mainBuffer.value());
+            return processAttrs(mainBuffer);
 
         default:
             ne7ssh::errors()->push(_session->getSshChannel(), "Unhandled SFTP subsystem command: %i.", cmd);
@@ -158,7 +161,8 @@ bool Ne7sshSftp::handleData(Botan::SecureVector<Botan::byte>& packet)
 bool Ne7sshSftp::receiveWindowAdjust()
 {
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    SecureVector<Botan::byte> packet;
+    ne7ssh_pooled_buffer packetBuffer(_session->_pool, MAX_PACKET_LEN);
+    SecureVector<Botan::byte>& packet = packetBuffer.value();
 
     if (!transport->waitForPacket(SSH2_MSG_CHANNEL_WINDOW_ADJUST))
     {
@@ -176,7 +180,8 @@ bool Ne7sshSftp::receiveWindowAdjust()
 bool Ne7sshSftp::receiveUntil(uint8 cmd, uint32 timeSec)
 {
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    SecureVector<Botan::byte> packet;
+    ne7ssh_pooled_buffer packetBuffer(_session->_pool, MAX_PACKET_LEN);
+    SecureVector<Botan::byte>& packet = packetBuffer.value();
     uint32 cutoff = timeSec * 1000000, timeout = 0;
     uint32 prevSize = 0;
     short status;
@@ -229,7 +234,8 @@ bool Ne7sshSftp::receiveUntil(uint8 cmd, uint32 timeSec)
 bool Ne7sshSftp::receiveWhile(uint8 cmd, uint32 timeSec)
 {
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    SecureVector<Botan::byte> packet;
+    ne7ssh_pooled_buffer packetBuffer(_session->_pool, MAX_PACKET_LEN);
+    SecureVector<Botan::byte>& packet = packetBuffer.value();
     uint32 cutoff = timeSec * 1000000, timeout = 0;
     uint32 prevSize = 0;
     short status;
@@ -284,12 +290,11 @@ bool Ne7sshSftp::receiveWhile(uint8 cmd, uint32 timeSec)
     return false;
 }
 
-bool Ne7sshSftp::handleVersion(Botan::SecureVector<Botan::byte>& packet)
+bool Ne7sshSftp::handleVersion(ne7ssh_reader& packet)
 {
-    ne7ssh_string sftpBuffer(packet, 0);
     uint32 version;
 
-    version = sftpBuffer.getInt();
+    version = packet.getInt();
 
     if (version != SFTP_VERSION)
     {
@@ -300,71 +305,71 @@ bool Ne7sshSftp::handleVersion(Botan::SecureVector<Botan::byte>& packet)
     return true;
 }
 
-bool Ne7sshSftp::handleStatus(Botan::SecureVector<Botan::byte>& packet)
+bool Ne7sshSftp::handleStatus(ne7ssh_reader& packet)
 {
-    ne7ssh_string sftpBuffer(packet, 0);
     uint32 errorID;
     SecureVector<Botan::byte> errorStr;
 
-    sftpBuffer.getInt();
-    errorID = sftpBuffer.getInt();
-    sftpBuffer.getString(errorStr);
+    packet.getInt();
+    errorID = packet.getInt();
+    packet.getString(errorStr);
 
     if (errorID)
     {
         _lastError = (uint8)errorID;
-        ne7ssh::errors()->push(_session->getSshChannel(), "SFTP Error code: <%i>, description: %s.", errorID, errorStr.begin());
+        ne7ssh::errors()->push(_session->getSshChannel(), "SFTP Error code: <%i>, description: %B.", errorID, &errorStr);
         return false;
     }
     return true;
 }
 
-bool Ne7sshSftp::addOpenHandle(Botan::SecureVector<Botan::byte>& packet)
+bool Ne7sshSftp::addOpenHandle(ne7ssh_reader& packet)
 {
-    ne7ssh_string sftpBuffer(packet, 0);
     uint32 requestID;
-    SecureVector<Botan::byte> handle;
+    const Botan::byte* handle;
+    uint32 len;
 
-    requestID = sftpBuffer.getInt();
-    sftpBuffer.getString(handle);
+    requestID = packet.getInt();
+    if (!packet.getString(handle, len))
+    {
+        return false;
+    }
 
     sftpFile file;
     file.fileID = requestID;
-    file._handle.assign((char*)handle.begin(), handle.size());
+    file._handle.assign((const char*)handle, len);
     sftpFiles.push_back(file);
 
     return true;
 }
 
-bool Ne7sshSftp::handleSftpData(Botan::SecureVector<Botan::byte>& packet)
+bool Ne7sshSftp::handleSftpData(ne7ssh_reader& packet)
 {
-    ne7ssh_string sftpBuffer(packet, 0);
-    SecureVector<Botan::byte> data;
+    const Botan::byte* data;
+    uint32 len = 0;
 
-    sftpBuffer.getInt();
-    sftpBuffer.getString(data);
+    packet.getInt();
 
-    if (data.size() == 0)
+    if (!packet.getString(data, len) || len == 0)
     {
         ne7ssh::errors()->push(_session->getSshChannel(), "Abnormal. End of stream detected.");
         return false;
     }
 
     _commBuffer.clear();
-    _fileBuffer.clear();
-    _fileBuffer.swap(data);
+    _fileBuffer = ne7ssh_payload_vector(data, len);
     return true;
 }
 
-bool Ne7sshSftp::handleNames(Botan::SecureVector<Botan::byte>& packet)
+bool Ne7sshSftp::handleNames(ne7ssh_reader& packet)
 {
-    Ne7sshSftpPacket sftpBuffer(packet, 0);
-    ne7ssh_string tmpVar;
+    ne7ssh_payload tmpVar;
     uint32 fileCount, i;
-    SecureVector<Botan::byte> fileName;
+    const Botan::byte* fileName;
+    uint32 len;
 
-    sftpBuffer.getInt();
-    fileCount = sftpBuffer.getInt();
+    packet.getInt();
+    fileCount = packet.getInt();
     tmpVar.addInt(fileCount);
 
     if (!fileCount)
@@ -374,31 +379,39 @@ bool Ne7sshSftp::handleNames(Botan::SecureVector<Botan::byte>& packet)
 
     for (i = 0; i < fileCount; i++)
     {
-        sftpBuffer.getString(fileName);
-        tmpVar.addVectorField(fileName);
-        sftpBuffer.getString(fileName);
-        tmpVar.addVectorField(fileName);
-        _attrs.flags = sftpBuffer.getInt();
+        if (!packet.getString(fileName, len))
+        {
+            return false;
+        }
+        tmpVar.addInt(len);
+        tmpVar.addBytes(fileName, len);
+        if (!packet.getString(fileName, len))
+        {
+            return false;
+        }
+        tmpVar.addInt(len);
+        tmpVar.addBytes(fileName, len);
+        _attrs.flags = packet.getInt();
         if (_attrs.flags & SSH2_FILEXFER_ATTR_SIZE)
         {
-            _attrs.size = sftpBuffer.getInt64();
+            _attrs.size = packet.getInt64();
         }
 
         if (_attrs.flags & SSH2_FILEXFER_ATTR_UIDGID)
         {
-            _attrs.owner = sftpBuffer.getInt();
-            _attrs.group = sftpBuffer.getInt();
+            _attrs.owner = packet.getInt();
+            _attrs.group = packet.getInt();
         }
 
         if (_attrs.flags & SSH2_FILEXFER_ATTR_PERMISSIONS)
         {
-            _attrs.permissions = sftpBuffer.getInt();
+            _attrs.permissions = packet.getInt();
         }
 
         if (_attrs.flags & SSH2_FILEXFER_ATTR_ACMODTIME)
         {
-            _attrs.atime = sftpBuffer.getInt();
-            _attrs.mtime = sftpBuffer.getInt();
+            _attrs.atime = packet.getInt();
+            _attrs.mtime = packet.getInt();
         }
     }
     _fileBuffer += tmpVar.value();
@@ -406,33 +419,30 @@ bool Ne7sshSftp::handleNames(Botan::SecureVector<Botan::byte>& packet)
     return true;
 }
 
-bool Ne7sshSftp::processAttrs(Botan::SecureVector<Botan::byte>& packet)
+bool Ne7sshSftp::processAttrs(ne7ssh_reader& packet)
 {
-    Ne7sshSftpPacket sftpBuffer(packet, 0);
-    SecureVector<Botan::byte> data;
-
-    sftpBuffer.getInt();
-    _attrs.flags = sftpBuffer.getInt();
+    packet.getInt();
+    _attrs.flags = packet.getInt();
     if (_attrs.flags & SSH2_FILEXFER_ATTR_SIZE)
     {
-        _attrs.size = sftpBuffer.getInt64();
+        _attrs.size = packet.getInt64();
     }
 
     if (_attrs.flags & SSH2_FILEXFER_ATTR_UIDGID)
     {
-        _attrs.owner = sftpBuffer.getInt();
-        _attrs.group = sftpBuffer.getInt();
+        _attrs.owner = packet.getInt();
+        _attrs.group = packet.getInt();
     }
 
     if (_attrs.flags & SSH2_FILEXFER_ATTR_PERMISSIONS)
     {
-        _attrs.permissions = sftpBuffer.getInt();
+        _attrs.permissions = packet.getInt();
     }
 
     if (_attrs.flags & SSH2_FILEXFER_ATTR_ACMODTIME)
     {
-        _attrs.atime = sftpBuffer.getInt();
-        _attrs.mtime = sftpBuffer.getInt();
+        _attrs.atime = packet.getInt();
+        _attrs.mtime = packet.getInt();
     }
 
     return true;
@@ -972,7 +982,7 @@ bool Ne7sshSftp::get(const char* remoteFile, FILE* localFile)
 {
     uint64 size;
     uint64 offset = 0;
-    Botan::SecureVector<Botan::byte> localBuffer;
+    ne7ssh_payload_vector localBuffer;
     uint32 fileID;
 
     if (!localFile)
@@ -1025,7 +1035,7 @@ bool Ne7sshSftp::put(FILE* localFile, const char* remoteFile)
 {
     size_t size;
     size_t offset = 0;
-    Botan::SecureVector<Botan::byte> localBuffer;
+    ne7ssh_payload_vector localBuffer;
     uint32 fileID;
     size_t len;
 
@@ -1231,10 +1241,10 @@ const char* Ne7sshSftp::ls(const char* remoteDir, bool longNames)
 {
     Ne7sshSftpPacket packet(_session->getSendChannel());
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    ne7ssh_string tmpVar;
-    SecureVector<Botan::byte> fileName;
+    ne7ssh_payload tmpVar;
+    const Botan::byte* fileName;
     bool status = true;
-    uint32 fileID, fileCount, i;
+    uint32 fileID, fileCount, i, len;
     sftpFile* remoteFile;
     if (!remoteDir)
     {
@@ -1282,24 +1292,33 @@ const char* Ne7sshSftp::ls(const char* remoteDir, bool longNames)
         return 0;
     }
 
-    packet.clear();
-    packet.addVector(_fileBuffer);
-    fileCount = packet.getInt();
+    ne7ssh_reader names(_fileBuffer, 0);
     tmpVar.clear();
-    for (i = 0; i < fileCount; i++)
+    // _fileBuffer holds one count prefixed block per NAME reply
+    while (names.remaining())
     {
-        packet.getString(fileName);
-        fileName += SecureVector<Botan::byte>((const Botan::byte*)"\n", 1);
-        if (!longNames)
+        fileCount = names.getInt();
+        for (i = 0; i < fileCount; i++)
         {
-            tmpVar.addVector(fileName);
-        }
+            if (!names.getString(fileName, len))
+            {
+                break;
+            }
+            if (!longNames)
+            {
+                tmpVar.addBytes(fileName, len);
+                tmpVar.addChar('\n');
+            }
 
-        packet.getString(fileName);
-        fileName += SecureVector<Botan::byte>((const Botan::byte*)"\n", 1);
-        if (longNames)
-        {
-            tmpVar.addVector(fileName);
+            if (!names.getString(fileName, len))
+            {
+                break;
+            }
+            if (longNames)
+            {
+                tmpVar.addBytes(fileName, len);
+                tmpVar.addChar('\n');
+            }
         }
     }
     _fileBuffer.swap(tmpVar.value());
@@ -1315,8 +1334,8 @@ bool Ne7sshSftp::cd(const char* remoteDir)
 {
     Ne7sshSftpPacket packet(_session->getSendChannel());
     std::shared_ptr<ne7ssh_transport> transport = _session->_transport;
-    SecureVector<Botan::byte> fileName;
-    uint32 fileCount;
+    const Botan::byte* fileName;
+    uint32 fileCount, len;
     bool status;
     if (!remoteDir)
     {
@@ -1355,16 +1374,18 @@ bool Ne7sshSftp::cd(const char* remoteDir)
         return false;
     }
 
-    packet.clear();
-    packet.addVector(_fileBuffer);
-    fileCount = packet.getInt();
+    ne7ssh_reader names(_fileBuffer, 0);
+    fileCount = names.getInt();
     if (!fileCount)
     {
         return false;
     }
-    packet.getString(fileName);
+    if (!names.getString(fileName, len))
+    {
+        return false;
+    }
 
-    _currentPath.assign((char*)fileName.begin(), fileName.size());
+    _currentPath.assign((const char*)fileName, len);
     return status;
 }
 
@@ -109,8 +109,8 @@ private:
     uint32 _timeout;
     uint32 _seq;
     uint8 _sftpCmd;
-    ne7ssh_string _commBuffer;
-    Botan::SecureVector<Botan::byte> _fileBuffer;
+    ne7ssh_payload _commBuffer;
+    ne7ssh_payload_vector _fileBuffer;
     enum writeMode { READ, OVERWRITE, APPEND };
     uint8 _lastError;
     std::string _currentPath;
@@ -143,45 +143,45 @@ private:
 
     /**
     * Replacement for ne7ssh_channel handleData method. Processes SFTP specific packets.
-    * @param packet Reference to the newly received packet.
+    * @param packet Reference to a reader positioned after the CHANNEL_DATA command byte.
     * @return True if data successfully processed. False on any error.
     */
-    bool handleData(Botan::SecureVector<Botan::byte>& packet);
+    bool handleData(ne7ssh_reader& packet);
 
     /**
     * Processes the VERSION packet received from the server.
-    * @param packet VERSION packet.
+    * @param packet Reader positioned at the payload of the VERSION packet.
     * @return True if processing successful, otherwise false.
     */
-    bool handleVersion(Botan::SecureVector<Botan::byte>& packet);
+    bool handleVersion(ne7ssh_reader& packet);
 
     /**
     * Processes the STATUS packet received from the server.
-    * @param packet STATUS packet.
+    * @param packet Reader positioned at the payload of the STATUS packet.
     * @return True if processing successful, otherwise false.
     */
-    bool handleStatus(Botan::SecureVector<Botan::byte>& packet);
+    bool handleStatus(ne7ssh_reader& packet);
 
     /**
     * Method to add a new file to sftpFiles variable from the HANDLE packet.
-    * @param packet HANDLE packet.
+    * @param packet Reader positioned at the payload of the HANDLE packet.
     * @return True if processing successful, otherwise false.
     */
-    bool addOpenHandle(Botan::SecureVector<Botan::byte>& packet);
+    bool addOpenHandle(ne7ssh_reader& packet);
 
     /**
     * Method to process DATA packets.
-    * @param packet DATA packet.
+    * @param packet Reader positioned at the payload of the DATA packet.
     * @return True if processing successful, otherwise false.
     */
-    bool handleSftpData(Botan::SecureVector<Botan::byte>& packet);
+    bool handleSftpData(ne7ssh_reader& packet);
 
     /**
     * Method to process NAME packets.
-    * @param packet NAME packet.
+    * @param packet Reader positioned at the payload of the NAME packet.
     * @return True if processing successful, otherwise false.
     */
-    bool handleNames(Botan::SecureVector<Botan::byte>& packet);
+    bool handleNames(ne7ssh_reader& packet);
 
     /**
     * This method is used to get a pointer to currently open file stored in sftpFile structure.
@@ -208,10 +208,10 @@ private:
 
     /**
     * Method to process ATTRS packet.
-    * @param packet ATTRS packet.
+    * @param packet Reader positioned at the payload of the ATTRS packet.
     * @return True if processing successful, otherwise false.
     */
-    bool processAttrs(Botan::SecureVector<Botan::byte>& packet);
+    bool processAttrs(ne7ssh_reader& packet);
 
     /**
     * Low level method to request file attributes.
@@ -51,6 +51,7 @@ Botan::SecureVector<Botan::byte> &Ne7sshSftpPacket::value()
         return _buffer;
     }
 
+    tmpVar.reserve(1 + 3 * sizeof(uint32) + _buffer.size());
     tmpVar.addChar(SSH2_MSG_CHANNEL_DATA);
     tmpVar.addInt(_channel);
     tmpVar.addInt(sizeof(uint32) + _buffer.size());
@@ -70,6 +71,7 @@ Botan::SecureVector<Botan::byte> Ne7sshSftpPacket::valueFragment(uint32 len)
         return Botan::SecureVector<Botan::byte>();
     }
 
+    tmpVar.reserve(1 + 3 * sizeof(uint32) + _buffer.size());
     tmpVar.addChar(SSH2_MSG_CHANNEL_DATA);
     tmpVar.addInt(_channel);
     if (len)
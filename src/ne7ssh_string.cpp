@@ -15,6 +15,7 @@
  ***************************************************************************/
 
 #include "ne7ssh_string.h"
+#include "ne7ssh_payload.h"
 #include "ne7ssh.h"
 #if !defined(WIN32) && !defined(__MINGW32__)
 #   include <arpa/inet.h>
@@ -47,14 +48,24 @@ ne7ssh_string::~ne7ssh_string()
 {
 }
 
+void ne7ssh_string::reserve(uint32 len)
+{
+    ne7ssh_payload::reserve(_buffer, _capacity, len);
+}
+
+Botan::byte* ne7ssh_string::grow(uint32 len)
+{
+    return ne7ssh_payload::grow(_buffer, _capacity, len);
+}
+
 void ne7ssh_string::addString(const char* str)
 {
-    Botan::byte* value = (Botan::byte*) str;
-    size_t len = strlen(str);
-    uint32 nLen = htonl((long) len);
+    uint32 len = strlen(str);
+    uint32 nLen = htonl(len);
+    Botan::byte* out = grow(sizeof(uint32) + len);
 
-    _buffer += SecureVector<Botan::byte>((Botan::byte*)&nLen, sizeof(uint32));
-    _buffer += SecureVector<Botan::byte>(value, (u32bit)len);
+    memcpy(out, &nLen, sizeof(uint32));
+    memcpy(out + sizeof(uint32), str, len);
 }
 
 bool ne7ssh_string::addFile(const char* filename)
@@ -72,51 +83,63 @@ bool ne7ssh_string::addFile(const char* filename)
     size = ftell(FI);
     rewind(FI);
 
-    std::unique_ptr<Botan::byte> data(new Botan::byte[size]);
-    fread(data.get(), size, 1, FI);
+    fread(grow(size), size, 1, FI);
     fclose(FI);
-    _buffer += SecureVector<Botan::byte>(data.get(), (u32bit)size);
     return true;
 }
 
 void ne7ssh_string::addBigInt(const Botan::BigInt& bn)
 {
-    SecureVector<Botan::byte> converted;
-    bn2vector(converted, bn);
-    uint32 nLen = htonl(converted.size());
+    uint32 len = bn.bytes();
+    uint32 high = (len && (bn.byte_at(len - 1) & 0x80)) ? 1 : 0;
+    uint32 nLen = htonl(len + high);
+    Botan::byte* out = grow(sizeof(uint32) + high + len);
 
-    _buffer += SecureVector<Botan::byte>((Botan::byte*)&nLen, sizeof(uint32));
-    _buffer += SecureVector<Botan::byte>(converted);
+    memcpy(out, &nLen, sizeof(uint32));
+    if (high)
+    {
+        out[sizeof(uint32)] = 0;
+    }
+    if (len)
+    {
+        BigInt::encode(out + sizeof(uint32) + high, bn);
+    }
 }
 
 void ne7ssh_string::addVectorField(const Botan::SecureVector<Botan::byte> &vector)
 {
     uint32 nLen = htonl(vector.size());
+    Botan::byte* out = grow(sizeof(uint32) + vector.size());
 
-    _buffer += SecureVector<Botan::byte>((Botan::byte*)&nLen, sizeof(uint32));
-    _buffer += vector;
+    memcpy(out, &nLen, sizeof(uint32));
+    memcpy(out + sizeof(uint32), vector.begin(), vector.size());
 }
 
 void ne7ssh_string::addBytes(const Botan::byte* buff, uint32 len)
 {
-    _buffer += SecureVector<Botan::byte>(buff, len);
+    memcpy(grow(len), buff, len);
 }
 
 void ne7ssh_string::addVector(Botan::SecureVector<Botan::byte> &secvec)
 {
-    _buffer += SecureVector<Botan::byte>(secvec.begin(), secvec.size());
+    memcpy(grow(secvec.size()), secvec.begin(), secvec.size());
+}
+
+void ne7ssh_string::addZeros(uint32 len)
+{
+    memset(grow(len), 0x00, len);
 }
 
 void ne7ssh_string::addChar(const char ch)
 {
-    _buffer += SecureVector<Botan::byte>((Botan::byte*)&ch, 1);
+    *grow(1) = (Botan::byte)ch;
 }
 
 void ne7ssh_string::addInt(const uint32 var)
 {
     uint32 nVar = htonl(var);
 
-    _buffer += SecureVector<Botan::byte>((Botan::byte*)&nVar, sizeof(uint32));
+    memcpy(grow(sizeof(uint32)), &nVar, sizeof(uint32));
 }
 
 bool ne7ssh_string::getString(Botan::SecureVector<Botan::byte>& result)
@@ -211,8 +234,7 @@ char* ne7ssh_string::nextPart()
 
 void ne7ssh_string::chop(uint32 nBytes)
 {
-    SecureVector<Botan::byte> tmpVar(_buffer);
-    _buffer = SecureVector<Botan::byte>(tmpVar.begin(), tmpVar.size() - nBytes);
+    _buffer.resize(_buffer.size() - nBytes);
 }
 
 void ne7ssh_string::bn2vector(Botan::SecureVector<Botan::byte>& result, const Botan::BigInt& bi)
@@ -18,6 +18,7 @@
 #define NE7SSH_STRING_H
 
 #include "ne7ssh_types.h"
+#include "ne7ssh_payload.h"
 #include <botan/bigint.h>
 
 /**
@@ -28,6 +29,14 @@ class ne7ssh_string
 private:
     std::vector<Botan::byte*> _positions;
     uint32 _currentPart;
+    ne7ssh_capacity _capacity;
+
+    /**
+     * Extends the buffer by len bytes, growing the allocation geometrically.
+     * @param len Number of bytes to append.
+     * @return Pointer to the first appended byte, to be filled in by the caller.
+     */
+    Botan::byte* grow(uint32 len);
 
 protected:
     Botan::SecureVector<Botan::byte> _buffer;
@@ -67,6 +76,13 @@ public:
         _buffer.clear();
     }
 
+    /**
+     * Makes sure the buffer can take len more bytes without reallocating.
+     * <p>Used to size a packet once before its fields are added.
+     * @param len Number of bytes about to be added.
+     */
+    void reserve(uint32 len);
+
     /**
      * Adds a string to the buffer.
      * <p>Adds an integer representing the length of the string, converted to the network format, before the actual string data.
@@ -103,6 +119,12 @@ public:
      */
     void addVectorField(const Botan::SecureVector<Botan::byte>& vector);
 
+    /**
+     * Adds a run of zero bytes to the buffer, as used for packet padding.
+     * @param len Number of zero bytes to add.
+     */
+    void addZeros(uint32 len);
+
     /**
      * Adds a single character to the buffer.
      * @param ch a single character.
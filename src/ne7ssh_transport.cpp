@@ -17,6 +17,8 @@
 #include "ne7ssh_transport.h"
 #include "ne7ssh.h"
 #include "ne7ssh_session.h"
+#include "ne7ssh_impl.h"
+#include "ne7ssh_kex.h"
 
 #if defined(WIN32) || defined(__MINGW32__)
 #   define SOCKET_BUFFER_TYPE char
@@ -130,8 +132,15 @@ ne7ssh_transport::ne7ssh_transport(std::shared_ptr<ne7ssh_session> session)
     : _seq(0),
     _rSeq(0),
     _session(session),
-    _sock((SOCKET)-1)
+    _sock((SOCKET)-1),
+    _rekeyState(REKEY_IDLE),
+    _rekeyBytes(0),
+    _rekeyPackets(0),
+    _rekeyTime(std::chrono::steady_clock::now())
 {
+    // Sized once for the largest packet, MemoryRegion keeps the allocation when resized down
+    _inBuffer.resize(MAX_PACKET_LEN + 256);
+    _inBuffer.resize(0);
 }
 
 ne7ssh_transport::~ne7ssh_transport()
@@ -350,13 +359,16 @@ bool ne7ssh_transport::send(Botan::SecureVector<Botan::byte>& buffer)
 
 bool ne7ssh_transport::receive(Botan::SecureVector<Botan::byte>& buffer)
 {
-    Botan::byte in_buffer[MAX_PACKET_LEN];
+    uint32 used = buffer.size();
     int len = 0;
 
+    // Receive straight into the tail of the buffer
+    buffer.resize(used + MAX_PACKET_LEN);
     if (wait(_sock, 0))
     {
-        len = ::recv(_sock, (char*)in_buffer, MAX_PACKET_LEN, 0);
+        len = ::recv(_sock, (char*)(buffer.begin() + used), MAX_PACKET_LEN, 0);
     }
+    buffer.resize(used + ((len > 0) ? len : 0));
 
     if (!len)
     {
@@ -376,60 +388,81 @@ bool ne7ssh_transport::receive(Botan::SecureVector<Botan::byte>& buffer)
         return false;
     }
 
-    buffer += SecureVector<Botan::byte>(in_buffer, len);
-
     return true;
 }
 
 bool ne7ssh_transport::sendPacket(Botan::SecureVector<Botan::byte> &buffer)
+{
+    return sendPacket(buffer.begin(), buffer.size());
+}
+
+bool ne7ssh_transport::sendPacket(const Botan::byte* payload, uint32 length)
 {
     std::shared_ptr<ne7ssh_crypt> crypto = _session->_crypto;
-    ne7ssh_string out;
     uint32 crypt_block;
+    uint32 lenFieldSize = sizeof(uint32);
     char padLen;
     uint32 packetLen;
-    uint32 length;
-    SecureVector<Botan::byte> crypted, hmac;
 
-// No Zlib support right now
-//  if (crypto->isInited()) crypto->compressData (buffer);
-    length = buffer.size();
+    // Whichever packet finds a limit reached starts re-keying, the exchange then moves on as its replies arrive.
+    // Until 'NEWKEYS' is sent only transport messages may go out, others are held back without blocking the caller.
+    if (crypto->isInited() && length && (payload[0] >= SSH2_MSG_USERAUTH_REQUEST))
+    {
+        if ((_rekeyState == REKEY_IDLE) && rekeyDue() && !startRekey())
+        {
+            return false;
+        }
+        if ((_rekeyState == REKEY_INIT_SENT) || (_rekeyState == REKEY_DH_SENT))
+        {
+            _held.push_back(Botan::SecureVector<Botan::byte>(payload, length));
+            return true;
+        }
+    }
+
+    // Padding is computed over the compressed payload, _deflated keeps its allocation like _out
+    if (crypto->isInited() && crypto->isCompressedOut())
+    {
+        if (!crypto->compressData(_deflated, payload, length))
+        {
+            return false;
+        }
+        payload = _deflated.begin();
+        length = _deflated.size();
+    }
 
     crypt_block = crypto->getEncryptBlock();
     if (!crypt_block)
     {
         crypt_block = 8;
     }
+    // AEAD ciphers and encrypt-then-MAC handle the length field separately, it does not count towards the block size
+    if (crypto->isInited() && crypto->isAadOut())
+    {
+        lenFieldSize = 0;
+    }
 
-    padLen = (char)(3 + crypt_block - ((length + 8) % crypt_block));
+    padLen = (char)(3 + crypt_block - ((length + 1 + 3 + lenFieldSize) % crypt_block));
     packetLen = 1 + length + padLen;
 
-    out.addInt(packetLen);
-    out.addChar(padLen);
-    out.addVector(buffer);
-
-    std::unique_ptr<Botan::byte> padBytes(new Botan::byte[padLen]);
-    memset(padBytes.get(), 0x00, padLen);
-    out.addBytes(padBytes.get(), padLen);
-    padBytes.reset();
+    // _out keeps its allocation between packets, with room for the HMAC appended on encryption
+    _out.clear();
+    _out.reserve(sizeof(uint32) + packetLen + crypto->getMacOutLen());
+    _out.addInt(packetLen);
+    _out.addChar(padLen);
+    _out.addBytes(payload, length);
+    _out.addZeros(padLen);
 
-    if (crypto->isInited())
+    if (crypto->isInited() && !crypto->encryptPacket(_out.value(), _seq))
     {
-        if (!crypto->encryptPacket(crypted, hmac, out.value(), _seq))
-        {
-            ne7ssh::errors()->push(_session->getSshChannel(), "Failure to encrypt the payload.");
-            return false;
-        }
-        crypted += hmac;
-        if (!send(crypted))
-        {
-            return false;
-        }
+        ne7ssh::errors()->push(_session->getSshChannel(), "Failure to encrypt the payload.");
+        return false;
     }
-    else if (!send(out.value()))
+    if (!send(_out.value()))
     {
         return false;
     }
+    _rekeyBytes += _out.length();
+    _rekeyPackets++;
     if (_seq == MAX_SEQUENCE)
     {
         _seq = 0;
@@ -445,7 +478,8 @@ short ne7ssh_transport::waitForPacket(Botan::byte command, bool bufferOnly)
 {
     std::shared_ptr<ne7ssh_crypt> crypto = _session->_crypto;
     Botan::byte cmd;
-    SecureVector<Botan::byte> decrypted;
+    ne7ssh_pooled_buffer decryptedBuffer(_session->_pool, MAX_PACKET_LEN);
+    SecureVector<Botan::byte>& decrypted = decryptedBuffer.value();
     ne7ssh_packet packet(&_in);
     uint32 cryptoLen = 0;
     int macLen = 0;
@@ -465,14 +499,40 @@ short ne7ssh_transport::waitForPacket(Botan::byte command, bool bufferOnly)
             }
         }
     }
-    if ((crypto->isInited() == true) && (_in.size() >= crypto->getDecryptBlock()))
+    if ((crypto->isInited() == true) && crypto->isAadIn())
+    {
+        // Length field is read on its own, the packet is decrypted only once complete and authenticated
+        macLen = crypto->getMacInLen();
+    }
+    else if ((crypto->isInited() == true) && (_in.size() >= crypto->getDecryptBlock()))
     {
-        crypto->decryptPacket(decrypted, _in, crypto->getDecryptBlock());
+        if (!crypto->decryptPacket(decrypted, _in, crypto->getDecryptBlock()))
+        {
+            return -1;
+        }
         packet = &decrypted;
         macLen = crypto->getMacInLen();
     }
-    cryptoLen = packet.getCryptoLength();
-    if ((bufferOnly == false) || ((crypto->isInited() == true) && (packet.getCommand() > 0) && (packet.getCommand() < 0xff)))
+    if ((crypto->isInited() == true) && crypto->isAadIn())
+    {
+        if (_in.size() >= sizeof(uint32))
+        {
+            // The length is not authenticated yet, it is checked before anything is buffered for it
+            cryptoLen = crypto->getAadPacketLength(_in.begin(), _rSeq);
+            if ((cryptoLen < 5) || (cryptoLen > (MAX_PACKET_LEN - sizeof(uint32))) || (cryptoLen % crypto->getDecryptBlock()))
+            {
+                ne7ssh::errors()->push(_session->getSshChannel(), "Bad packet length %ui.", cryptoLen);
+                return -1;
+            }
+            cryptoLen += sizeof(uint32);
+        }
+    }
+    else
+    {
+        cryptoLen = packet.getCryptoLength();
+    }
+    if ((bufferOnly == false) || ((crypto->isInited() == true) && crypto->isAadIn() && cryptoLen) ||
+        ((crypto->isInited() == true) && (packet.getCommand() > 0) && (packet.getCommand() < 0xff)))
     {
         while ((cryptoLen + macLen) > _in.size())
         {
@@ -483,21 +543,33 @@ short ne7ssh_transport::waitForPacket(Botan::byte command, bool bufferOnly)
         }
     }
 
-    if (crypto->isInited() == true)
+    if ((crypto->isInited() == true) && crypto->isAadIn())
+    {
+        if (cryptoLen && (_in.size() >= (cryptoLen + macLen)))
+        {
+            if (!crypto->decryptAadPacket(decrypted, _in.begin(), cryptoLen, _rSeq))
+            {
+                ne7ssh::errors()->push(_session->getSshChannel(), "Mismatched HMACs.");
+                return -1;
+            }
+            packet = &decrypted;
+            cryptoLen += macLen;
+        }
+    }
+    else if (crypto->isInited() == true)
     {
         if (cryptoLen > crypto->getDecryptBlock())
         {
-            SecureVector<Botan::byte> tmpVar;
-            tmpVar = SecureVector<Botan::byte>(_in.begin() + crypto->getDecryptBlock(), (cryptoLen - crypto->getDecryptBlock()));
-            crypto->decryptPacket(tmpVar, tmpVar, tmpVar.size());
-            decrypted += tmpVar;
+            ne7ssh_pooled_buffer tmpVar(_session->_pool, cryptoLen - crypto->getDecryptBlock());
+            if (!crypto->decryptPacket(tmpVar.value(), _in.begin() + crypto->getDecryptBlock(), cryptoLen - crypto->getDecryptBlock()))
+            {
+                return -1;
+            }
+            decrypted += tmpVar.value();
         }
         if (crypto->getMacInLen() && (_in.size() > 0) && (_in.size() >= (cryptoLen + crypto->getMacInLen())))
         {
-            SecureVector<Botan::byte> ourMac, hMac;
-            crypto->computeMac(ourMac, decrypted, _rSeq);
-            hMac = SecureVector<Botan::byte>(_in.begin() + cryptoLen, crypto->getMacInLen());
-            if (hMac != ourMac)
+            if (!crypto->verifyMac(decrypted.begin(), decrypted.size(), _in.begin() + cryptoLen, _rSeq))
             {
                 ne7ssh::errors()->push(_session->getSshChannel(), "Mismatched HMACs.");
                 return -1;
@@ -509,22 +581,38 @@ short ne7ssh_transport::waitForPacket(Botan::byte command, bool bufferOnly)
     {
         decrypted = _in;
     }
+    if ((decrypted.empty() == false) && crypto->isInited() && crypto->isCompressedIn())
+    {
+        if (!inflatePacket(decrypted))
+        {
+            return -1;
+        }
+    }
     if (decrypted.empty() == false)
     {
         _rSeq++;
         cmd = packet.getCommand();
-        if ((command == cmd) || (command == 0))
+        if (crypto->isInited() && ((cmd == SSH2_MSG_KEXINIT) ||
+                                   ((_rekeyState != REKEY_IDLE) && ((cmd == SSH2_MSG_KEXDH_REPLY) || (cmd == SSH2_MSG_NEWKEYS)))))
         {
-            _inBuffer = decrypted;
-            if (_in.size() == cryptoLen)
+            keepPacket(decrypted);
+            consume(cryptoLen);
+            if (!handleRekey(cmd))
             {
-                _in.clear();
+                return -1;
             }
-            else
+            // Re-keying is not seen by the caller. While the exchange runs its next packet is on the way,
+            // once it is over a caller taking any packet only gets what is already buffered.
+            return waitForPacket(command, bufferOnly || ((command == 0) && (_rekeyState == REKEY_IDLE)));
+        }
+        if ((command == cmd) || (command == 0))
+        {
+            keepPacket(decrypted);
+            consume(cryptoLen);
+            // Received traffic and the time limit count too, a session that mostly reads would never re-key otherwise
+            if (crypto->isInited() && (_rekeyState == REKEY_IDLE) && rekeyDue() && !startRekey())
             {
-                SecureVector<Botan::byte> tmpVar;
-                tmpVar.swap(_in);
-                _in = SecureVector<Botan::byte>(tmpVar.begin() + cryptoLen, tmpVar.size() - cryptoLen);
+                return -1;
             }
             return cmd;
         }
@@ -537,6 +625,165 @@ short ne7ssh_transport::waitForPacket(Botan::byte command, bool bufferOnly)
     return command;
 }
 
+void ne7ssh_transport::keepPacket(const Botan::SecureVector<Botan::byte>& packet)
+{
+    // Copied rather than swapped, the pooled buffer goes back to the pool with its allocation
+    _inBuffer.resize(packet.size());
+    memcpy(_inBuffer.begin(), packet.begin(), packet.size());
+}
+
+void ne7ssh_transport::consume(uint32 len)
+{
+    _rekeyBytes += len;
+    _rekeyPackets++;
+    if (_in.size() <= len)
+    {
+        _in.clear();
+    }
+    else
+    {
+        memmove(_in.begin(), _in.begin() + len, _in.size() - len);
+        _in.resize(_in.size() - len);
+    }
+}
+
+bool ne7ssh_transport::rekeyDue()
+{
+    if (ne7ssh_impl::REKEY_BYTES && (_rekeyBytes >= ne7ssh_impl::REKEY_BYTES))
+    {
+        return true;
+    }
+    if (ne7ssh_impl::REKEY_PACKETS && (_rekeyPackets >= ne7ssh_impl::REKEY_PACKETS))
+    {
+        return true;
+    }
+    if (ne7ssh_impl::REKEY_SECONDS && (std::chrono::steady_clock::now() - _rekeyTime >= std::chrono::seconds(ne7ssh_impl::REKEY_SECONDS)))
+    {
+        return true;
+    }
+    return false;
+}
+
+bool ne7ssh_transport::startRekey()
+{
+    // Negotiation and new keys go into a separate object, the current keys stay in use until 'NEWKEYS'
+    _nextCrypto.reset(new ne7ssh_crypt(_session));
+    _rekey.reset(new ne7ssh_kex(_session, _nextCrypto));
+    _rekeyState = REKEY_INIT_SENT;
+    return _rekey->sendLocalInit();
+}
+
+bool ne7ssh_transport::handleRekey(Botan::byte cmd)
+{
+    std::shared_ptr<ne7ssh_crypt> crypto = _session->_crypto;
+    Botan::byte newKeys = SSH2_MSG_NEWKEYS;
+
+    switch (cmd)
+    {
+        case SSH2_MSG_KEXINIT:
+            // Server initiated, or the reply to ours
+            if ((_rekeyState == REKEY_IDLE) && !startRekey())
+            {
+                return false;
+            }
+            if (_rekeyState != REKEY_INIT_SENT)
+            {
+                ne7ssh::errors()->push(_session->getSshChannel(), "Unexpected key exchange init during re-keying.");
+                return false;
+            }
+            if (!_rekey->handleInit() || !_rekey->sendKexDHPublic())
+            {
+                return false;
+            }
+            _rekeyState = REKEY_DH_SENT;
+            return true;
+
+        case SSH2_MSG_KEXDH_REPLY:
+            if (_rekeyState != REKEY_DH_SENT)
+            {
+                ne7ssh::errors()->push(_session->getSshChannel(), "Unexpected key exchange dh reply during re-keying.");
+                return false;
+            }
+            if (!_rekey->handleKexDHReply())
+            {
+                return false;
+            }
+            if (!_nextCrypto->makeNewKeys())
+            {
+                ne7ssh::errors()->push(_session->getSshChannel(), "Could not make keys.");
+                return false;
+            }
+            if (!sendPacket(&newKeys, 1))
+            {
+                return false;
+            }
+            crypto->switchKeysOut(*_nextCrypto);
+            _rekeyState = REKEY_NEWKEYS_SENT;
+            while (!_held.empty())
+            {
+                if (!sendPacket(_held.front()))
+                {
+                    return false;
+                }
+                _held.pop_front();
+            }
+            return true;
+
+        case SSH2_MSG_NEWKEYS:
+            if (_rekeyState != REKEY_NEWKEYS_SENT)
+            {
+                ne7ssh::errors()->push(_session->getSshChannel(), "Unexpected newkeys during re-keying.");
+                return false;
+            }
+            crypto->switchKeysIn(*_nextCrypto);
+            _rekey.reset();
+            _nextCrypto.reset();
+            _rekeyState = REKEY_IDLE;
+            _rekeyBytes = 0;
+            _rekeyPackets = 0;
+            _rekeyTime = std::chrono::steady_clock::now();
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool ne7ssh_transport::inflatePacket(Botan::SecureVector<Botan::byte>& decrypted)
+{
+    std::shared_ptr<ne7ssh_crypt> crypto = _session->_crypto;
+    ne7ssh_packet packet(&decrypted);
+    ne7ssh_pooled_buffer inflatedBuffer(_session->_pool, MAX_PACKET_LEN);
+    SecureVector<Botan::byte>& inflated = inflatedBuffer.value();
+    uint32 packetLen = packet.getPacketLength();
+    Botan::byte padLen = packet.getPadLength();
+    uint32 len;
+
+    if ((packetLen < (uint32)padLen + 1) || (decrypted.size() < sizeof(uint32) + packetLen))
+    {
+        ne7ssh::errors()->push(_session->getSshChannel(), "Malformed compressed packet.");
+        return false;
+    }
+    if (!crypto->decompressData(inflated, decrypted.begin() + NE7SSH_PACKET_PAYLOAD_OFFS, packetLen - padLen - 1))
+    {
+        return false;
+    }
+
+    // Rebuilt without padding, the rest of the receive path sees an ordinary packet
+    len = inflated.size() + 1;
+    decrypted.resize(NE7SSH_PACKET_PAYLOAD_OFFS + inflated.size());
+    decrypted[0] = (Botan::byte)(len >> 24);
+    decrypted[1] = (Botan::byte)(len >> 16);
+    decrypted[2] = (Botan::byte)(len >> 8);
+    decrypted[3] = (Botan::byte)len;
+    decrypted[4] = 0;
+    if (inflated.size())
+    {
+        memcpy(decrypted.begin() + NE7SSH_PACKET_PAYLOAD_OFFS, inflated.begin(), inflated.size());
+    }
+    return true;
+}
+
 uint32 ne7ssh_transport::getPacket(Botan::SecureVector<Botan::byte> &result)
 {
     std::shared_ptr<ne7ssh_crypt> crypto = _session->_crypto;
@@ -544,6 +791,7 @@ uint32 ne7ssh_transport::getPacket(Botan::SecureVector<Botan::byte> &result)
     uint32 len = packet.getPacketLength();
     Botan::byte padLen = packet.getPadLength();
     uint32 macLen = crypto->getMacInLen();
+    uint32 available;
 
     if (_inBuffer.empty())
     {
@@ -560,9 +808,18 @@ uint32 ne7ssh_transport::getPacket(Botan::SecureVector<Botan::byte> &result)
         }
     }
 
-    _inBuffer += SecureVector<Botan::byte>((Botan::byte*)"\0", 1);
-    result = SecureVector<Botan::byte>(packet.getPayload(), len);
-    crypto->decompressData(result);
+    // The length field covers the padding length byte too, so the copy may run one byte past the packet.
+    available = (_inBuffer.size() > NE7SSH_PACKET_PAYLOAD_OFFS) ? _inBuffer.size() - NE7SSH_PACKET_PAYLOAD_OFFS : 0;
+    if (available > len)
+    {
+        available = len;
+    }
+    result.resize(len);
+    if (available)
+    {
+        memcpy(result.begin(), packet.getPayload(), available);
+    }
+    memset(result.begin() + available, 0x00, len - available);
 
     _inBuffer.clear();
     return padLen;
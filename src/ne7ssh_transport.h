@@ -18,12 +18,15 @@
 #define NE7SSH_TRANSPORT_H
 
 #include "ne7ssh_types.h"
+#include "ne7ssh_string.h"
 #include <botan/secmem.h>
 #if defined(WIN32) || defined(__MINGW32__)
 #   include <winsock.h>
 #endif
 #include <sys/types.h>
 #include <memory>
+#include <deque>
+#include <chrono>
 
 //#define MAX_PACKET_LEN 35000
 #define MAX_PACKET_LEN 34816
@@ -34,6 +37,8 @@
 #endif
 
 class ne7ssh_session;
+class ne7ssh_crypt;
+class ne7ssh_kex;
 
 /**
 @author Andrew Useckas
@@ -47,6 +52,50 @@ private:
     SOCKET _sock;
     Botan::SecureVector<Botan::byte> _in;
     Botan::SecureVector<Botan::byte> _inBuffer;
+    ne7ssh_string _out;
+    Botan::SecureVector<Botan::byte> _deflated;
+
+    enum rekeyStates { REKEY_IDLE, REKEY_INIT_SENT, REKEY_DH_SENT, REKEY_NEWKEYS_SENT };
+    uint32 _rekeyState;
+    std::unique_ptr<ne7ssh_kex> _rekey;
+    std::shared_ptr<ne7ssh_crypt> _nextCrypto;
+    std::deque<Botan::SecureVector<Botan::byte> > _held;
+    uint64 _rekeyBytes;
+    uint32 _rekeyPackets;
+    std::chrono::steady_clock::time_point _rekeyTime;
+
+    /**
+     * Checks the data, packet and time limits set with ne7ssh::setRekeyLimits() against the traffic since the last key exchange.
+     * @return True if a limit has been reached, otherwise false is returned.
+     */
+    bool rekeyDue();
+
+    /**
+     * Starts a re-keying exchange by sending 'KEX_INIT'. The exchange continues as its packets are received.
+     * @return True if successful, otherwise false is returned.
+     */
+    bool startRekey();
+
+    /**
+     * Takes the next step of a re-keying exchange, after one of its packets was received into inBuffer.
+     * <p> Client to server keys change once 'NEWKEYS' is sent, and the packets held back meanwhile are sent. Server to client keys change once 'NEWKEYS' is received.
+     * @param cmd The received packet type.
+     * @return True if successful, otherwise false is returned.
+     */
+    bool handleRekey(Botan::byte cmd);
+
+    /**
+     * Copies a decrypted packet into inBuffer, where getPacket() reads it from.
+     * <p> inBuffer is allocated once for the largest packet, so this does not allocate.
+     * @param packet The decrypted packet.
+     */
+    void keepPacket(const Botan::SecureVector<Botan::byte>& packet);
+
+    /**
+     * Removes a processed packet from the receive buffer.
+     * @param len Length of the packet, including the HMAC.
+     */
+    void consume(uint32 len);
 
     /**
      * Switches socket's NonBlocking option on or off.
@@ -108,16 +157,32 @@ public:
      */
     bool sendPacket(Botan::SecureVector<Botan::byte>& buffer);
 
+    /**
+     * Same as above, but takes the payload as a byte stream, so it can be built outside of secure memory.
+     * @param payload Pointer to the payload to be sent.
+     * @param length Length of the payload.
+     * @return True if send successful, otherwise false is returned.
+     */
+    bool sendPacket(const Botan::byte* payload, uint32 length);
+
     /**
      * Waits until specified type of packet is received.
      * <p> If cmd is 0, waits for the first available packet of any kind.
      * <p> Once the desired packet is received, it is decrypted / decommpressed, the hMac is checked, and dropped into inBuffer class variable.
+     * <p> Once a limit set with ne7ssh::setRekeyLimits() is reached, re-keying starts here as it does in sendPacket().
      * @param cmd SSH2 packet to wait for. If 0, first available packet will be read into inBuffer class variable.
      * @param bufferOnly Does not wait to receive a new packet, only checks existing receive buffer for unprocessed packets.
      * @return 1 if desired packet is received, 0 if there another packet is received, or -1 if HMAC checking is enabled, and remote and local HMACs do not match.
      */
     short waitForPacket(Botan::byte cmd, bool bufferOnly = false);
 
+    /**
+     * Replaces a decrypted, compressed packet with its decompressed form, with no padding.
+     * @param decrypted Reference to the decrypted packet, including the length field. Result will also be dumped into this var.
+     * @return True on success, otherwise false is returned.
+     */
+    bool inflatePacket(Botan::SecureVector<Botan::byte>& decrypted);
+
     /**
      * Gets the payload section from an SSH packet received by waitForPacket() function.
      * @param result The payload will be stored here.
@@ -0,0 +1,435 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_umac.h"
+#include <algorithm>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#   define NE7SSH_UMAC_SSE2
+#   include <emmintrin.h>
+#   include <botan/cpuid.h>
+#endif
+
+using namespace Botan;
+
+#define UMAC_BLOCK 16
+#define NH_BLOCK 32
+// Parallel hashes for the longest, 16 byte tag
+#define UMAC_MAX_STREAMS 4
+
+namespace
+{
+typedef void (*nh_fn)(const uint32* key, const Botan::byte* data, uint32 len, uint64* accum, uint32 streams);
+
+// 2^64 - 59, its complement and the largest word hashed without an escape
+const uint64 P64 = (uint64)0xffffffffffffffc5ULL;
+const uint64 P64_OFFSET = 59;
+const uint64 P64_MAXWORD = (uint64)0xffffffff00000000ULL;
+const uint64 POLY_KEY_MASK = (uint64)0x01ffffff01ffffffULL;
+// 2^36 - 5
+const uint64 P36 = (uint64)0x0000000ffffffffbULL;
+
+uint32 load32le(const Botan::byte* in)
+{
+    return (uint32)in[0] | ((uint32)in[1] << 8) | ((uint32)in[2] << 16) | ((uint32)in[3] << 24);
+}
+
+uint32 load32be(const Botan::byte* in)
+{
+    return ((uint32)in[0] << 24) | ((uint32)in[1] << 16) | ((uint32)in[2] << 8) | (uint32)in[3];
+}
+
+uint64 load64be(const Botan::byte* in)
+{
+    return ((uint64)load32be(in) << 32) | load32be(in + 4);
+}
+
+void store32be(Botan::byte* out, uint32 val)
+{
+    out[0] = (Botan::byte)(val >> 24);
+    out[1] = (Botan::byte)(val >> 16);
+    out[2] = (Botan::byte)(val >> 8);
+    out[3] = (Botan::byte)val;
+}
+
+void store64be(Botan::byte* out, uint64 val)
+{
+    store32be(out, (uint32)(val >> 32));
+    store32be(out + 4, (uint32)val);
+}
+
+// Full 64 x 64 bit multiplication, without relying on a 128 bit type
+void mul64(uint64 a, uint64 b, uint64& hi, uint64& lo)
+{
+    uint64 aLo = (uint32)a, aHi = a >> 32;
+    uint64 bLo = (uint32)b, bHi = b >> 32;
+    uint64 ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+    uint64 mid = (ll >> 32) + (uint32)lh + (uint32)hl;
+
+    lo = (mid << 32) | (uint32)ll;
+    hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+// (k * y + m) mod 2^64 - 59, only partially reduced: the result is below 2^64 but may exceed the prime
+uint64 polyMulAdd(uint64 k, uint64 y, uint64 m)
+{
+    uint64 hi, lo, sum;
+
+    mul64(k, y, hi, lo);
+    // k is below 2^57, so hi * 59 can not overflow
+    sum = lo + hi * P64_OFFSET;
+    if (sum < lo)
+    {
+        sum += P64_OFFSET;
+    }
+    lo = sum;
+    sum += m;
+    if (sum < lo)
+    {
+        sum += P64_OFFSET;
+    }
+    return sum;
+}
+
+void nhScalar(const uint32* key, const Botan::byte* data, uint32 len, uint64* accum, uint32 streams)
+{
+    uint32 m[8];
+    const uint32* k;
+    uint32 i, s;
+
+    for (; len; len -= NH_BLOCK, data += NH_BLOCK, key += 8)
+    {
+        for (i = 0; i < 8; i++)
+        {
+            m[i] = load32le(data + 4 * i);
+        }
+        for (s = 0; s < streams; s++)
+        {
+            k = key + 4 * s;
+            accum[s] += (uint64)(m[0] + k[0]) * (m[4] + k[4]);
+            accum[s] += (uint64)(m[1] + k[1]) * (m[5] + k[5]);
+            accum[s] += (uint64)(m[2] + k[2]) * (m[6] + k[6]);
+            accum[s] += (uint64)(m[3] + k[3]) * (m[7] + k[7]);
+        }
+    }
+}
+
+#ifdef NE7SSH_UMAC_SSE2
+// Two 32 x 32 bit products per multiply, lanes 0 and 2 then lanes 1 and 3.
+// Key words of stream s + 1 start 4 words after those of stream s, so consecutive streams share a key load.
+// The stream count is fixed at compile time, so the accumulators stay in registers.
+template<uint32 streams>
+void nhSse2Streams(const uint32* key, const Botan::byte* data, uint32 len, uint64* accum)
+{
+    __m128i acc[streams];
+    __m128i k[streams + 1];
+    __m128i mLo, mHi, a, b;
+    uint64 lanes[2];
+    uint32 s;
+
+    for (s = 0; s < streams; s++)
+    {
+        acc[s] = _mm_setzero_si128();
+    }
+    for (; len; len -= NH_BLOCK, data += NH_BLOCK, key += 8)
+    {
+        // Message words are little endian, as is every CPU with SSE2
+        mLo = _mm_loadu_si128((const __m128i*)data);
+        mHi = _mm_loadu_si128((const __m128i*)(data + 16));
+        for (s = 0; s <= streams; s++)
+        {
+            k[s] = _mm_loadu_si128((const __m128i*)(key + 4 * s));
+        }
+        for (s = 0; s < streams; s++)
+        {
+            a = _mm_add_epi32(mLo, k[s]);
+            b = _mm_add_epi32(mHi, k[s + 1]);
+            acc[s] = _mm_add_epi64(acc[s], _mm_mul_epu32(a, b));
+            acc[s] = _mm_add_epi64(acc[s], _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32)));
+        }
+    }
+    for (s = 0; s < streams; s++)
+    {
+        _mm_storeu_si128((__m128i*)lanes, acc[s]);
+        accum[s] += lanes[0] + lanes[1];
+    }
+}
+
+void nhSse2(const uint32* key, const Botan::byte* data, uint32 len, uint64* accum, uint32 streams)
+{
+    if (streams == 2)
+    {
+        nhSse2Streams<2>(key, data, len, accum);
+    }
+    else
+    {
+        nhSse2Streams<4>(key, data, len, accum);
+    }
+}
+#endif
+
+nh_fn selectNh()
+{
+#ifdef NE7SSH_UMAC_SSE2
+    if (CPUID::has_sse2())
+    {
+        return nhSse2;
+    }
+#endif
+    return nhScalar;
+}
+
+nh_fn& nh()
+{
+    static nh_fn fn = selectNh();
+    return fn;
+}
+}
+
+bool ne7ssh_umac::forceImplementation(implementations impl)
+{
+    switch (impl)
+    {
+        case AUTO:
+            nh() = selectNh();
+            return true;
+
+        case SCALAR:
+            nh() = nhScalar;
+            return true;
+
+#ifdef NE7SSH_UMAC_SSE2
+        case SSE2:
+            if (!CPUID::has_sse2())
+            {
+                return false;
+            }
+            nh() = nhSse2;
+            return true;
+#endif
+
+        default:
+            return false;
+    }
+}
+
+ne7ssh_umac::ne7ssh_umac(Botan::BlockCipher* cipher, const Botan::byte* key, uint32 tagLen)
+    : _cipher(cipher),
+    _tagLen(tagLen),
+    _streams(tagLen / 4),
+    _nhKey(NE7SSH_UMAC_L1_KEY_LEN / 4 + 4 * (tagLen / 4 - 1)),
+    _polyKey(tagLen / 4),
+    _polyAccum(tagLen / 4),
+    _l3Key1(8 * (tagLen / 4)),
+    _l3Key2(tagLen / 4),
+    _nhAccum(tagLen / 4),
+    _buffer(NH_BLOCK),
+    _pad(UMAC_BLOCK),
+    _padNonce(0),
+    _padValid(false)
+{
+    SecureVector<Botan::byte> subKey(NE7SSH_UMAC_L1_KEY_LEN + UMAC_BLOCK * (UMAC_MAX_STREAMS - 1));
+    uint32 i, s;
+
+    _cipher->set_key(key, NE7SSH_UMAC_KEY_LEN);
+
+    kdf(subKey.begin(), 1, NE7SSH_UMAC_L1_KEY_LEN + UMAC_BLOCK * (_streams - 1));
+    for (i = 0; i < NE7SSH_UMAC_L1_KEY_LEN / 4 + 4 * (_streams - 1); i++)
+    {
+        _nhKey[i] = load32be(subKey.begin() + 4 * i);
+    }
+
+    // Only the 64 bit half of each polynomial key is used, see NE7SSH_UMAC_MAX_LEN
+    kdf(subKey.begin(), 2, 24 * _streams);
+    for (s = 0; s < _streams; s++)
+    {
+        _polyKey[s] = load64be(subKey.begin() + 24 * s) & POLY_KEY_MASK;
+    }
+
+    kdf(subKey.begin(), 3, 64 * _streams);
+    for (i = 0; i < 8 * _streams; i++)
+    {
+        _l3Key1[i] = load64be(subKey.begin() + 8 * i) % P36;
+    }
+
+    kdf(subKey.begin(), 4, 4 * _streams);
+    for (s = 0; s < _streams; s++)
+    {
+        _l3Key2[s] = load32be(subKey.begin() + 4 * s);
+    }
+
+    // The pad is generated under a key of its own
+    kdf(subKey.begin(), 0, NE7SSH_UMAC_KEY_LEN);
+    _cipher->set_key(subKey.begin(), NE7SSH_UMAC_KEY_LEN);
+
+    reset();
+}
+
+void ne7ssh_umac::kdf(Botan::byte* out, uint64 index, uint32 len)
+{
+    Botan::byte block[UMAC_BLOCK];
+    uint64 i;
+    uint32 n;
+
+    for (i = 1; len; i++)
+    {
+        store64be(block, index);
+        store64be(block + 8, i);
+        _cipher->encrypt(block);
+        n = std::min<uint32>(len, UMAC_BLOCK);
+        memcpy(out, block, n);
+        out += n;
+        len -= n;
+    }
+    memset(block, 0, sizeof(block));
+}
+
+void ne7ssh_umac::reset()
+{
+    uint32 s;
+
+    for (s = 0; s < _streams; s++)
+    {
+        _nhAccum[s] = 0;
+        _polyAccum[s] = 1;
+    }
+    _buffered = 0;
+    _nhOffset = 0;
+    _longMessage = false;
+}
+
+void ne7ssh_umac::nhBlocks(const Botan::byte* data, uint32 len)
+{
+    nh()(_nhKey.begin() + _nhOffset / 4, data, len, _nhAccum.begin(), _streams);
+    _nhOffset += len;
+}
+
+void ne7ssh_umac::polyStep(uint32 stream, uint64 word)
+{
+    uint64 k = _polyKey[stream];
+    uint64& y = _polyAccum[stream];
+
+    if (word >= P64_MAXWORD)
+    {
+        y = polyMulAdd(k, y, P64 - 1);
+        y = polyMulAdd(k, y, word - P64_OFFSET);
+    }
+    else
+    {
+        y = polyMulAdd(k, y, word);
+    }
+}
+
+void ne7ssh_umac::nextChunk()
+{
+    uint32 s;
+
+    for (s = 0; s < _streams; s++)
+    {
+        polyStep(s, _nhAccum[s] + NE7SSH_UMAC_L1_KEY_LEN * 8);
+        _nhAccum[s] = 0;
+    }
+    _nhOffset = 0;
+    _longMessage = true;
+}
+
+void ne7ssh_umac::update(const Botan::byte* data, uint32 len)
+{
+    uint32 n;
+
+    while (len)
+    {
+        // A full chunk is only hashed further once it is known not to be the last one
+        if (_nhOffset == NE7SSH_UMAC_L1_KEY_LEN)
+        {
+            nextChunk();
+        }
+        if (_buffered || (len < NH_BLOCK))
+        {
+            n = std::min<uint32>(NH_BLOCK - _buffered, len);
+            memcpy(_buffer.begin() + _buffered, data, n);
+            _buffered += n;
+            data += n;
+            len -= n;
+            if (_buffered == NH_BLOCK)
+            {
+                nhBlocks(_buffer.begin(), NH_BLOCK);
+                _buffered = 0;
+            }
+            continue;
+        }
+        n = std::min<uint32>(len & ~(NH_BLOCK - 1), NE7SSH_UMAC_L1_KEY_LEN - _nhOffset);
+        nhBlocks(data, n);
+        data += n;
+        len -= n;
+    }
+}
+
+void ne7ssh_umac::final(Botan::byte* tag, uint64 nonce)
+{
+    uint64 bits = (uint64)(_nhOffset + _buffered) * 8;
+    uint64 y, sum;
+    const uint64* k;
+    uint32 s, idx = 0;
+
+    // An empty message is hashed as one block of zeros
+    if (_buffered || !_nhOffset)
+    {
+        memset(_buffer.begin() + _buffered, 0, NH_BLOCK - _buffered);
+        nhBlocks(_buffer.begin(), NH_BLOCK);
+    }
+
+    for (s = 0; s < _streams; s++)
+    {
+        y = _nhAccum[s] + bits;
+        if (_longMessage)
+        {
+            polyStep(s, y);
+            y = _polyAccum[s];
+            if (y >= P64)
+            {
+                y -= P64;
+            }
+        }
+
+        // The upper 64 bits of the 128 bit input are always zero, so only the last four key words take part
+        k = _l3Key1.begin() + 8 * s;
+        sum = (y >> 48) * k[4] + ((y >> 32) & 0xffff) * k[5] + ((y >> 16) & 0xffff) * k[6] + (y & 0xffff) * k[7];
+        store32be(tag + 4 * s, (uint32)(sum % P36) ^ _l3Key2[s]);
+    }
+
+    if (_tagLen == 8)
+    {
+        // Consecutive nonces share one AES block, each taking half of it
+        idx = (uint32)(nonce & 1);
+        nonce ^= idx;
+    }
+    if (!_padValid || (_padNonce != nonce))
+    {
+        store64be(_pad.begin(), nonce);
+        memset(_pad.begin() + 8, 0, 8);
+        _cipher->encrypt(_pad.begin());
+        _padNonce = nonce;
+        _padValid = true;
+    }
+    for (s = 0; s < _tagLen; s++)
+    {
+        tag[s] ^= _pad[idx * _tagLen + s];
+    }
+
+    reset();
+}
@@ -0,0 +1,132 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_UMAC_H
+#define NE7SSH_UMAC_H
+
+#include "ne7ssh_types.h"
+#include <botan/block_cipher.h>
+#include <botan/secmem.h>
+#include <memory>
+
+#define NE7SSH_UMAC_KEY_LEN 16
+// Bytes of message hashed by NH before its result is passed on to the polynomial hash
+#define NE7SSH_UMAC_L1_KEY_LEN 1024
+// Longest message the 64 bit polynomial hash covers, the 128 bit extension is never needed for SSH packets
+#define NE7SSH_UMAC_MAX_LEN (2 * 1024 * 1024)
+
+/**
+ * UMAC message authentication code (RFC 4418), as used by umac-64@openssh.com and umac-128@openssh.com.
+ * <p>Botan 1.10 has no UMAC. The NH layer, which touches every byte of the message, has an SSE2 version
+ * that is chosen at run time. AES-128 derives the subkeys and the pad, the 8 byte nonce is the packet sequence number.
+ * Messages are limited to NE7SSH_UMAC_MAX_LEN bytes, far more than any SSH packet.
+ */
+class ne7ssh_umac
+{
+private:
+    std::unique_ptr<Botan::BlockCipher> _cipher;
+    uint32 _tagLen;
+    uint32 _streams;
+    Botan::SecureVector<uint32> _nhKey;
+    Botan::SecureVector<uint64> _polyKey;
+    Botan::SecureVector<uint64> _polyAccum;
+    Botan::SecureVector<uint64> _l3Key1;
+    Botan::SecureVector<uint32> _l3Key2;
+    Botan::SecureVector<uint64> _nhAccum;
+    Botan::SecureVector<Botan::byte> _buffer;
+    uint32 _buffered;
+    uint32 _nhOffset;
+    bool _longMessage;
+    Botan::SecureVector<Botan::byte> _pad;
+    uint64 _padNonce;
+    bool _padValid;
+
+    /**
+     * UMAC key derivation function, AES-128 in counter mode.
+     * @param out Result is written here.
+     * @param index Which subkey is derived.
+     * @param len How many bytes to derive.
+     */
+    void kdf(Botan::byte* out, uint64 index, uint32 len);
+
+    /**
+     * Runs NH over whole 32 byte blocks of the current 1024 byte chunk.
+     * @param data Pointer to the data.
+     * @param len Length of the data, a multiple of 32.
+     */
+    void nhBlocks(const Botan::byte* data, uint32 len);
+
+    /**
+     * Passes the NH result of a full chunk to the polynomial hash and starts the next chunk.
+     */
+    void nextChunk();
+
+    /**
+     * One step of the 64 bit polynomial hash.
+     * @param stream Which of the parallel hashes is updated.
+     * @param word 64 bit NH result.
+     */
+    void polyStep(uint32 stream, uint64 word);
+
+    /**
+     * Forgets the message hashed so far.
+     */
+    void reset();
+
+public:
+    enum implementations { AUTO, SCALAR, SSE2 };
+
+    /**
+     * Replaces the NH implementation chosen from the CPU features, for known answer tests.
+     * <p>Not thread safe, call it while no UMAC is in use.
+     * @param impl Implementation to use from now on, AUTO goes back to the one the CPU features select.
+     * @return True if the implementation is compiled in and the CPU supports it, otherwise false is returned.
+     */
+    static bool forceImplementation(implementations impl);
+
+    /**
+     * ne7ssh_umac class constructor.
+     * @param cipher AES-128 block cipher. The object takes ownership of it.
+     * @param key Pointer to the NE7SSH_UMAC_KEY_LEN byte key.
+     * @param tagLen Tag length, 8 for UMAC-64 and 16 for UMAC-128.
+     */
+    ne7ssh_umac(Botan::BlockCipher* cipher, const Botan::byte* key, uint32 tagLen);
+
+    /**
+     * Returns the tag length.
+     * @return Tag length in bytes.
+     */
+    uint32 output_length() const
+    {
+        return _tagLen;
+    }
+
+    /**
+     * Adds data to the authenticated message.
+     * @param data Pointer to the data.
+     * @param len Length of the data.
+     */
+    void update(const Botan::byte* data, uint32 len);
+
+    /**
+     * Finishes the computation and gets ready for the next message.
+     * @param tag Buffer receiving output_length() bytes of the tag.
+     * @param nonce Message nonce. Must never repeat under the same key.
+     */
+    void final(Botan::byte* tag, uint64 nonce);
+};
+
+#endif
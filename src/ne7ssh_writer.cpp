@@ -0,0 +1,89 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_writer.h"
+#include <string.h>
+#if !defined(WIN32) && !defined(__MINGW32__)
+#   include <arpa/inet.h>
+#else
+#   include <Winsock2.h>
+#endif
+
+ne7ssh_writer::ne7ssh_writer(Botan::byte* data, uint32 capacity)
+    : _data(data),
+    _capacity(capacity),
+    _length(0),
+    _overflow(false)
+{
+}
+
+Botan::byte* ne7ssh_writer::next(uint32 len)
+{
+    Botan::byte* result;
+
+    if (len > _capacity - _length)
+    {
+        _overflow = true;
+        return 0;
+    }
+    result = _data + _length;
+    _length += len;
+    return result;
+}
+
+void ne7ssh_writer::addChar(const char ch)
+{
+    Botan::byte* out = next(1);
+
+    if (out)
+    {
+        *out = (Botan::byte)ch;
+    }
+}
+
+void ne7ssh_writer::addInt(const uint32 var)
+{
+    uint32 nVar = htonl(var);
+    Botan::byte* out = next(sizeof(uint32));
+
+    if (out)
+    {
+        memcpy(out, &nVar, sizeof(uint32));
+    }
+}
+
+void ne7ssh_writer::addBytes(const Botan::byte* buff, uint32 len)
+{
+    Botan::byte* out = next(len);
+
+    if (out)
+    {
+        memcpy(out, buff, len);
+    }
+}
+
+void ne7ssh_writer::addString(const char* str)
+{
+    uint32 len = strlen(str);
+    uint32 nLen = htonl(len);
+    Botan::byte* out = next(sizeof(uint32) + len);
+
+    if (out)
+    {
+        memcpy(out, &nLen, sizeof(uint32));
+        memcpy(out + sizeof(uint32), str, len);
+    }
+}
@@ -0,0 +1,104 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_WRITER_H
+#define NE7SSH_WRITER_H
+
+#include "ne7ssh_types.h"
+#include <botan/secmem.h>
+
+/**
+ * Serializes SSH fields into a fixed size, caller owned buffer.
+ * <p>Meant for short control messages (window adjust, eof, close) that can be built on the stack
+ * without touching the heap. If a field does not fit, nothing is written and overflow() is set.
+ */
+class ne7ssh_writer
+{
+private:
+    Botan::byte* _data;
+    uint32 _capacity;
+    uint32 _length;
+    bool _overflow;
+
+    /**
+     * Reserves room for the next field.
+     * @param len Length of the field.
+     * @return Pointer to the space for the field, or 0 if the buffer is too small.
+     */
+    Botan::byte* next(uint32 len);
+
+public:
+    /**
+     * ne7ssh_writer class constructor.
+     * @param data Pointer to the buffer to serialize into.
+     * @param capacity Size of the buffer.
+     */
+    ne7ssh_writer(Botan::byte* data, uint32 capacity);
+
+    /**
+     * Adds a single character to the buffer.
+     * @param ch a single character.
+     */
+    void addChar(const char ch);
+
+    /**
+     * Adds a single integer to the buffer, converted to network format.
+     * @param var a single integer.
+     */
+    void addInt(const uint32 var);
+
+    /**
+     * Adds a byte stream to the buffer.
+     * @param buff Pointer to the byte stream.
+     * @param len Length of the byte stream.
+     */
+    void addBytes(const Botan::byte* buff, uint32 len);
+
+    /**
+     * Adds a string to the buffer, preceded by its length in network format.
+     * @param str pointer to a string.
+     */
+    void addString(const char* str);
+
+    /**
+     * Returns the serialized data.
+     * @return Pointer to the start of the buffer.
+     */
+    const Botan::byte* value() const
+    {
+        return _data;
+    }
+
+    /**
+     * Returns number of bytes serialized so far.
+     * @return Length of the data.
+     */
+    uint32 length() const
+    {
+        return _length;
+    }
+
+    /**
+     * Checks whether any field was dropped because the buffer was too small.
+     * @return True if the buffer overflowed.
+     */
+    bool overflow() const
+    {
+        return _overflow;
+    }
+};
+
+#endif
@@ -0,0 +1,96 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_x25519.h"
+#include "ne7ssh_fe25519.h"
+#include <string.h>
+
+using namespace Botan;
+
+// (A - 2) / 4 for Curve25519
+#define X25519_A24 121665
+
+bool ne7ssh_x25519::scalarMult(Botan::byte* out, const Botan::byte* scalar, const Botan::byte* point)
+{
+    Botan::byte k[NE7SSH_X25519_LEN];
+    ne7ssh_fe25519 x1, x2, z2, x3, z3;
+    ne7ssh_fe25519 a, aa, b, bb, e, c, d, da, cb;
+    uint32 swap = 0, bit;
+    Botan::byte diff = 0;
+    int t, i;
+
+    memcpy(k, scalar, NE7SSH_X25519_LEN);
+    k[0] &= 248;
+    k[31] &= 127;
+    k[31] |= 64;
+
+    x1.fromBytes(point);
+    x2.one();
+    z2.zero();
+    x3 = x1;
+    z3.one();
+
+    for (t = 254; t >= 0; t--)
+    {
+        bit = (k[t >> 3] >> (t & 7)) & 1;
+        swap ^= bit;
+        ne7ssh_fe25519::cswap(x2, x3, swap);
+        ne7ssh_fe25519::cswap(z2, z3, swap);
+        swap = bit;
+
+        ne7ssh_fe25519::add(a, x2, z2);
+        ne7ssh_fe25519::sq(aa, a);
+        ne7ssh_fe25519::sub(b, x2, z2);
+        ne7ssh_fe25519::sq(bb, b);
+        ne7ssh_fe25519::sub(e, aa, bb);
+        ne7ssh_fe25519::add(c, x3, z3);
+        ne7ssh_fe25519::sub(d, x3, z3);
+        ne7ssh_fe25519::mul(da, d, a);
+        ne7ssh_fe25519::mul(cb, c, b);
+
+        ne7ssh_fe25519::add(x3, da, cb);
+        ne7ssh_fe25519::sq(x3, x3);
+        ne7ssh_fe25519::sub(z3, da, cb);
+        ne7ssh_fe25519::sq(z3, z3);
+        ne7ssh_fe25519::mul(z3, z3, x1);
+        ne7ssh_fe25519::mul(x2, aa, bb);
+        ne7ssh_fe25519::mulSmall(z2, e, X25519_A24);
+        ne7ssh_fe25519::add(z2, z2, aa);
+        ne7ssh_fe25519::mul(z2, z2, e);
+    }
+    ne7ssh_fe25519::cswap(x2, x3, swap);
+    ne7ssh_fe25519::cswap(z2, z3, swap);
+
+    ne7ssh_fe25519::invert(z2, z2);
+    ne7ssh_fe25519::mul(x2, x2, z2);
+    x2.toBytes(out);
+
+    memset(k, 0, sizeof(k));
+    for (i = 0; i < NE7SSH_X25519_LEN; i++)
+    {
+        diff |= out[i];
+    }
+    return diff != 0;
+}
+
+void ne7ssh_x25519::scalarMultBase(Botan::byte* out, const Botan::byte* scalar)
+{
+    Botan::byte base[NE7SSH_X25519_LEN];
+
+    memset(base, 0, sizeof(base));
+    base[0] = 9;
+    scalarMult(out, scalar, base);
+}
@@ -0,0 +1,49 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_X25519_H
+#define NE7SSH_X25519_H
+
+#include "ne7ssh_types.h"
+#include <botan/types.h>
+
+#define NE7SSH_X25519_LEN 32
+
+/**
+ * X25519 Diffie-Hellman function (RFC 7748), used by the curve25519-sha256 key exchange.
+ * <p>Botan 1.10 has no Curve25519. The Montgomery ladder here runs in constant time.
+ */
+class ne7ssh_x25519
+{
+public:
+    /**
+     * Multiplies a curve point by a scalar.
+     * @param out Buffer receiving the NE7SSH_X25519_LEN byte result.
+     * @param scalar Pointer to the NE7SSH_X25519_LEN byte private scalar. It is clamped as required by RFC 7748.
+     * @param point Pointer to the NE7SSH_X25519_LEN byte u coordinate of the point.
+     * @return False if the result is all zeros, which happens for small order points, otherwise true is returned.
+     */
+    static bool scalarMult(Botan::byte* out, const Botan::byte* scalar, const Botan::byte* point);
+
+    /**
+     * Computes the public value for a private scalar, by multiplying the base point.
+     * @param out Buffer receiving the NE7SSH_X25519_LEN byte public value.
+     * @param scalar Pointer to the NE7SSH_X25519_LEN byte private scalar.
+     */
+    static void scalarMultBase(Botan::byte* out, const Botan::byte* scalar);
+};
+
+#endif
@@ -0,0 +1,103 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#include "ne7ssh_zlib.h"
+#include <string.h>
+
+ne7ssh_zlib::ne7ssh_zlib(Direction direction, int level)
+    : _direction(direction),
+    _ready(false)
+{
+    memset(&_stream, 0, sizeof(_stream));
+    if (_direction == COMPRESS)
+    {
+        _ready = (deflateInit(&_stream, level) == Z_OK);
+    }
+    else
+    {
+        _ready = (inflateInit(&_stream) == Z_OK);
+    }
+}
+
+ne7ssh_zlib::~ne7ssh_zlib()
+{
+    if (!_ready)
+    {
+        return;
+    }
+    if (_direction == COMPRESS)
+    {
+        deflateEnd(&_stream);
+    }
+    else
+    {
+        inflateEnd(&_stream);
+    }
+}
+
+bool ne7ssh_zlib::process(Botan::SecureVector<Botan::byte>& out, const Botan::byte* in, uint32 len, uint32 maxLen)
+{
+    uint32 used = 0;
+    int status;
+
+    if (!_ready)
+    {
+        return false;
+    }
+
+    _stream.next_in = (Bytef*)in;
+    _stream.avail_in = len;
+    // Compressed text is typically a fraction of the input, deflate needs a few bytes more at worst
+    if (out.size() < ((_direction == COMPRESS) ? len + 64 : len * 4 + 64))
+    {
+        out.resize((_direction == COMPRESS) ? len + 64 : len * 4 + 64);
+    }
+
+    // Output space left over after all input is consumed means zlib has flushed everything
+    do
+    {
+        if (used == out.size())
+        {
+            if (used >= maxLen)
+            {
+                return false;
+            }
+            out.resize(used * 2);
+        }
+        _stream.next_out = out.begin() + used;
+        _stream.avail_out = out.size() - used;
+        if (_direction == COMPRESS)
+        {
+            status = deflate(&_stream, Z_PARTIAL_FLUSH);
+        }
+        else
+        {
+            status = inflate(&_stream, Z_SYNC_FLUSH);
+        }
+        used = out.size() - _stream.avail_out;
+        if ((status != Z_OK) && (status != Z_BUF_ERROR))
+        {
+            return false;
+        }
+    } while (_stream.avail_in || !_stream.avail_out);
+
+    if (used > maxLen)
+    {
+        return false;
+    }
+    out.resize(used);
+    return true;
+}
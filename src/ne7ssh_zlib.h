@@ -0,0 +1,66 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2007 by NetSieben Technologies INC                 *
+ *   Author: Andrew Useckas                                                *
+ *   Email: andrew@netsieben.com                                           *
+ *                                                                         *
+ *   Windows Port and bugfixes: Keef Aragon <keef@netsieben.com>           *
+ *                                                                         *
+ *   This program may be distributed under the terms of the Q Public       *
+ *   License as defined by Trolltech AS of Norway and appearing in the     *
+ *   file LICENSE.QPL included in the packaging of this file.              *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                  *
+ ***************************************************************************/
+
+#ifndef NE7SSH_ZLIB_H
+#define NE7SSH_ZLIB_H
+
+#include "ne7ssh_types.h"
+#include <botan/secmem.h>
+#include <zlib.h>
+
+/**
+ * Zlib stream for one direction of the transport, as used by the "zlib" and "zlib@openssh.com" compression methods.
+ * <p>A single deflate or inflate stream runs from one key exchange to the next. Every packet is flushed with Z_PARTIAL_FLUSH,
+ * so the peer can decompress it without waiting for the next one, while the dictionary carries over between packets.
+ */
+class ne7ssh_zlib
+{
+public:
+    enum Direction { COMPRESS, DECOMPRESS };
+
+private:
+    z_stream _stream;
+    Direction _direction;
+    bool _ready;
+
+    ne7ssh_zlib(const ne7ssh_zlib&);
+    ne7ssh_zlib& operator=(const ne7ssh_zlib&);
+
+public:
+    /**
+     * ne7ssh_zlib class constructor.
+     * @param direction Whether the stream compresses or decompresses.
+     * @param level Compression level, 1 to 9. Ignored when decompressing.
+     */
+    ne7ssh_zlib(Direction direction, int level);
+
+    /**
+     * ne7ssh_zlib class destructor.
+     */
+    ~ne7ssh_zlib();
+
+    /**
+     * Compresses or decompresses one packet payload, continuing the stream.
+     * @param out Receives the result. Its allocation is reused between calls.
+     * @param in Pointer to the payload.
+     * @param len Length of the payload.
+     * @param maxLen Largest result accepted, decompression fails beyond it.
+     * @return True on success, false if zlib failed or the result would exceed maxLen.
+     */
+    bool process(Botan::SecureVector<Botan::byte>& out, const Botan::byte* in, uint32 len, uint32 maxLen);
+};
+
+#endif